@@ -0,0 +1,330 @@
+#include "hwio_bus_catalog.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+namespace hwio {
+
+static const uint32_t CATALOG_MAGIC = 0x54434f49; // "IOCT"
+static const uint32_t CATALOG_FORMAT_VERSION = 4;
+
+/*
+ * Layout of catalog file (native endianity, it is a local cache):
+ *   catalog_header_t
+ *   catalog_dev_t[dev_cnt]
+ *   catalog_spec_t[spec_cnt]
+ *   strings (not terminated, referenced by offset and length)
+ * */
+struct catalog_str_t {
+	uint32_t off;
+	uint32_t len;
+};
+
+struct catalog_header_t {
+	uint32_t magic;
+	uint32_t format_version;
+	uint64_t total_size;
+	// fingerprint of the source
+	int64_t src_mtime_sec;
+	int64_t src_mtime_nsec;
+	uint64_t src_size;
+	uint64_t src_hash;
+	// hash of options of the source bus (e.g. memory file)
+	uint64_t src_options_hash;
+
+	uint32_t dev_cnt;
+	uint32_t spec_cnt;
+	uint32_t strings_size;
+	uint32_t _reserved;
+};
+
+struct catalog_dev_t {
+	uint64_t base;
+	uint64_t size;
+	catalog_str_t name;
+	catalog_str_t mem_path;
+	uint32_t spec_first;
+	uint32_t spec_cnt;
+	// HWIO_ACCESS_* flags of the device
+	uint32_t access_widths;
+	uint32_t _reserved;
+};
+
+struct catalog_spec_t {
+	catalog_str_t name;
+	catalog_str_t vendor;
+	catalog_str_t type;
+	int32_t major;
+	int32_t minor;
+	int32_t subminor;
+	int32_t _reserved;
+};
+
+static const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+
+static void fnv1a(uint64_t & hash, const void * data, size_t n) {
+	auto d = reinterpret_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < n; i++) {
+		hash ^= d[i];
+		hash *= 0x100000001b3ULL;
+	}
+}
+
+// number of bytes from the beginning of a file source which are hashed
+// (covers the header of fdt blob with its totalsize)
+static const size_t SOURCE_HEAD_SIZE = 64;
+static const char * BOOT_ID_PATH = "/proc/sys/kernel/random/boot_id";
+
+/*
+ * Hash id of the current boot (device-tree in /proc or /sys may change
+ * between boots without change of mtime)
+ * */
+static void fingerprint_boot(uint64_t & hash) {
+	int fd = open(BOOT_ID_PATH, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	char buf[64];
+	ssize_t r;
+	do {
+		r = read(fd, buf, sizeof(buf));
+	} while (r < 0 && errno == EINTR);
+	close(fd);
+	if (r > 0)
+		fnv1a(hash, buf, r);
+}
+
+/*
+ * Bounded fingerprint of the source, only the root of the source is checked:
+ * mtime and size of the file/directory, boot id and for files hash
+ * of the first SOURCE_HEAD_SIZE bytes, and hash of options of the source bus
+ * (changes deeper in directory tree require explicit rebuild of catalog)
+ * */
+static void source_fingerprint(const std::string & source_path,
+		const std::string & source_options, catalog_header_t & h) {
+	h.src_options_hash = FNV_OFFSET;
+	fnv1a(h.src_options_hash, source_options.data(), source_options.size());
+
+	int fd = open(source_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw hwio_catalog_err(
+				std::string("Can not open catalog source ") + source_path);
+	struct stat st;
+	if (fstat(fd, &st)) {
+		close(fd);
+		throw hwio_catalog_err(
+				std::string("Can not stat catalog source ") + source_path);
+	}
+	h.src_mtime_sec = st.st_mtim.tv_sec;
+	h.src_mtime_nsec = st.st_mtim.tv_nsec;
+	h.src_size = st.st_size;
+	h.src_hash = FNV_OFFSET;
+	fingerprint_boot(h.src_hash);
+	if (S_ISREG(st.st_mode)) {
+		uint8_t buf[SOURCE_HEAD_SIZE];
+		ssize_t r;
+		do {
+			r = pread(fd, buf, sizeof(buf), 0);
+		} while (r < 0 && errno == EINTR);
+		if (r < 0) {
+			close(fd);
+			throw hwio_catalog_err(
+					std::string("Can not read catalog source ") + source_path);
+		}
+		fnv1a(h.src_hash, buf, r);
+	}
+	close(fd);
+}
+
+static catalog_str_t catalog_str_add(std::string & strings,
+		const std::string & s) {
+	catalog_str_t r = { uint32_t(strings.size()), uint32_t(s.size()) };
+	strings += s;
+	return r;
+}
+
+void hwio_bus_catalog::write(const std::string & catalog_path,
+		const std::string & source_path,
+		const std::vector<hwio_device_mmap *> & devices,
+		const std::string & source_options) {
+	catalog_header_t h;
+	memset(&h, 0, sizeof(h));
+	h.magic = CATALOG_MAGIC;
+	h.format_version = CATALOG_FORMAT_VERSION;
+	if (source_path != "")
+		source_fingerprint(source_path, source_options, h);
+
+	vector<catalog_dev_t> devs;
+	vector<catalog_spec_t> specs;
+	std::string strings;
+	for (auto d : devices) {
+		catalog_dev_t cd;
+		memset(&cd, 0, sizeof(cd));
+		cd.base = d->on_bus_base_addr;
+		cd.size = d->on_bus_size;
+		cd.name = catalog_str_add(strings, d->name());
+		cd.mem_path = catalog_str_add(strings, d->mem_path());
+		cd.access_widths = d->access_widths();
+		cd.spec_first = specs.size();
+		for (auto & s : d->get_spec()) {
+			catalog_spec_t cs;
+			memset(&cs, 0, sizeof(cs));
+			cs.name = catalog_str_add(strings, s.name);
+			cs.vendor = catalog_str_add(strings, s.vendor);
+			cs.type = catalog_str_add(strings, s.type);
+			cs.major = s.version.major;
+			cs.minor = s.version.minor;
+			cs.subminor = s.version.subminor;
+			specs.push_back(cs);
+		}
+		cd.spec_cnt = specs.size() - cd.spec_first;
+		devs.push_back(cd);
+	}
+	h.dev_cnt = devs.size();
+	h.spec_cnt = specs.size();
+	h.strings_size = strings.size();
+	h.total_size = sizeof(h) + devs.size() * sizeof(catalog_dev_t)
+			+ specs.size() * sizeof(catalog_spec_t) + strings.size();
+
+	vector<uint8_t> data;
+	data.reserve(h.total_size);
+	auto append = [&data](const void * p, size_t n) {
+		auto _p = reinterpret_cast<const uint8_t*>(p);
+		data.insert(data.end(), _p, _p + n);
+	};
+	append(&h, sizeof(h));
+	append(devs.data(), devs.size() * sizeof(catalog_dev_t));
+	append(specs.data(), specs.size() * sizeof(catalog_spec_t));
+	append(strings.data(), strings.size());
+
+	// write to temporary file and rename it so other processes never see
+	// partially written catalog
+	std::string tmp_path = catalog_path + ".tmp" + to_string(getpid());
+	int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			0644);
+	if (fd < 0)
+		throw hwio_catalog_err(std::string("Can not create catalog ") + tmp_path);
+	size_t wr = 0;
+	while (wr < data.size()) {
+		ssize_t r = ::write(fd, &data[wr], data.size() - wr);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0) {
+			close(fd);
+			unlink(tmp_path.c_str());
+			throw hwio_catalog_err(
+					std::string("Can not write catalog ") + tmp_path);
+		}
+		wr += r;
+	}
+	close(fd);
+	if (rename(tmp_path.c_str(), catalog_path.c_str())) {
+		unlink(tmp_path.c_str());
+		throw hwio_catalog_err(
+				std::string("Can not rename catalog to ") + catalog_path);
+	}
+}
+
+static std::string catalog_str_get(const char * strings, size_t strings_size,
+		const catalog_str_t & s) {
+	if (s.off > strings_size || s.len > strings_size - s.off)
+		throw hwio_catalog_err("Corrupted string in catalog");
+	return std::string(strings + s.off, s.len);
+}
+
+hwio_bus_catalog::hwio_bus_catalog(const std::string & catalog_path,
+		const std::string & source_path, const std::string & source_options) {
+	int fd = open(catalog_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw hwio_catalog_err(
+				std::string("Can not open catalog ") + catalog_path);
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < (off_t) sizeof(catalog_header_t)) {
+		close(fd);
+		throw hwio_catalog_err(
+				std::string("Catalog too small ") + catalog_path);
+	}
+	size_t size = st.st_size;
+	void * m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (m == MAP_FAILED)
+		throw hwio_catalog_err(std::string("Can not mmap catalog ") + catalog_path);
+	auto data = reinterpret_cast<const uint8_t*>(m);
+
+	try {
+		auto h = reinterpret_cast<const catalog_header_t*>(data);
+		if (h->magic != CATALOG_MAGIC
+				|| h->format_version != CATALOG_FORMAT_VERSION)
+			throw hwio_catalog_err("Wrong format of catalog");
+		size_t devs_off = sizeof(catalog_header_t);
+		size_t specs_off = devs_off + size_t(h->dev_cnt) * sizeof(catalog_dev_t);
+		size_t strings_off = specs_off
+				+ size_t(h->spec_cnt) * sizeof(catalog_spec_t);
+		if (h->total_size != size || strings_off + h->strings_size != size)
+			throw hwio_catalog_err("Wrong size of catalog");
+
+		if (source_path != "") {
+			catalog_header_t src;
+			source_fingerprint(source_path, source_options, src);
+			if (src.src_mtime_sec != h->src_mtime_sec
+					|| src.src_mtime_nsec != h->src_mtime_nsec
+					|| src.src_size != h->src_size
+					|| src.src_hash != h->src_hash
+					|| src.src_options_hash != h->src_options_hash)
+				throw hwio_catalog_err("Catalog is outdated");
+		}
+
+		auto devs = reinterpret_cast<const catalog_dev_t*>(data + devs_off);
+		auto specs = reinterpret_cast<const catalog_spec_t*>(data + specs_off);
+		auto strings = reinterpret_cast<const char*>(data + strings_off);
+		_all_devices.reserve(h->dev_cnt);
+		for (size_t i = 0; i < h->dev_cnt; i++) {
+			auto & cd = devs[i];
+			if (cd.spec_first > h->spec_cnt
+					|| cd.spec_cnt > h->spec_cnt - cd.spec_first)
+				throw hwio_catalog_err("Corrupted device in catalog");
+			vector<hwio_comp_spec> spec;
+			spec.reserve(cd.spec_cnt);
+			for (size_t s = cd.spec_first; s < cd.spec_first + cd.spec_cnt;
+					s++) {
+				auto & cs = specs[s];
+				spec.push_back(
+						hwio_comp_spec(
+								catalog_str_get(strings, h->strings_size,
+										cs.vendor),
+								catalog_str_get(strings, h->strings_size,
+										cs.type),
+								hwio_version(cs.major, cs.minor, cs.subminor)));
+				spec.back().name_set(
+						catalog_str_get(strings, h->strings_size, cs.name));
+			}
+			auto dev = new hwio_device_mmap(spec, cd.base, cd.size,
+					catalog_str_get(strings, h->strings_size, cd.mem_path));
+			_all_devices.push_back(dev);
+			dev->access_widths(cd.access_widths);
+			auto name = catalog_str_get(strings, h->strings_size, cd.name);
+			if (name != "")
+				dev->name(name);
+		}
+	} catch (const hwio_catalog_err & err) {
+		munmap(m, size);
+		for (auto dev : _all_devices)
+			delete dev;
+		_all_devices.clear();
+		throw hwio_catalog_err(std::string(err.what()) + ": " + catalog_path);
+	}
+	munmap(m, size);
+	registry.build(_all_devices);
+}
+
+vector<ihwio_dev *> hwio_bus_catalog::find_devices(
+		const vector<hwio_comp_spec> & spec) {
+	return registry.find(spec);
+}
+
+}
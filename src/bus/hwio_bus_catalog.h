@@ -0,0 +1,74 @@
+#pragma once
+
+#include "ihwio_bus.h"
+#include "hwio_device_mmap.h"
+#include "hwio_device_registry.h"
+
+namespace hwio {
+
+/*
+ * Catalog is missing, corrupted or outdated against its source
+ * */
+class hwio_catalog_err: public std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+/**
+ * Bus with devices loaded from binary device catalog
+ *
+ * Catalog is a cache of device discovery (device-tree, fdt, json). It stores
+ * base/size, name, memory file and pre-parsed compatibility specs of each
+ * device, the file is mmaped and devices are created without any parsing.
+ *
+ * Catalog remembers mtime and size of the source, id of the boot, hash of
+ * the beginning of a file source (e.g. header of fdt) and hash of options
+ * of the source bus, it is rejected if any of them has changed. The check is
+ * bounded, only the root of a directory source is checked, a change deeper
+ * in the tree requires explicit rebuild of the catalog (hwio-catalog tool).
+ * */
+class hwio_bus_catalog: public ihwio_bus {
+	hwio_device_registry registry;
+
+public:
+	std::vector<hwio_device_mmap *> _all_devices;
+
+	/**
+	 * Load catalog
+	 *
+	 * @param catalog_path path of catalog file
+	 * @param source_path path of file/directory from which catalog was build
+	 * 		(empty string disables the check)
+	 * @param source_options options of the source bus which affect
+	 * 		the devices (e.g. path of memory file), compared as a string
+	 * @throw hwio_catalog_err if catalog is not valid for this source
+	 * */
+	hwio_bus_catalog(const std::string & catalog_path,
+			const std::string & source_path,
+			const std::string & source_options = "");
+
+	/**
+	 * Write catalog of devices (atomically replaces the catalog file)
+	 *
+	 * @param source_path path of file/directory from which devices were discovered
+	 * @param source_options options of the source bus
+	 * @throw hwio_catalog_err
+	 * */
+	static void write(const std::string & catalog_path,
+			const std::string & source_path,
+			const std::vector<hwio_device_mmap *> & devices,
+			const std::string & source_options = "");
+
+	virtual std::vector<ihwio_dev *> find_devices(
+			const std::vector<hwio_comp_spec> & spec) override;
+	virtual std::vector<ihwio_dev *> find_devices(
+			const std::vector<hwio_spec_literal> & spec) override {
+		return registry.find(spec);
+	}
+
+	virtual ~hwio_bus_catalog() {
+		for (auto dev : _all_devices)
+			delete dev;
+	}
+};
+
+}
@@ -1,151 +1,66 @@
 #include "hwio_comp_spec.h"
 #include "hwio_bus_devicetree.h"
-#include "hwio_bus_primitive.h"
 
 #include <stdlib.h>
-#include <stdio.h>
 #include <stddef.h>
-#include <ctype.h>
 #include <string.h>
 #include <assert.h>
-#include <regex.h>
-#include <algorithm>    // std::sort
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>    // std::stable_sort
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 namespace hwio {
 
-typedef vector<char*> & path_ref_t;
-
 class device_tree_format_err: public runtime_error {
 	using runtime_error::runtime_error;
 };
 
 const std::string hwio_bus_devicetree::DEFAULT_DEVICE_TREE_PATH = "/proc/device-tree";
+const unsigned hwio_bus_devicetree::MAX_SCAN_THREADS = 4;
 
-char * hwio_bus_devicetree::file_path_from_stack(const char *fname) {
-	assert(fname != nullptr);
-
-	size_t plen = 0;
-	for (auto p : path_stack) {
-		assert(p != nullptr);
-		plen += strlen((const char *) p) + 1;
-	}
-
-	const size_t fnamelen = strlen(fname);
-	char *full = (char *) malloc(plen + fnamelen + 1);
-
-	char *p = full;
-	for (auto frag : path_stack) {
-		const size_t flen = strlen((const char *) frag);
-
-		memcpy(p, frag, flen);
-		p[flen] = '/';
-		p += flen + 1;
-	}
-
-	assert((size_t ) (p - full) == plen);
-
-	if (fnamelen > 0) {
-		memcpy(p, fname, fnamelen);
-		p[fnamelen] = '\0';
-	} else {
-		full[plen - 1] = '\0';
-	}
-
-	return full;
-}
-
-bool hwio_bus_devicetree::path_stat(const char *fname, struct stat *st) {
-	char *fpath = file_path_from_stack(fname);
-	if (fpath == nullptr)
-		goto clean_and_exit;
-
-	if (stat(fpath, st))
-		goto clean_and_exit;
-
-	free(fpath);
-	return false;
-
-	clean_and_exit: if (fpath != nullptr)
-		free(fpath);
-	return true;
-}
-
-bool hwio_bus_devicetree::path_is_file(const char *fname) {
-	struct stat st;
-	if (path_stat(fname, &st))
-		return false;
-
-	return S_ISREG(st.st_mode); // is file
-}
-
-bool hwio_bus_devicetree::path_is_dir(const char *fname) {
-	struct stat st;
-	if (path_stat(fname, &st))
+/*
+ * Read content of file in directory
+ *
+ * @param max_size max number of bytes to read (0 = whole file)
+ * @return false if file can not be read
+ * */
+static bool file_read_at(int dir_fd, const char *fname, vector<char> & buf,
+		size_t max_size) {
+	int fd = openat(dir_fd, fname, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
 		return false;
 
-	return S_ISDIR(st.st_mode);
-}
-
-bool hwio_bus_devicetree::dir_has_file(DIR *curr, const char *fname) {
-	rewinddir(curr);
-	struct dirent *d;
-
-	while ((d = readdir(curr)) != nullptr) {
-		if (strcmp(d->d_name, fname))
+	buf.clear();
+	size_t len = 0;
+	while (true) {
+		if (buf.size() == len) {
+			size_t s = len + 256;
+			if (max_size && s > max_size)
+				s = max_size;
+			if (s == len)
+				break;
+			buf.resize(s);
+		}
+		ssize_t r = read(fd, &buf[len], buf.size() - len);
+		if (r < 0 && errno == EINTR)
 			continue;
-
-		if (path_is_file(fname)) {
-			rewinddir(curr);
-			return true;
+		if (r < 0) {
+			close(fd);
+			return false;
 		}
+		if (r == 0)
+			break;
+		len += r;
 	}
-
-	rewinddir(curr);
-	return false;
-}
-
-FILE *hwio_bus_devicetree::path_fopen(const char *fname, const char *mode) {
-	char *fpath = file_path_from_stack(fname);
-	FILE *file = fopen(fpath, mode);
-	free(fpath);
-	if (file == nullptr)
-		throw device_tree_format_err("Can not open file");
-
-	return file;
-}
-
-/*
- * Read content of file and add '\0' to end of data
- * and close file
- * */
-static
-char *file_read(FILE *file, size_t *flen) {
-	struct stat file_stat;
-	if (fstat(fileno(file), &file_stat)) {
-		fclose(file);
-		return nullptr;
-	}
-
-	const size_t fsize = file_stat.st_size;
-
-	char *m = new char[fsize + 1];
-	if (m == nullptr) {
-		fclose(file);
-		return nullptr;
-	}
-
-	size_t rlen = fread(m, 1, fsize, file);
-	if (rlen < fsize) {
-		delete[] m;
-		fclose(file);
-		return nullptr;
-	}
-
-	((char *) m)[fsize] = '\0';
-
-	*flen = fsize;
-	return m;
+	close(fd);
+	buf.resize(len);
+	return true;
 }
 
 template<typename T>
@@ -159,218 +74,207 @@ void reverse_endianity(T & val) {
 	val = tmp;
 }
 
-void hwio_bus_devicetree::dev_parse_reg(const char *fname,
-		hwio_phys_addr_t * base, hwio_phys_addr_t * size) {
-	FILE *regf = path_fopen(fname, "r");
-	assert(regf != nullptr);
+bool hwio_bus_devicetree::scan_dir(DIR * dir, vector<string> & subdirs,
+		bool & has_compat) {
+	bool has_reg = false;
+	has_compat = false;
+	struct dirent *d;
+	while ((d = readdir(dir)) != nullptr) {
+		if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
+			continue;
 
-	size_t length = 0;
-	const char *content = file_read(regf, &length);
-	fclose(regf);
+		bool is_dir = d->d_type == DT_DIR;
+		bool is_file = d->d_type == DT_REG;
+		if (d->d_type == DT_UNKNOWN || d->d_type == DT_LNK) {
+			// file system does not provide the type or it is a link
+			struct stat st;
+			if (fstatat(dirfd(dir), d->d_name, &st, 0))
+				continue;
+			is_dir = S_ISDIR(st.st_mode);
+			is_file = S_ISREG(st.st_mode);
+		}
 
-	// some devices can have reg file of different size because they have different size of address
-	if (length != 2 * sizeof(hwio_phys_addr_t)) {
-		delete [] content;
-		auto fp = file_path_from_stack(fname);
-		auto errmsg = std::string(
-				"Base and size has different size than expected ("
-						+ to_string(length) + "B), 32b/64b system problem: ")
-				+ fp;
-		free(fp);
-		throw device_tree_format_err(errmsg);
+		if (is_dir) {
+			subdirs.push_back(d->d_name);
+		} else if (is_file) {
+			if (!strcmp(d->d_name, "reg"))
+				has_reg = true;
+			else if (!strcmp(d->d_name, "compatible"))
+				has_compat = true;
+		}
 	}
-
-	*base = *((hwio_phys_addr_t*) content);
-	*size = *((hwio_phys_addr_t*) (content + (length / 2)));
-
-	reverse_endianity<hwio_phys_addr_t>(*base);
-	reverse_endianity<hwio_phys_addr_t>(*size);
-
-	delete[] content;
+	return has_reg;
 }
 
-vector<char *> hwio_bus_devicetree::dev_parse_compat(const char *fname) {
-	vector<char *> compatibility_strings;
-	FILE *regf = path_fopen(fname, "r");
-
-	size_t length = 0;
-	const char *content = file_read(regf, &length);
-	fclose(regf);
-	const char *actual = content;
-	size_t actual_length = 0;
-
-	while (actual_length < length) {
-		size_t l = strlen(actual);
-		compatibility_strings.push_back(strdup(actual));
-		actual_length += l + 1;
-		actual += l + 1;
+DIR * hwio_bus_devicetree::open_dir(const dir_todo_t & d) {
+	int fd = openat(d.parent_fd, d.name.c_str(),
+			O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		throw device_tree_format_err(
+				std::string("Can not open device-tree dir ") + d.name);
+	DIR *dir = fdopendir(fd);
+	if (dir == nullptr) {
+		close(fd);
+		throw device_tree_format_err(
+				std::string("Can not open device-tree dir ") + d.name);
 	}
-	delete[] content;
-	return compatibility_strings;
+	return dir;
 }
 
-hwio_device_mmap *hwio_bus_devicetree::dev_from_dir(DIR *curr) {
-	assert(path_stack.size() > 1); // the root is never a device
+hwio_device_mmap *hwio_bus_devicetree::dev_from_dir(int dir_fd,
+		const std::string & name, bool has_compat) {
+	// some devices can have reg file of different size because they have different size of address
+	vector<char> content;
+	if (!file_read_at(dir_fd, "reg", content, 2 * sizeof(hwio_phys_addr_t) + 1)
+			|| content.size() != 2 * sizeof(hwio_phys_addr_t))
+		return nullptr;
 
-	char * name = path_stack.back();
+	hwio_phys_addr_t base, size;
+	memcpy(&base, &content[0], sizeof(base));
+	memcpy(&size, &content[sizeof(base)], sizeof(size));
+	reverse_endianity<hwio_phys_addr_t>(base);
+	reverse_endianity<hwio_phys_addr_t>(size);
 
 	vector<hwio_comp_spec> spec;
-	hwio_phys_addr_t base = 0, size = 0;
-	struct dirent *d;
-	rewinddir(curr);
-	while ((d = readdir(curr)) != nullptr) {
-		if (!path_is_file(d->d_name))
-			continue;
-
-		try {
-			if (!strcmp(d->d_name, "reg"))
-				dev_parse_reg("reg", &base, &size);
-		} catch (const device_tree_format_err & err) {
-			rewinddir(curr);
-			return nullptr;
-		}
-
-		if (!strcmp(d->d_name, "compatible")) {
-			for (auto cs : dev_parse_compat("compatible")) {
-				spec.push_back(hwio_comp_spec(cs));
-				free(cs);
-			}
+	if (has_compat && file_read_at(dir_fd, "compatible", content, 0)) {
+		size_t i = 0;
+		while (i < content.size()) {
+			size_t l = strnlen(&content[i], content.size() - i);
+			spec.push_back(hwio_comp_spec(std::string(&content[i], l)));
+			i += l + 1;
 		}
 	}
-	rewinddir(curr);
-	assert(name != nullptr);
+
 	auto dev = new hwio_device_mmap(spec, base, size, mem_path);
 	dev->name(name);
+	dev->access_widths(dev_access_widths);
 	return dev;
 }
 
-bool devAddrCmp(ihwio_dev * a, ihwio_dev * b) {
-	hwio_device_mmap * _a = dynamic_cast<hwio_device_mmap *>(a);
-	hwio_device_mmap * _b = dynamic_cast<hwio_device_mmap *>(b);
+void hwio_bus_devicetree::walk_subtree(const dir_todo_t & d,
+		vector<hwio_device_mmap *> & devs) {
+	DIR *dir = open_dir(d);
+	try {
+		vector<string> subdirs;
+		bool has_compat;
+		if (scan_dir(dir, subdirs, has_compat)) {
+			auto dev = dev_from_dir(dirfd(dir), d.name, has_compat);
+			if (dev != nullptr)
+				devs.push_back(dev);
+		}
+		for (auto & s : subdirs)
+			walk_subtree( { dirfd(dir), s }, devs);
+	} catch (...) {
+		closedir(dir);
+		throw;
+	}
+	closedir(dir);
+}
 
-	assert(_a != nullptr);
-	assert(_b != nullptr);
-	return _a->on_bus_base_addr < _b->on_bus_base_addr;
+static bool devAddrCmp(hwio_device_mmap * a, hwio_device_mmap * b) {
+	return a->on_bus_base_addr < b->on_bus_base_addr;
 }
 
 hwio_bus_devicetree::hwio_bus_devicetree(const std::string & device_tree_path,
-		const std::string & mem_path) :
-		mem_path(mem_path) {
-
-	top_dir_checked_for_dev = false;
-	auto * actual_dir = opendir(device_tree_path.c_str());
-	if (actual_dir == nullptr)
+		const std::string & mem_path, unsigned access_widths) :
+		mem_path(mem_path), dev_access_widths(access_widths) {
+	auto * root = opendir(device_tree_path.c_str());
+	if (root == nullptr)
 		throw device_tree_format_err(
 				std::string("Can not open root device-tree folder:")
 						+ device_tree_path);
-	dir_stack.push_back(actual_dir);
-	path_stack.push_back(strdup(device_tree_path.c_str()));
-
-	auto dev = device_next();
-	while (dev != nullptr) {
-		_all_devices.push_back(dev);
-		dev = device_next();
-	}
-	assert(dir_stack.size() == 0);
 
-	for (auto p : path_stack)
-		free(p);
-
-	path_stack.clear();
-
-	std::sort(_all_devices.begin(), _all_devices.end(), devAddrCmp);
-}
-
-/**
- * Open directory from path stored in path stack and add it to dir_stack
- **/
-DIR * hwio_bus_devicetree::opendir_on_stack() {
-	char *fpath = file_path_from_stack("");
-	DIR *dir = opendir(fpath);
-
-	if (dir == nullptr) {
-		std::string err_msg(std::string("Can not open dir on stack") + fpath);
-		free(fpath);
-		throw device_tree_format_err(err_msg);
-	} else {
-		free(fpath);
-	}
-
-	dir_stack.push_back(dir);
-	return dir;
-}
-
-/**
- * Go to next directory in current directory
- * */
-DIR * hwio_bus_devicetree::go_next_dir(DIR *curr) {
-	struct dirent *d;
-
-	while ((d = readdir(curr)) != nullptr) {
-		if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
-			continue;
-
-		if (path_is_dir(d->d_name))
-			break;
-	}
-	if (d != nullptr) {
-		top_dir_checked_for_dev = false;
-		path_stack.push_back(strdup(d->d_name));
-		return opendir_on_stack();
-	}
-	return nullptr;
-}
-
-/**
- * Iterator, Searches for another device in devicetree
- *
- * * preorder, depth-first, using dir_stack and recursion of device_next
- *
- **/
-hwio_device_mmap * hwio_bus_devicetree::device_next() {
-	if (dir_stack.size() == 0)
-		return nullptr;
-
-	if (!top_dir_checked_for_dev) {
-		auto actual_dir = dir_stack.back();
-		top_dir_checked_for_dev = true;
-		if (dir_has_file(actual_dir, "reg")) {
-			// this dir can be device, try load it
-			auto dev = dev_from_dir(actual_dir);
-			rewinddir(actual_dir);
-			if (dev != nullptr)
-				return dev;
+	unsigned thread_cnt = std::min(MAX_SCAN_THREADS,
+			std::max(1u, std::thread::hardware_concurrency()));
+
+	// directories which are opened and used as parents of the frontier
+	vector<DIR *> opened = { root };
+	vector<dir_todo_t> frontier;
+	vector<vector<hwio_device_mmap *>> found;
+	try {
+		// the root is never a device
+		vector<string> subdirs;
+		bool has_compat;
+		scan_dir(root, subdirs, has_compat);
+		for (auto & s : subdirs)
+			frontier.push_back( { dirfd(root), s });
+
+		// expand the tree breadth-first until there are enough
+		// independent subtrees for all threads
+		while (thread_cnt > 1 && frontier.size() > 0
+				&& frontier.size() < 2 * thread_cnt) {
+			vector<dir_todo_t> next;
+			for (auto & d : frontier) {
+				DIR *dir = open_dir(d);
+				opened.push_back(dir);
+				subdirs.clear();
+				if (scan_dir(dir, subdirs, has_compat)) {
+					auto dev = dev_from_dir(dirfd(dir), d.name, has_compat);
+					if (dev != nullptr)
+						_all_devices.push_back(dev);
+				}
+				for (auto & s : subdirs)
+					next.push_back( { dirfd(dir), s });
+			}
+			frontier = std::move(next);
 		}
-		return device_next();
-	} else {
-		while (dir_stack.size() > 0) {
-
-			// this dir can contains devices, reset directory walking and, walk directories
-			DIR *dir = go_next_dir(dir_stack.back());
 
-			// if in directory is not any another directory return from it
-			if (dir == nullptr) {
-				closedir(dir_stack.back());
-				dir_stack.pop_back();
-				free(path_stack.back());
-				path_stack.pop_back();
+		// depth-first walk of each subtree, subtrees are shared between threads
+		found.resize(frontier.size());
+		std::atomic<size_t> next_todo(0);
+		std::exception_ptr err;
+		std::mutex err_lock;
+		auto worker = [&]() {
+			size_t i;
+			while ((i = next_todo++) < frontier.size()) {
+				try {
+					walk_subtree(frontier[i], found[i]);
+				} catch (...) {
+					std::lock_guard<std::mutex> lock(err_lock);
+					if (!err)
+						err = std::current_exception();
+					next_todo = frontier.size();
+				}
+			}
+		};
+		vector<std::thread> workers;
+		for (unsigned i = 1; i < std::min<size_t>(thread_cnt, frontier.size());
+				i++) {
+			try {
+				workers.push_back(std::thread(worker));
+			} catch (const std::system_error & e) {
+				// the rest of work is done in this thread
+				break;
 			}
-			// recursively
-			return device_next();
-
 		}
+		worker();
+		for (auto & t : workers)
+			t.join();
+		if (err)
+			std::rethrow_exception(err);
+	} catch (...) {
+		for (auto dir : opened)
+			closedir(dir);
+		for (auto & devs : found)
+			for (auto dev : devs)
+				delete dev;
+		for (auto dev : _all_devices)
+			delete dev;
+		_all_devices.clear();
+		throw;
 	}
+	for (auto dir : opened)
+		closedir(dir);
 
-	return nullptr;
+	for (auto & devs : found)
+		_all_devices.insert(_all_devices.end(), devs.begin(), devs.end());
+	std::stable_sort(_all_devices.begin(), _all_devices.end(), devAddrCmp);
+	registry.build(_all_devices);
 }
 
 vector<ihwio_dev *> hwio_bus_devicetree::find_devices(
 		const vector<hwio_comp_spec> & spec) {
-	vector<ihwio_dev*> devs;
-	for (auto d : _all_devices)
-		devs.push_back(reinterpret_cast<ihwio_dev*>(d));
-
-	return hwio_bus_primitive::filter_device_by_spec(devs, spec);
+	return registry.find(spec);
 }
 
 }
@@ -5,55 +5,78 @@
 
 #include "ihwio_bus.h"
 #include "hwio_device_mmap.h"
+#include "hwio_device_registry.h"
 
 namespace hwio {
 
 /**
  * Bus with devices generated from device-tree
+ *
+ * The device-tree directory is scanned using directory file descriptors
+ * (openat/fdopendir/fstatat) and each directory is read only once.
+ * Independent subtrees are scanned in parallel by a small pool of threads.
  * */
 class hwio_bus_devicetree: public ihwio_bus {
 	const std::string mem_path;
-	std::vector<char *> path_stack;
-	std::vector<DIR *> dir_stack;
-	bool top_dir_checked_for_dev;
-
-	hwio_device_mmap * device_next();
-	hwio_device_mmap * dev_from_dir(DIR *curr);
-	DIR * go_next_dir(DIR *curr, std::vector<char *> & path);
+	// HWIO_ACCESS_* flags of devices on this bus
+	const unsigned dev_access_widths;
+	hwio_device_registry registry;
 
 	/**
-	 * @param fname name of file in actual path
+	 * Directory which was not scanned yet
+	 * (opened relatively to dir_fd of already opened parent)
 	 * */
-	bool path_is_file(const char *fname);
+	struct dir_todo_t {
+		int parent_fd;
+		std::string name;
+	};
+
 	/**
-	 * @param fname name of file in actual path
+	 * Read content of directory in a single pass
+	 *
+	 * @param subdirs output list of names of subdirectories
+	 * @return true if directory contains "reg" file
 	 * */
-	bool path_is_dir(const char *fname);
+	static bool scan_dir(DIR * dir, std::vector<std::string> & subdirs,
+			bool & has_compat);
+	DIR * open_dir(const dir_todo_t & d);
+
 	/**
-	 * @param fname name of file in actual path
+	 * Load device from directory of device-tree node
+	 *
+	 * @return nullptr if node is not device with 32b reg
 	 * */
-	bool dir_has_file(DIR *curr, const char *fname);
+	hwio_device_mmap * dev_from_dir(int dir_fd, const std::string & name,
+			bool has_compat);
 
-	bool path_stat(const char *fname, struct stat *st);
-	char * file_path_from_stack(const char *fname);
-	FILE * path_fopen(const char *fname, const char *mode);
-	void dev_parse_reg(const char *fname, hwio_phys_addr_t * base,
-			hwio_phys_addr_t * size);
-	std::vector<char *> dev_parse_compat(const char *fname);
-	DIR * opendir_on_stack();
-	DIR * go_next_dir(DIR *curr);
+	/**
+	 * Depth-first walk of the subtree, found devices are appended to devs
+	 * */
+	void walk_subtree(const dir_todo_t & d,
+			std::vector<hwio_device_mmap *> & devs);
 
 public:
 	std::vector<hwio_device_mmap *> _all_devices;
 
 	static const std::string DEFAULT_DEVICE_TREE_PATH;
+	// max number of threads used for scan of the device-tree
+	static const unsigned MAX_SCAN_THREADS;
 
+	/**
+	 * @param access_widths mask of HWIO_ACCESS_* flags enabled for devices
+	 * 		(see hwio_device_mmap::access_widths)
+	 * */
 	hwio_bus_devicetree(
 			const std::string & device_tree_path = DEFAULT_DEVICE_TREE_PATH,
-			const std::string & mem_path = hwio_device_mmap::DEFAULT_MEM_PATH);
+			const std::string & mem_path = hwio_device_mmap::DEFAULT_MEM_PATH,
+			unsigned access_widths = hwio_device_mmap::DEFAULT_ACCESS_WIDTHS);
 
 	virtual std::vector<ihwio_dev *> find_devices(
 			const std::vector<hwio_comp_spec> & spec) override;
+	virtual std::vector<ihwio_dev *> find_devices(
+			const std::vector<hwio_spec_literal> & spec) override {
+		return registry.find(spec);
+	}
 
 	virtual ~hwio_bus_devicetree() {
 		for (auto dev : _all_devices)
@@ -0,0 +1,225 @@
+#include "hwio_bus_fdt.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+using namespace std;
+namespace hwio {
+
+class fdt_format_err: public runtime_error {
+	using runtime_error::runtime_error;
+};
+
+const std::string hwio_bus_fdt::DEFAULT_FDT_PATH = "/sys/firmware/fdt";
+
+static const uint32_t FDT_MAGIC = 0xd00dfeed;
+// tokens of struct block
+static const uint32_t FDT_BEGIN_NODE = 1;
+static const uint32_t FDT_END_NODE = 2;
+static const uint32_t FDT_PROP = 3;
+static const uint32_t FDT_NOP = 4;
+static const uint32_t FDT_END = 9;
+
+/*
+ * Header of flattened device tree, all values are big endian
+ * */
+struct fdt_header {
+	uint32_t magic;
+	uint32_t totalsize;
+	uint32_t off_dt_struct;
+	uint32_t off_dt_strings;
+	uint32_t off_mem_rsvmap;
+	uint32_t version;
+	uint32_t last_comp_version;
+	uint32_t boot_cpuid_phys;
+	uint32_t size_dt_strings;
+	uint32_t size_dt_struct;
+};
+
+static uint32_t fdt32(const uint8_t * p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+static size_t fdt_align(size_t off) {
+	return (off + 3) & ~size_t(3);
+}
+
+/*
+ * Properties of node which are required for device
+ * */
+struct fdt_node {
+	const char * name;
+	const uint8_t * reg;
+	uint32_t reg_len;
+	const char * compat;
+	uint32_t compat_len;
+};
+
+static bool fdtDevAddrCmp(hwio_device_mmap * a, hwio_device_mmap * b) {
+	return a->on_bus_base_addr < b->on_bus_base_addr;
+}
+
+hwio_bus_fdt::hwio_bus_fdt(const std::string & fdt_path,
+		const std::string & mem_path, unsigned access_widths) :
+		mem_path(mem_path), dev_access_widths(access_widths) {
+	int fd = open(fdt_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw fdt_format_err(
+				std::string("Can not open flattened device-tree:") + fdt_path);
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < (off_t) sizeof(fdt_header)) {
+		close(fd);
+		throw fdt_format_err(
+				std::string("Flattened device-tree too small:") + fdt_path);
+	}
+	size_t size = st.st_size;
+	void * blob = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	std::vector<uint8_t> data;
+	if (blob == MAP_FAILED) {
+		// /sys/firmware/fdt does not support mmap
+		data.resize(size);
+		size_t rd = 0;
+		while (rd < size) {
+			ssize_t r = read(fd, &data[rd], size - rd);
+			if (r < 0 && errno == EINTR)
+				continue;
+			if (r <= 0)
+				break;
+			rd += r;
+		}
+		data.resize(rd);
+	}
+	close(fd);
+
+	try {
+		if (blob == MAP_FAILED)
+			parse(data.data(), data.size());
+		else
+			parse(reinterpret_cast<const uint8_t *>(blob), size);
+	} catch (const fdt_format_err & err) {
+		if (blob != MAP_FAILED)
+			munmap(blob, size);
+		for (auto dev : _all_devices)
+			delete dev;
+		throw fdt_format_err(std::string(err.what()) + ": " + fdt_path);
+	}
+	if (blob != MAP_FAILED)
+		munmap(blob, size);
+
+	std::sort(_all_devices.begin(), _all_devices.end(), fdtDevAddrCmp);
+	registry.build(_all_devices);
+}
+
+void hwio_bus_fdt::parse(const uint8_t * blob, size_t blob_size) {
+	if (blob_size < sizeof(fdt_header))
+		throw fdt_format_err("Flattened device-tree too small");
+	const uint8_t * h = blob;
+	if (fdt32(h + offsetof(fdt_header, magic)) != FDT_MAGIC)
+		throw fdt_format_err("Wrong magic of flattened device-tree");
+	size_t total = fdt32(h + offsetof(fdt_header, totalsize));
+	size_t off_struct = fdt32(h + offsetof(fdt_header, off_dt_struct));
+	size_t off_strings = fdt32(h + offsetof(fdt_header, off_dt_strings));
+	size_t size_strings = fdt32(h + offsetof(fdt_header, size_dt_strings));
+	size_t size_struct = fdt32(h + offsetof(fdt_header, size_dt_struct));
+	if (fdt32(h + offsetof(fdt_header, version)) < 17)
+		// size of struct block is not present in older versions
+		size_struct = total - std::min(total, off_struct);
+	if (total > blob_size || off_struct > total
+			|| size_struct > total - off_struct || off_strings > total
+			|| size_strings > total - off_strings)
+		throw fdt_format_err("Corrupted header of flattened device-tree");
+
+	const char * strings = reinterpret_cast<const char *>(blob + off_strings);
+	size_t off = off_struct;
+	const size_t end = off_struct + size_struct;
+	std::vector<fdt_node> stack;
+	while (true) {
+		if (off + sizeof(uint32_t) > end)
+			throw fdt_format_err("Unexpected end of flattened device-tree");
+		uint32_t token = fdt32(blob + off);
+		off += sizeof(uint32_t);
+		switch (token) {
+		case FDT_BEGIN_NODE: {
+			const char * name = reinterpret_cast<const char *>(blob + off);
+			size_t len = strnlen(name, end - off);
+			if (len == end - off)
+				throw fdt_format_err("Unterminated name of node");
+			stack.push_back( { name, nullptr, 0, nullptr, 0 });
+			off = fdt_align(off + len + 1);
+			break;
+		}
+		case FDT_END_NODE: {
+			if (stack.empty())
+				throw fdt_format_err("Unexpected end of node");
+			fdt_node n = stack.back();
+			stack.pop_back();
+			// the root is never a device, reg of other size than 2x 32b
+			// is not supported (same as hwio_bus_devicetree)
+			if (stack.empty() || n.reg == nullptr
+					|| n.reg_len != 2 * sizeof(hwio_phys_addr_t))
+				break;
+
+			vector<hwio_comp_spec> spec;
+			for (uint32_t i = 0; i < n.compat_len;) {
+				const char * s = n.compat + i;
+				size_t l = strnlen(s, n.compat_len - i);
+				spec.push_back(hwio_comp_spec(std::string(s, l)));
+				i += l + 1;
+			}
+			auto dev = new hwio_device_mmap(spec, fdt32(n.reg),
+					fdt32(n.reg + sizeof(hwio_phys_addr_t)), mem_path);
+			dev->name(n.name);
+			dev->access_widths(dev_access_widths);
+			_all_devices.push_back(dev);
+			break;
+		}
+		case FDT_PROP: {
+			if (off + 2 * sizeof(uint32_t) > end)
+				throw fdt_format_err("Unexpected end of property");
+			uint32_t len = fdt32(blob + off);
+			uint32_t nameoff = fdt32(blob + off + sizeof(uint32_t));
+			off += 2 * sizeof(uint32_t);
+			if (len > end - off || nameoff >= size_strings
+					|| strnlen(strings + nameoff, size_strings - nameoff)
+							== size_strings - nameoff)
+				throw fdt_format_err("Corrupted property");
+			if (stack.empty())
+				throw fdt_format_err("Property outside of node");
+			const char * name = strings + nameoff;
+			fdt_node & n = stack.back();
+			if (!strcmp(name, "reg")) {
+				n.reg = blob + off;
+				n.reg_len = len;
+			} else if (!strcmp(name, "compatible")) {
+				n.compat = reinterpret_cast<const char *>(blob + off);
+				n.compat_len = len;
+			}
+			off = fdt_align(off + len);
+			break;
+		}
+		case FDT_NOP:
+			break;
+		case FDT_END:
+			if (!stack.empty())
+				throw fdt_format_err("Unterminated node");
+			return;
+		default:
+			throw fdt_format_err("Unknown token in flattened device-tree");
+		}
+	}
+}
+
+vector<ihwio_dev *> hwio_bus_fdt::find_devices(
+		const vector<hwio_comp_spec> & spec) {
+	return registry.find(spec);
+}
+
+}
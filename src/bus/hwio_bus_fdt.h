@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ihwio_bus.h"
+#include "hwio_device_mmap.h"
+#include "hwio_device_registry.h"
+
+namespace hwio {
+
+/**
+ * Bus with devices generated from flattened device tree blob (.dtb)
+ *
+ * The blob is mapped to memory and parsed in a single pass, it results
+ * in the same devices as hwio_bus_devicetree on the unpacked device-tree
+ * (nodes with 32b "reg" property and optional "compatible" strings).
+ * */
+class hwio_bus_fdt: public ihwio_bus {
+	const std::string mem_path;
+	// HWIO_ACCESS_* flags of devices on this bus
+	const unsigned dev_access_widths;
+	hwio_device_registry registry;
+
+	/**
+	 * Parse struct block of fdt and create devices in _all_devices
+	 * */
+	void parse(const uint8_t * blob, size_t blob_size);
+
+public:
+	std::vector<hwio_device_mmap *> _all_devices;
+
+	static const std::string DEFAULT_FDT_PATH;
+
+	/**
+	 * @param access_widths mask of HWIO_ACCESS_* flags enabled for devices
+	 * 		(see hwio_device_mmap::access_widths)
+	 * */
+	hwio_bus_fdt(const std::string & fdt_path = DEFAULT_FDT_PATH,
+			const std::string & mem_path = hwio_device_mmap::DEFAULT_MEM_PATH,
+			unsigned access_widths = hwio_device_mmap::DEFAULT_ACCESS_WIDTHS);
+
+	virtual std::vector<ihwio_dev *> find_devices(
+			const std::vector<hwio_comp_spec> & spec) override;
+	virtual std::vector<ihwio_dev *> find_devices(
+			const std::vector<hwio_spec_literal> & spec) override {
+		return registry.find(spec);
+	}
+
+	virtual ~hwio_bus_fdt() {
+		for (auto dev : _all_devices)
+			delete dev;
+	}
+};
+
+}
@@ -49,21 +49,53 @@ hwio_device_mmap * parse_device(boost::property_tree::ptree& src,
 	return new hwio_device_mmap(specs, offset + _base, _size, mem_file_path);
 }
 
-void hwio_bus_json::load_devices(boost::property_tree::ptree& root) {
+unsigned hwio_access_widths_from_ptree(boost::property_tree::ptree& n,
+		unsigned default_widths) {
+	auto widths = n.get_child_optional("access_widths");
+	if (!widths)
+		return default_widths;
+	if (widths->empty())
+		throw wrong_format("access_widths has to be a list of widths in bits");
+	unsigned res = HWIO_ACCESS_8;
+	for (boost::property_tree::ptree::value_type& item : *widths) {
+		auto w = item.second.get_value<std::string>();
+		if (w == "8")
+			res |= HWIO_ACCESS_8;
+		else if (w == "16")
+			res |= HWIO_ACCESS_16;
+		else if (w == "32")
+			res |= HWIO_ACCESS_32;
+		else if (w == "64")
+			res |= HWIO_ACCESS_64;
+		else
+			throw wrong_format(
+					std::string("unknown access width (") + w
+							+ "), expected 8, 16, 32 or 64");
+	}
+	return res;
+}
+
+void hwio_bus_json::load_devices(boost::property_tree::ptree& root,
+		unsigned access_widths) {
 		std::string mem_file = root.get<std::string>("memfile", hwio_device_mmap::DEFAULT_MEM_PATH);
 		std::string offset_str = root.get<std::string>("offset", "0");
 		hwio_phys_addr_t offset = std::stoul(offset_str.c_str(), nullptr, 16);
+		access_widths = hwio_access_widths_from_ptree(root, access_widths);
 		for (value_type &d : root.get_child("devices")) {
 			auto dev = parse_device(d.second, offset, mem_file);
+			dev->access_widths(access_widths);
 			_all_devices.push_back(dev);
 		}
+		registry.build(_all_devices);
 }
 
-hwio_bus_json::hwio_bus_json(boost::property_tree::ptree& doc) {
-	load_devices(doc);
+hwio_bus_json::hwio_bus_json(boost::property_tree::ptree& doc,
+		unsigned access_widths) {
+	load_devices(doc, access_widths);
 }
 
-hwio_bus_json::hwio_bus_json(const std::string& file_name) {
+hwio_bus_json::hwio_bus_json(const std::string& file_name,
+		unsigned access_widths) {
 	/*
 	 * this initialize the library and check potential ABI mismatches
 	 * between the version it was compiled for and the actual shared
@@ -76,12 +108,12 @@ hwio_bus_json::hwio_bus_json(const std::string& file_name) {
 	}
 	ptree doc;
 	boost::property_tree::read_json(file_name, doc);
-	load_devices(doc);
+	load_devices(doc, access_widths);
 }
 
 std::vector<ihwio_dev *> hwio_bus_json::find_devices(
 		const std::vector<hwio_comp_spec> & spec) {
-	return filter_device_by_spec(_all_devices, spec);
+	return registry.find(spec);
 }
 
 hwio_bus_json::~hwio_bus_json() {
@@ -5,6 +5,8 @@
 #include <boost/property_tree/json_parser.hpp>
 
 #include "ihwio_bus.h"
+#include "hwio_device_mmap.h"
+#include "hwio_device_registry.h"
 
 namespace hwio {
 
@@ -12,23 +14,43 @@ class wrong_format: public std::runtime_error {
 	using std::runtime_error::runtime_error;
 };
 
+/**
+ * Parse "access_widths" of bus description, list of widths in bits
+ * (e.g. "access_widths": [8, 16, 32, 64])
+ *
+ * @return mask of HWIO_ACCESS_* flags (HWIO_ACCESS_8 is always enabled)
+ * 		or default_widths if the node does not have "access_widths"
+ * @throw wrong_format
+ **/
+unsigned hwio_access_widths_from_ptree(boost::property_tree::ptree& n,
+		unsigned default_widths);
+
 /**
  * Spot devices from description in json file
+ *
+ * "access_widths" in the description overrides access_widths of constructor
  **/
 class hwio_bus_json: public ihwio_bus {
 public:
 	using ptree = boost::property_tree::ptree;
 	using value_type = boost::property_tree::ptree::value_type;
 private:
-	void load_devices(ptree& doc);
+	hwio_device_registry registry;
+	void load_devices(ptree& doc, unsigned access_widths);
 public:
 	std::vector<ihwio_dev *> _all_devices;
 
 	hwio_bus_json(const hwio_bus_json & other) = delete;
-	hwio_bus_json(ptree& doc);
-	hwio_bus_json(const std::string& file_name);
+	hwio_bus_json(ptree& doc,
+			unsigned access_widths = hwio_device_mmap::DEFAULT_ACCESS_WIDTHS);
+	hwio_bus_json(const std::string& file_name,
+			unsigned access_widths = hwio_device_mmap::DEFAULT_ACCESS_WIDTHS);
 	virtual std::vector<ihwio_dev *> find_devices(
 			const std::vector<hwio_comp_spec> & spec) override;
+	virtual std::vector<ihwio_dev *> find_devices(
+			const std::vector<hwio_spec_literal> & spec) override {
+		return registry.find(spec);
+	}
 	virtual ~hwio_bus_json() override;
 };
 
@@ -2,9 +2,25 @@
 
 namespace hwio {
 
+void hwio_bus_primitive::sync_registry() {
+	if (indexed_devices != _all_devices) {
+		indexed_devices = _all_devices;
+		registry.build(indexed_devices);
+	}
+}
+
 std::vector<ihwio_dev *> hwio_bus_primitive::find_devices(
 		const std::vector<hwio_comp_spec> & spec) {
-	return filter_device_by_spec(_all_devices, spec);
+	std::lock_guard<std::mutex> lock(registry_lock);
+	sync_registry();
+	return registry.find(spec);
+}
+
+std::vector<ihwio_dev *> hwio_bus_primitive::find_devices(
+		const std::vector<hwio_spec_literal> & spec) {
+	std::lock_guard<std::mutex> lock(registry_lock);
+	sync_registry();
+	return registry.find(spec);
 }
 
 }
@@ -1,17 +1,37 @@
 #pragma once
 
+#include <mutex>
+
 #include "ihwio_bus.h"
+#include "hwio_device_registry.h"
 
 namespace hwio {
 
 /**
  * Bus which has vector of devices and can perform device lookup from this vector
+ *
+ * _all_devices can be modified directly, the index of devices is rebuilt
+ * on next lookup if _all_devices differs from the indexed devices.
  * */
 class hwio_bus_primitive: public ihwio_bus {
+	hwio_device_registry registry;
+	// copy of _all_devices from the last build of registry
+	std::vector<ihwio_dev *> indexed_devices;
+	std::mutex registry_lock;
+
+	/*
+	 * Rebuild the registry if _all_devices has changed
+	 * (registry_lock has to be held)
+	 * */
+	void sync_registry();
+
 public:
 	std::vector<ihwio_dev *> _all_devices;
+
 	virtual std::vector<ihwio_dev *> find_devices(
 			const std::vector<hwio_comp_spec> & spec) override;
+	virtual std::vector<ihwio_dev *> find_devices(
+			const std::vector<hwio_spec_literal> & spec) override;
 
 	virtual ~hwio_bus_primitive() {
 	}
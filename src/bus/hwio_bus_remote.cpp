@@ -9,8 +9,8 @@
 
 namespace hwio {
 
-hwio_bus_remote::hwio_bus_remote(std::string host) :
-		server(host) {
+hwio_bus_remote::hwio_bus_remote(std::string host, hwio_latency_e latency) :
+		server(host, latency) {
 	server.connect_to_server();
 }
 
@@ -45,6 +45,18 @@ ihwio_dev * hwio_bus_remote::hwio_dev_from_id(std::vector<hwio_comp_spec> spec,
 	return d;
 }
 
+void hwio_bus_remote::max_in_flight(size_t n) {
+	server.max_in_flight(n);
+}
+
+void hwio_bus_remote::batch_begin() {
+	server.batch_begin();
+}
+
+void hwio_bus_remote::batch_end() {
+	server.batch_end();
+}
+
 std::vector<ihwio_dev *> hwio_bus_remote::find_devices(
 		const std::vector<hwio_comp_spec> & spec) {
 
@@ -23,7 +23,12 @@ class hwio_bus_remote: public ihwio_bus {
 
 public:
 	hwio_bus_remote(const hwio_bus_remote & other) = delete;
-	hwio_bus_remote(std::string host);
+	/*
+	 * @param host address of server (see hwio_client_to_server_con)
+	 * @param latency profile of socket options of connection
+	 * */
+	hwio_bus_remote(std::string host,
+			hwio_latency_e latency = HWIO_LATENCY_DEFAULT);
 
 	/**
 	 * Lookup device in seen_devices or construct new and add it to seen_devices
@@ -32,6 +37,18 @@ public:
 	 * */
 	ihwio_dev * hwio_dev_from_id(std::vector<hwio_comp_spec> spec, dev_id_t id);
 
+	/**
+	 * Set maximum number of asynchronous requests in flight on connection to server
+	 * */
+	void max_in_flight(size_t n);
+
+	/**
+	 * Collect following requests and send them together in batch_end
+	 * (see hwio_client_to_server_con::batch_begin)
+	 * */
+	void batch_begin();
+	void batch_end();
+
 	/**
 	 * Iter devices specified by spec.
 	 *
@@ -1,8 +1,12 @@
 #include "hwio_client_to_server_con.h"
 
 #include <unistd.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/uio.h>
 #include <sstream>
 #include <assert.h>
+#include <algorithm>
 
 #include "ihwio_dev.h"
 #include "hwio_remote_utils.h"
@@ -23,10 +27,27 @@ const int r_flag = 0;
 #endif
 
 const size_t hwio_client_to_server_con::DEV_TIMEOUT = 500000;
+const size_t hwio_client_to_server_con::DEFAULT_MAX_IN_FLIGHT = 64;
 
-hwio_client_to_server_con::hwio_client_to_server_con(std::string host) :
-		sockfd(-1), orig_addr(host) {
-	addr = parse_ip_and_port(host);
+bool hwio_async_token::done() const {
+	return con == nullptr || con->async_done(tag);
+}
+
+void hwio_async_token::wait() {
+	if (con != nullptr)
+		con->async_wait(tag);
+}
+
+void hwio_async_token::cancel() {
+	if (con != nullptr)
+		con->async_cancel(tag);
+}
+
+hwio_client_to_server_con::hwio_client_to_server_con(std::string host,
+		hwio_latency_e latency) :
+		sockfd(-1), shm(nullptr), in_flight(DEFAULT_MAX_IN_FLIGHT), in_flight_cnt(0),
+		last_tag(0), latency(latency), corked(false), orig_addr(host) {
+	addr = parse_addr(host);
 }
 
 void hwio_client_to_server_con::connect_to_server() {
@@ -48,20 +69,144 @@ void hwio_client_to_server_con::connect_to_server() {
 						"[HWIO] Can not connect to server: (error: ") + strerror(ret)
 								+ ", address: " + orig_addr + " )");
 	}
+	socket_set_latency(sockfd, latency);
 
 	ret = ping();
 	if (ret < 0) {
 		throw std::runtime_error("[HWIO] Initial ping to server has failed");
 	}
+	if (orig_addr.compare(0, strlen(SHM_ADDR_PREFIX), SHM_ADDR_PREFIX) == 0)
+		attach_shm();
+}
+
+void hwio_client_to_server_con::attach_shm() {
+	auto f = reinterpret_cast<HwioFrame<ShmAttachReq>*>(tx_buffer);
+	f->header.command = HWIO_CMD_SHM_ATTACH;
+	f->header.body_len = sizeof(ShmAttachReq);
+	f->body.ring_size = 0;
+	tx_pckt();
+
+	// file descriptors of shared memory are attached to the header of response
+	Hwio_packet_header header;
+	int fds[3];
+	union {
+		char buf[CMSG_SPACE(sizeof(fds))];
+		struct cmsghdr align;
+	} cmsg_buf;
+	struct iovec iov;
+	iov.iov_base = &header;
+	iov.iov_len = sizeof(header);
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg_buf.buf;
+	msg.msg_controllen = sizeof(cmsg_buf.buf);
+	ssize_t result;
+	do {
+		result = recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+	} while (result < 0 && errno == EINTR);
+	if (result <= 0)
+		throw std::runtime_error(
+				std::string("[HWIO] Can not receive shm attach response: ")
+						+ strerror(errno));
+	if (size_t(result) < sizeof(header))
+		rx_bytes(reinterpret_cast<uint8_t *>(&header) + result,
+				sizeof(header) - result);
+
+	bool has_fds = false;
+	struct cmsghdr * c = CMSG_FIRSTHDR(&msg);
+	if (c != nullptr && c->cmsg_level == SOL_SOCKET
+			&& c->cmsg_type == SCM_RIGHTS
+			&& c->cmsg_len == CMSG_LEN(sizeof(fds))) {
+		memcpy(fds, CMSG_DATA(c), sizeof(fds));
+		has_fds = true;
+	}
+
+	rx_body(header);
+	if (header.command != HWIO_CMD_SHM_ATTACH_RESP || !has_fds
+			|| header.body_len != sizeof(ShmAttachResp)) {
+		if (has_fds)
+			for (int fd : fds)
+				close(fd);
+		std::stringstream ss;
+		ss << "[HWIO] Server refused shared memory transport";
+		if (header.command == HWIO_CMD_MSG) {
+			auto err = reinterpret_cast<ErrMsg*>(rx_buffer);
+			ss << " " << err->err_code << ": " << err->msg;
+		}
+		throw std::runtime_error(ss.str());
+	}
+	auto r = reinterpret_cast<ShmAttachResp*>(rx_buffer);
+	shm = new hwio_shm_channel(fds[0], fds[1], fds[2], r->ring_size);
+}
+
+void hwio_client_to_server_con::shm_rx_bytes(void * dst, size_t size) {
+	hwio_shm_ring * r = shm->resp;
+	uint8_t * d = reinterpret_cast<uint8_t *>(dst);
+	while (size) {
+		size_t n = r->read(d, size);
+		if (n) {
+			d += n;
+			size -= n;
+			continue;
+		}
+		if (r->spin_wait() || !r->prepare_sleep())
+			continue;
+
+		// the socket is used only to detect that server has closed connection
+		struct pollfd pfds[2];
+		pfds[0].fd = r->event_fd();
+		pfds[0].events = POLLIN;
+		pfds[1].fd = sockfd;
+		pfds[1].events = POLLIN;
+		int err = poll(pfds, 2, -1);
+		r->wake_up();
+		if (err < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("rx_bytes: ") + strerror(errno));
+		}
+		if (pfds[1].revents && !r->readable())
+			throw std::runtime_error("rx_bytes: connection closed by server");
+	}
 }
 
-int hwio_client_to_server_con::rx_bytes(size_t size) {
+void hwio_client_to_server_con::shm_tx_bytes(const void * src, size_t size) {
+	hwio_shm_ring * r = shm->req;
+	const uint8_t * s = reinterpret_cast<const uint8_t *>(src);
+	while (size) {
+		size_t n = r->write(s, size);
+		s += n;
+		size -= n;
+		if (n == 0) {
+			// ring is full, server is processing the requests
+			r->notify();
+			struct pollfd pfd;
+			pfd.fd = sockfd;
+			pfd.events = POLLIN;
+			if (poll(&pfd, 1, 0) > 0)
+				throw hwio_error_rw(
+						"hwio_client_to_server_con::tx_pckt, connection closed by server");
+			sched_yield();
+		}
+	}
+}
+
+int hwio_client_to_server_con::rx_bytes(void * dst, size_t size) {
+	if (shm) {
+		shm_rx_bytes(dst, size);
+		return 0;
+	}
+	// the requests of batch have to be sent before waiting on response
+	if (corked)
+		batch_end();
 	size_t bytesRead = 0;
 	int result;
-	assert(size <= BUFFER_SIZE);
+	uint8_t * d = reinterpret_cast<uint8_t *>(dst);
 	while (bytesRead < size) {
 		errno = 0;
-		result = recv(sockfd, rx_buffer + bytesRead, size - bytesRead, r_flag);
+		result = recv(sockfd, d + bytesRead, size - bytesRead, r_flag);
 		if (result < 0) {
 #ifdef HWIO_BUSY_WAIT_IO_CLIENT
 			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
@@ -73,29 +218,131 @@ int hwio_client_to_server_con::rx_bytes(size_t size) {
 			}
 #endif
 			throw std::runtime_error(std::string("rx_bytes: ") + strerror(errno));
+		} else if (result == 0) {
+			throw std::runtime_error("rx_bytes: connection closed by server");
 		}
 		bytesRead += result;
 	}
 	return 0;
 }
 
-void hwio_client_to_server_con::rx_pckt(Hwio_packet_header * header) {
-	if (rx_bytes(sizeof(Hwio_packet_header)))
+void hwio_client_to_server_con::rx_header(Hwio_packet_header * header) {
+	if (rx_bytes(header, sizeof(Hwio_packet_header)))
 		throw hwio_error_rw("Only partial data received from server");
+}
+
+void hwio_client_to_server_con::rx_body(const Hwio_packet_header & header) {
+	if (header.body_len > BUFFER_SIZE)
+		throw hwio_error_rw("Packet from server does not fit in to rx_buffer");
+	if (header.body_len)
+		if (rx_bytes(rx_buffer, header.body_len))
+			throw hwio_error_rw("Malformed packet received from server");
+}
 
-	*header = *reinterpret_cast<Hwio_packet_header*>(rx_buffer);
-	if (header->body_len)
-		if (rx_bytes(header->body_len))
+void hwio_client_to_server_con::rx_discard(const Hwio_packet_header & header) {
+	size_t rest = header.body_len;
+	while (rest) {
+		size_t n = std::min(rest, sizeof(rx_buffer));
+		if (rx_bytes(rx_buffer, n))
 			throw hwio_error_rw("Malformed packet received from server");
+		rest -= n;
+	}
+}
+
+void hwio_client_to_server_con::rx_pckt(Hwio_packet_header * header) {
+	rx_pckt(header, 0, nullptr, 0);
+}
+
+bool hwio_client_to_server_con::rx_pckt(Hwio_packet_header * header,
+		uint8_t resp_cmd, void * dst, size_t dst_size) {
+	while (true) {
+		rx_header(header);
+		if (header->tag != 0) {
+			rx_async_resp(*header);
+			continue;
+		}
+		if (dst != nullptr && header->command == resp_cmd
+				&& header->body_len == dst_size) {
+			// body is received directly to the buffer of user
+			if (rx_bytes(dst, dst_size))
+				throw hwio_error_rw("Malformed packet received from server");
+			return true;
+		}
+		rx_body(*header);
+		return false;
+	}
+}
+
+void hwio_client_to_server_con::rx_async_resp(
+		const Hwio_packet_header & header) {
+	auto & r = in_flight[header.tag % in_flight.size()];
+	if (!r.pending || r.tag != header.tag) {
+		std::stringstream ss;
+		ss << "Response for unknown request (tag=" << header.tag << ")";
+		throw hwio_error_rw(ss.str());
+	}
+	r.pending = false;
+	in_flight_cnt--;
+
+	if (r.canceled) {
+		// request was canceled, response (or error) is not interesting
+		rx_discard(header);
+		return;
+	}
+	if (header.command != r.resp_cmd || header.body_len != r.resp_size) {
+		rx_body(header);
+		std::stringstream ss;
+		ss << "Wrong response from server on asynchronous request (tag="
+				<< header.tag << ") " << (int) header.command;
+		if (header.command == HWIO_CMD_MSG) {
+			auto err = reinterpret_cast<ErrMsg*>(rx_buffer);
+			ss << err->err_code << ": " << err->msg;
+		}
+		throw hwio_error_rw(ss.str());
+	}
+	// body is received directly to the buffer of user
+	if (rx_bytes(r.resp_dst, r.resp_size))
+		throw hwio_error_rw("Malformed packet received from server");
 }
 
 void hwio_client_to_server_con::tx_pckt() {
+	reinterpret_cast<Hwio_packet_header*>(tx_buffer)->tag = 0;
+	tx_pckt_raw(nullptr, 0);
+}
+
+void hwio_client_to_server_con::tx_pckt(const void * payload,
+		size_t payload_size) {
+	reinterpret_cast<Hwio_packet_header*>(tx_buffer)->tag = 0;
+	tx_pckt_raw(payload, payload_size);
+}
+
+void hwio_client_to_server_con::tx_pckt_raw(const void * payload,
+		size_t payload_size) {
 	Hwio_packet_header * f = reinterpret_cast<Hwio_packet_header*>(tx_buffer);
-	size_t bytesWr = 0;
-	int result;
 	size_t size = f->body_len + sizeof(Hwio_packet_header);
-	while (bytesWr < size) {
-		result = send(sockfd, tx_buffer + bytesWr, size - bytesWr, 0);
+	assert(size >= payload_size);
+
+	if (shm) {
+		shm_tx_bytes(tx_buffer, size - payload_size);
+		if (payload_size)
+			shm_tx_bytes(payload, payload_size);
+		shm->req->notify();
+		return;
+	}
+
+	// header and fixed part of body from tx_buffer, payload from buffer of user
+	struct iovec iov[2];
+	iov[0].iov_base = tx_buffer;
+	iov[0].iov_len = size - payload_size;
+	iov[1].iov_base = const_cast<void *>(payload);
+	iov[1].iov_len = payload_size;
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = payload_size ? 2 : 1;
+
+	while (msg.msg_iovlen) {
+		ssize_t result = sendmsg(sockfd, &msg, 0);
 		if (result < 0) {
 #ifdef HWIO_BUSY_WAIT_IO_CLIENT
 			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
@@ -112,7 +359,117 @@ void hwio_client_to_server_con::tx_pckt() {
 					<< strerror(errno);
 			throw hwio_error_rw(ss.str());
 		}
-		bytesWr += result;
+		// skip the data which was already sent
+		size_t sent = result;
+		while (msg.msg_iovlen && sent >= msg.msg_iov->iov_len) {
+			sent -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen) {
+			msg.msg_iov->iov_base = (uint8_t *) msg.msg_iov->iov_base + sent;
+			msg.msg_iov->iov_len -= sent;
+		}
+	}
+}
+
+hwio_async_token hwio_client_to_server_con::tx_pckt_async(uint8_t resp_cmd,
+		void * resp_dst, size_t resp_size) {
+	auto h = reinterpret_cast<Hwio_packet_header*>(tx_buffer);
+	if (resp_cmd == 0) {
+		// there is no response, request is completed once it is sent
+		h->tag = 0;
+		tx_pckt_raw(nullptr, 0);
+		return hwio_async_token();
+	}
+
+	last_tag++;
+	if (last_tag == 0)
+		last_tag++;
+
+	// wait until the slot for this request is free
+	auto & r = in_flight[last_tag % in_flight.size()];
+	while (r.pending) {
+		Hwio_packet_header resp;
+		rx_header(&resp);
+		if (resp.tag == 0)
+			throw hwio_error_rw("Unexpected response for synchronous request");
+		rx_async_resp(resp);
+	}
+
+	r.pending = true;
+	r.canceled = false;
+	r.tag = last_tag;
+	r.resp_cmd = resp_cmd;
+	r.resp_dst = resp_dst;
+	r.resp_size = resp_size;
+	in_flight_cnt++;
+
+	h->tag = last_tag;
+	tx_pckt_raw(nullptr, 0);
+	return hwio_async_token(this, last_tag);
+}
+
+bool hwio_client_to_server_con::async_done(uint16_t tag) const {
+	auto & r = in_flight[tag % in_flight.size()];
+	return !(r.pending && r.tag == tag);
+}
+
+void hwio_client_to_server_con::async_wait(uint16_t tag) {
+	while (!async_done(tag)) {
+		Hwio_packet_header resp;
+		rx_header(&resp);
+		if (resp.tag == 0)
+			throw hwio_error_rw("Unexpected response for synchronous request");
+		rx_async_resp(resp);
+	}
+}
+
+void hwio_client_to_server_con::async_flush() {
+	for (auto & r : in_flight) {
+		if (r.pending)
+			async_wait(r.tag);
+	}
+	assert(in_flight_cnt == 0);
+}
+
+void hwio_client_to_server_con::async_cancel(uint16_t tag) {
+	auto & r = in_flight[tag % in_flight.size()];
+	if (r.pending && r.tag == tag) {
+		r.canceled = true;
+		r.resp_dst = nullptr;
+	}
+}
+
+void hwio_client_to_server_con::async_cancel_all() {
+	for (auto & r : in_flight) {
+		if (r.pending) {
+			r.canceled = true;
+			r.resp_dst = nullptr;
+		}
+	}
+}
+
+void hwio_client_to_server_con::max_in_flight(size_t n) {
+	if (n == 0)
+		throw std::runtime_error("[HWIO] max_in_flight has to be > 0");
+	async_flush();
+	in_flight.assign(n, pending_req_t());
+}
+
+size_t hwio_client_to_server_con::max_in_flight() const {
+	return in_flight.size();
+}
+
+void hwio_client_to_server_con::batch_begin() {
+	if (!shm && !corked)
+		corked = socket_set_cork(sockfd, true);
+}
+
+void hwio_client_to_server_con::batch_end() {
+	if (corked) {
+		corked = false;
+		socket_set_cork(sockfd, false);
 	}
 }
 
@@ -144,11 +501,15 @@ void hwio_client_to_server_con::bye() {
 
 hwio_client_to_server_con::~hwio_client_to_server_con() {
 	if (sockfd >= 0) {
-		bye();
+		try {
+			bye();
+		} catch (const std::runtime_error & err) {
+			// server has already closed the connection (e.g. after an error)
+		}
+		delete shm;
 		close(sockfd);
 	}
-	if (addr != nullptr)
-		freeaddrinfo(addr);
+	free_addr(addr);
 }
 
 }
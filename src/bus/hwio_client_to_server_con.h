@@ -3,8 +3,11 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <vector>
 
 #include "hwio_remote.h"
+#include "hwio_shm_ring.h"
+#include "hwio_remote_utils.h"
 
 namespace hwio {
 
@@ -12,21 +15,127 @@ class interupt_recieved: public std::runtime_error {
 	using std::runtime_error::runtime_error;
 };
 
+class hwio_client_to_server_con;
+
+/*
+ * Completion token of asynchronous request on server
+ * */
+class hwio_async_token {
+	hwio_client_to_server_con * con;
+	uint16_t tag;
+public:
+	hwio_async_token() :
+			con(nullptr), tag(0) {
+	}
+	hwio_async_token(hwio_client_to_server_con * con, uint16_t tag) :
+			con(con), tag(tag) {
+	}
+
+	/*
+	 * @return true if response for this request was already received
+	 * */
+	bool done() const;
+
+	/*
+	 * Receive responses from server until response for this request is received
+	 *
+	 * @throw hwio_error_rw if server responded with an error
+	 * */
+	void wait();
+
+	/*
+	 * Drop response of this request (if it was not received yet),
+	 * the destination buffer is not touched anymore
+	 * */
+	void cancel();
+};
+
 class hwio_client_to_server_con {
+	/*
+	 * Record about asynchronous request waiting for response
+	 * */
+	struct pending_req_t {
+		bool pending;
+		uint16_t tag;
+		uint8_t resp_cmd;
+		// response is dropped, resp_dst is not valid anymore
+		bool canceled;
+		// buffer for body of response
+		void * resp_dst;
+		size_t resp_size;
+	};
+
 	int sockfd;
 	struct addrinfo * addr;
-	int rx_bytes(size_t size);
+	// shared memory transport used instead of the socket if not nullptr
+	hwio_shm_channel * shm;
+	// slots for requests in flight, indexed by tag % in_flight.size()
+	std::vector<pending_req_t> in_flight;
+	size_t in_flight_cnt;
+	uint16_t last_tag;
+	// profile of socket options applied after connect
+	hwio_latency_e latency;
+	// requests are collected in socket until batch_end (TCP_CORK)
+	bool corked;
+
+	/*
+	 * Receive exactly size bytes in to dst
+	 * */
+	int rx_bytes(void * dst, size_t size);
 	void bye();
+	/*
+	 * Receive header of packet
+	 * */
+	void rx_header(Hwio_packet_header * header);
+	/*
+	 * Receive body of packet to rx_buffer
+	 * */
+	void rx_body(const Hwio_packet_header & header);
+	/*
+	 * Receive body of packet and drop it
+	 * */
+	void rx_discard(const Hwio_packet_header & header);
+	/*
+	 * Send header and fixed part of body from tx_buffer followed by payload
+	 * (header.body_len includes the size of payload)
+	 * */
+	void tx_pckt_raw(const void * payload, size_t payload_size);
+	/*
+	 * Receive body of response for asynchronous request directly to its
+	 * destination buffer and complete the request
+	 * */
+	void rx_async_resp(const Hwio_packet_header & header);
+
+	/*
+	 * Request shared memory transport from server (connection has to be
+	 * on unix domain socket), all next messages are in shared memory
+	 * */
+	void attach_shm();
+	/*
+	 * Receive exactly size bytes from the response ring of shared memory
+	 * */
+	void shm_rx_bytes(void * dst, size_t size);
+	/*
+	 * Copy size bytes to the request ring of shared memory
+	 * */
+	void shm_tx_bytes(const void * src, size_t size);
 
 public:
 	std::string orig_addr;
 	static const char * DEFAULT_SERVER_ADDRESS;
 	static const size_t DEV_TIMEOUT;
+	static const size_t DEFAULT_MAX_IN_FLIGHT;
 
 	uint8_t rx_buffer[BUFFER_SIZE];
 	uint8_t tx_buffer[BUFFER_SIZE];
 
-	hwio_client_to_server_con(std::string host);
+	/*
+	 * @param host address of server ip:port, [ipv6]:port, unix:/path/to.sock
+	 * 	or shm:/path/to.sock (unix domain socket + shared memory transport)
+	 * @param latency profile of socket options
+	 * */
+	hwio_client_to_server_con(std::string host,
+			hwio_latency_e latency = HWIO_LATENCY_DEFAULT);
 
 	/**
 	 * @throw runtime_error
@@ -34,8 +143,88 @@ public:
 	void connect_to_server();
 
 	int ping();
+
+	/*
+	 * Send synchronous request from tx_buffer
+	 * */
 	void tx_pckt();
+	/*
+	 * Send synchronous request from tx_buffer followed by payload without
+	 * copying it to tx_buffer (header.body_len includes the size of payload)
+	 * */
+	void tx_pckt(const void * payload, size_t payload_size);
+	/*
+	 * Receive response for synchronous request to rx_buffer,
+	 * responses for asynchronous requests received meanwhile are completed
+	 * */
 	void rx_pckt(Hwio_packet_header * header);
+	/*
+	 * Receive response for synchronous request, if the response has
+	 * resp_cmd command and size dst_size the body is received directly to dst,
+	 * otherwise it is received to rx_buffer
+	 *
+	 * @return true if the body was received to dst
+	 * */
+	bool rx_pckt(Hwio_packet_header * header, uint8_t resp_cmd, void * dst,
+			size_t dst_size);
+
+	/*
+	 * Send request from tx_buffer without waiting on response,
+	 * if the window of requests in flight is full wait for the oldest one,
+	 * body of response is received directly to resp_dst
+	 *
+	 * @param resp_cmd expected command of response, 0 if there is no response
+	 * @param resp_dst buffer for body of response
+	 * @param resp_size size of body of response
+	 * @return token which can be used to wait on response
+	 * */
+	hwio_async_token tx_pckt_async(uint8_t resp_cmd, void * resp_dst,
+			size_t resp_size);
+
+	/*
+	 * @return true if response for asynchronous request with this tag was received
+	 * */
+	bool async_done(uint16_t tag) const;
+
+	/*
+	 * Receive responses until response for request with this tag is received
+	 * */
+	void async_wait(uint16_t tag);
+
+	/*
+	 * Wait for all asynchronous requests in flight
+	 * */
+	void async_flush();
+
+	/*
+	 * Cancel asynchronous request, its response is later received and dropped
+	 * (also an error) and its destination buffer is not touched anymore,
+	 * has to be used on error path of each caller which has more requests
+	 * in flight before it releases their buffers
+	 * */
+	void async_cancel(uint16_t tag);
+	/*
+	 * Cancel all asynchronous requests in flight
+	 * */
+	void async_cancel_all();
+
+	/*
+	 * Set maximum number of asynchronous requests in flight,
+	 * all pending requests are completed first
+	 * */
+	void max_in_flight(size_t n);
+	size_t max_in_flight() const;
+
+	/*
+	 * Start explicit batch of (asynchronous) requests, the requests are
+	 * sent in full segments until batch_end or until some response is awaited
+	 * (has effect only on TCP connection)
+	 * */
+	void batch_begin();
+	/*
+	 * Send all requests of the batch
+	 * */
+	void batch_end();
 
 	~hwio_client_to_server_con();
 };
@@ -0,0 +1,171 @@
+#include "hwio_device_registry.h"
+
+#include <algorithm>
+
+namespace hwio {
+
+void hwio_device_registry::build(const std::vector<ihwio_dev *> & devices) {
+	this->devices = devices;
+	entries.clear();
+	by_name.clear();
+	by_type.clear();
+	any_type.clear();
+	by_vendor.clear();
+	any_vendor.clear();
+
+	for (uint32_t d = 0; d < devices.size(); d++) {
+		auto dev = devices[d];
+		auto & dev_specs = dev->get_spec();
+		if (dev_specs.size() == 0) {
+			// device is found only by name
+			auto & name = dev->name();
+			if (name == "")
+				continue;
+			hwio_comp_spec s;
+			s.name_set(name);
+			by_name[name].push_back(entries.size());
+			entries.push_back( { d, true, s, hwio_atom(), hwio_atom() });
+			continue;
+		}
+		for (auto & ds : dev_specs) {
+			uint32_t e = entries.size();
+			entries.push_back( { d, false, ds, hwio_atom::intern(ds.vendor),
+					hwio_atom::intern(ds.type) });
+			if (ds.name != "")
+				by_name[ds.name].push_back(e);
+			if (ds.type != "")
+				by_type[entries.back().type].push_back(e);
+			else
+				any_type.push_back(e);
+			if (ds.vendor != "")
+				by_vendor[entries.back().vendor].push_back(e);
+			else
+				any_vendor.push_back(e);
+		}
+	}
+}
+
+template<typename FN_T>
+void hwio_device_registry::for_candidates(const hwio_atom * vendor,
+		const hwio_atom * type, FN_T fn) const {
+	// (empty atom is never a key, only entries with wildcard are candidates)
+	if (type != nullptr) {
+		auto t = by_type.find(*type);
+		if (t != by_type.end())
+			for (auto e : t->second)
+				fn(entries[e]);
+		for (auto e : any_type)
+			fn(entries[e]);
+	} else if (vendor != nullptr) {
+		auto v = by_vendor.find(*vendor);
+		if (v != by_vendor.end())
+			for (auto e : v->second)
+				fn(entries[e]);
+		for (auto e : any_vendor)
+			fn(entries[e]);
+	} else {
+		// type and vendor wildcard, all entries are candidates
+		for (auto & e : entries)
+			fn(e);
+	}
+}
+
+/*
+ * Same as hwio_comp_spec::operator== for specs where name is not used
+ * and type already matches
+ * */
+static bool vendor_version_match(const hwio_comp_spec & a,
+		const hwio_comp_spec & b) {
+	if (a.vendor != "" && b.vendor != "" && a.vendor != b.vendor)
+		return false;
+	return a.version == b.version;
+}
+
+void hwio_device_registry::lookup_by_type(const hwio_comp_spec & s,
+		bool unnamed_only, std::vector<uint32_t> & res) const {
+	auto check = [&](const entry_t & e) {
+		if (e.name_only || (unnamed_only && e.spec.name != ""))
+			return;
+		if (vendor_version_match(e.spec, s))
+			res.push_back(e.dev);
+	};
+
+	// if vendor/type is not interned no device has it
+	hwio_atom type, vendor;
+	if (s.type != "")
+		hwio_atom::find(s.type, type);
+	if (s.vendor != "")
+		hwio_atom::find(s.vendor, vendor);
+	for_candidates(s.vendor != "" ? &vendor : nullptr,
+			s.type != "" ? &type : nullptr, check);
+}
+
+void hwio_device_registry::lookup(const hwio_spec_literal & s,
+		std::vector<uint32_t> & res) const {
+	// literal does not have name, only atoms are compared
+	auto check = [&](const entry_t & e) {
+		if (!e.name_only && s.matches(e.vendor, e.type, e.spec.version))
+			res.push_back(e.dev);
+	};
+	for_candidates(s.vendor.empty() ? nullptr : &s.vendor,
+			s.type.empty() ? nullptr : &s.type, check);
+}
+
+void hwio_device_registry::lookup(const hwio_comp_spec & s,
+		std::vector<uint32_t> & res) const {
+	if (s.name != "") {
+		// if both have name only name is compared
+		auto n = by_name.find(s.name);
+		if (n != by_name.end())
+			for (auto e : n->second)
+				res.push_back(entries[e].dev);
+		lookup_by_type(s, true, res);
+	} else {
+		lookup_by_type(s, false, res);
+	}
+}
+
+void hwio_device_registry::devices_from_indexes(std::vector<uint32_t> & found,
+		std::vector<ihwio_dev *> & res) const {
+	std::sort(found.begin(), found.end());
+	found.erase(std::unique(found.begin(), found.end()), found.end());
+
+	res.clear();
+	for (auto d : found)
+		res.push_back(devices[d]);
+}
+
+// indexes of found devices, reused by lookups of the thread
+static thread_local std::vector<uint32_t> found_buff;
+
+void hwio_device_registry::find(const std::vector<hwio_comp_spec> & spec,
+		std::vector<ihwio_dev *> & res) const {
+	found_buff.clear();
+	for (auto & s : spec)
+		lookup(s, found_buff);
+	devices_from_indexes(found_buff, res);
+}
+
+void hwio_device_registry::find(const std::vector<hwio_spec_literal> & spec,
+		std::vector<ihwio_dev *> & res) const {
+	found_buff.clear();
+	for (auto & s : spec)
+		lookup(s, found_buff);
+	devices_from_indexes(found_buff, res);
+}
+
+std::vector<ihwio_dev *> hwio_device_registry::find(
+		const std::vector<hwio_comp_spec> & spec) const {
+	std::vector<ihwio_dev *> res;
+	find(spec, res);
+	return res;
+}
+
+std::vector<ihwio_dev *> hwio_device_registry::find(
+		const std::vector<hwio_spec_literal> & spec) const {
+	std::vector<ihwio_dev *> res;
+	find(spec, res);
+	return res;
+}
+
+}
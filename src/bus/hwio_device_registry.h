@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hwio_comp_spec.h"
+#include "hwio_comp_spec_literal.h"
+#include "ihwio_dev.h"
+
+namespace hwio {
+
+/**
+ * Index of devices for lookup by hwio_comp_spec
+ *
+ * Results are the same as ihwio_bus::filter_device_by_spec (including order
+ * of devices), but compatibility specs of devices are indexed by name
+ * and by type, vendor and version wildcards are checked only on candidates.
+ * Vendor and type of devices are interned, so lookup by hwio_spec_literal
+ * compares only atoms.
+ *
+ * The index has to be (re)built by build() when the set of devices changes,
+ * find() does not modify the registry and can be called from multiple threads.
+ * */
+class hwio_device_registry {
+	struct entry_t {
+		// index of device in devices
+		uint32_t dev;
+		// device does not have any spec, entry is matched only by name
+		bool name_only;
+		hwio_comp_spec spec;
+		hwio_atom vendor;
+		hwio_atom type;
+	};
+
+	std::vector<ihwio_dev *> devices;
+	std::vector<entry_t> entries;
+	// name -> indexes of entries with this name
+	std::unordered_map<std::string, std::vector<uint32_t>> by_name;
+	// type -> indexes of entries with this type
+	std::unordered_map<hwio_atom, std::vector<uint32_t>, hwio_atom::hasher> by_type;
+	// entries with empty type (matches any type)
+	std::vector<uint32_t> any_type;
+	// vendor -> indexes of entries with this vendor (for type wildcards)
+	std::unordered_map<hwio_atom, std::vector<uint32_t>, hwio_atom::hasher> by_vendor;
+	// entries with empty vendor (matches any vendor)
+	std::vector<uint32_t> any_vendor;
+
+	/**
+	 * Add indexes of devices matching the spec to res
+	 * */
+	void lookup(const hwio_comp_spec & s, std::vector<uint32_t> & res) const;
+	void lookup(const hwio_spec_literal & s, std::vector<uint32_t> & res) const;
+	void lookup_by_type(const hwio_comp_spec & s, bool unnamed_only,
+			std::vector<uint32_t> & res) const;
+	/*
+	 * Call fn for each entry which can match vendor and type
+	 * (candidates of type, or of vendor if type is a wildcard)
+	 * */
+	template<typename FN_T>
+	void for_candidates(const hwio_atom * vendor, const hwio_atom * type,
+			FN_T fn) const;
+	/*
+	 * Store devices on indexes in found to res in the original order,
+	 * each only once
+	 * */
+	void devices_from_indexes(std::vector<uint32_t> & found,
+			std::vector<ihwio_dev *> & res) const;
+
+public:
+	/**
+	 * Rebuild the index for specified devices
+	 * */
+	void build(const std::vector<ihwio_dev *> & devices);
+	template<typename DEV_T>
+	void build(const std::vector<DEV_T *> & devs) {
+		build(std::vector<ihwio_dev *>(devs.begin(), devs.end()));
+	}
+
+	/**
+	 * Find devices specified by spec in devices of last build()
+	 * */
+	std::vector<ihwio_dev *> find(
+			const std::vector<hwio_comp_spec> & spec) const;
+	std::vector<ihwio_dev *> find(
+			const std::vector<hwio_spec_literal> & spec) const;
+	/**
+	 * Same as find(spec), found devices are stored in to res (res is cleared
+	 * first, its capacity is reused so repeated lookups do not allocate)
+	 * */
+	void find(const std::vector<hwio_comp_spec> & spec,
+			std::vector<ihwio_dev *> & res) const;
+	void find(const std::vector<hwio_spec_literal> & spec,
+			std::vector<ihwio_dev *> & res) const;
+};
+
+}
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "hwio_comp_spec.h"
+#include "hwio_comp_spec_literal.h"
 #include "ihwio_dev.h"
 
 namespace hwio {
@@ -13,18 +14,18 @@ namespace hwio {
 class ihwio_bus {
 public:
 	static std::vector<ihwio_dev*> filter_device_by_spec(
-			const std::vector<ihwio_dev*> devices,
-			const std::vector<hwio_comp_spec> spec) {
+			const std::vector<ihwio_dev*> & devices,
+			const std::vector<hwio_comp_spec> & spec) {
 		/**
 		 * * Name is identifier of device
 		 * * Device can have more compatibility strings
 		 **/
 		std::vector<ihwio_dev *> res;
 		for (auto dev : devices) {
-			auto dev_specs = dev->get_spec();
+			auto & dev_specs = dev->get_spec();
 			if (dev_specs.size() == 0) {
 				// search all name matches
-				auto name = dev->name();
+				auto & name = dev->name();
 				if (name != "")
 					for (auto & s : spec) {
 						if (s.name != "" && name == s.name) {
@@ -58,6 +59,16 @@ public:
 	virtual std::vector<ihwio_dev *> find_devices(
 			const std::vector<hwio_comp_spec> & spec) = 0;
 
+	/**
+	 * Find devices specified by _hwio_spec literals
+	 * (default implementation converts them to hwio_comp_spec)
+	 */
+	virtual std::vector<ihwio_dev *> find_devices(
+			const std::vector<hwio_spec_literal> & spec) {
+		return find_devices(
+				std::vector<hwio_comp_spec>(spec.begin(), spec.end()));
+	}
+
 	virtual ~ihwio_bus() {
 	}
 };
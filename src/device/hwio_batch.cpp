@@ -0,0 +1,50 @@
+#include "hwio_batch.h"
+
+namespace hwio {
+
+hwio_batch::hwio_batch(ihwio_dev * dev) :
+		dev(dev) {
+}
+
+void hwio_batch::read(hwio_phys_addr_t offset, void * dst, size_t n) {
+	if (n == 0)
+		return;
+	op_t o = { OP_READ, offset, n, dst, 0, 0, 0 };
+	ops.push_back(o);
+}
+
+void hwio_batch::write(hwio_phys_addr_t offset, const void * data, size_t n) {
+	if (n == 0)
+		return;
+	op_t o = { OP_WRITE, offset, n, nullptr, this->data.size(), 0, 0 };
+	const uint8_t * d = reinterpret_cast<const uint8_t*>(data);
+	this->data.insert(this->data.end(), d, d + n);
+	ops.push_back(o);
+}
+
+void hwio_batch::fill(hwio_phys_addr_t offset, uint64_t pattern, size_t width,
+		size_t n) {
+	if (n == 0)
+		return;
+	op_t o = { OP_FILL, offset, n, nullptr, 0, width, pattern };
+	ops.push_back(o);
+}
+
+void hwio_batch::flush() {
+	if (ops.empty())
+		return;
+	try {
+		dev->flush_batch(*this);
+	} catch (...) {
+		clear();
+		throw;
+	}
+	clear();
+}
+
+void hwio_batch::clear() {
+	ops.clear();
+	data.clear();
+}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "ihwio_dev.h"
+
+namespace hwio {
+
+/*
+ * Recorder of accesses to a single device which are executed together
+ * by flush() (in order of recording)
+ *
+ * hwio_device_mmap executes them back to back with a single memory barrier
+ * at the end, hwio_device_remote sends them in a single HWIO_CMD_BATCH frame
+ * (more frames if they do not fit in to BUFFER_SIZE).
+ *
+ * @attention destinations of reads have to be valid until flush()
+ * */
+class hwio_batch {
+public:
+	enum op_e {
+		OP_READ, OP_WRITE, OP_FILL,
+	};
+	struct op_t {
+		op_e op;
+		hwio_phys_addr_t offset;
+		// size of data in bytes
+		size_t size;
+		// OP_READ destination of data
+		void * dst;
+		// OP_WRITE offset of data in data
+		size_t data_offset;
+		// OP_FILL width of access and pattern
+		size_t width;
+		uint64_t pattern;
+	};
+
+	ihwio_dev * dev;
+	std::vector<op_t> ops;
+	// data of writes
+	std::vector<uint8_t> data;
+
+	hwio_batch(ihwio_dev * dev);
+
+	void read(hwio_phys_addr_t offset, void * dst, size_t n);
+	void read32(hwio_phys_addr_t offset, uint32_t * dst) {
+		read(offset, dst, sizeof(*dst));
+	}
+	void read64(hwio_phys_addr_t offset, uint64_t * dst) {
+		read(offset, dst, sizeof(*dst));
+	}
+
+	/*
+	 * Data is copied in to batch
+	 * */
+	void write(hwio_phys_addr_t offset, const void * data, size_t n);
+	void write32(hwio_phys_addr_t offset, uint32_t val) {
+		write(offset, &val, sizeof(val));
+	}
+	void write64(hwio_phys_addr_t offset, uint64_t val) {
+		write(offset, &val, sizeof(val));
+	}
+
+	/*
+	 * @see ihwio_dev::fill
+	 * */
+	void fill(hwio_phys_addr_t offset, uint64_t pattern, size_t width,
+			size_t n);
+
+	/*
+	 * @return number of recorded accesses
+	 * */
+	size_t size() const {
+		return ops.size();
+	}
+
+	/*
+	 * Execute all recorded accesses on device and clear the batch
+	 * (the batch is cleared also if an access fails)
+	 *
+	 * @throw hwio_error_rw
+	 * */
+	void flush();
+
+	/*
+	 * Drop all recorded accesses
+	 * */
+	void clear();
+};
+
+}
@@ -17,7 +17,8 @@ hwio_device_mmap::hwio_device_mmap(hwio_comp_spec spec,
 hwio_device_mmap::hwio_device_mmap(std::vector<hwio_comp_spec> spec,
 		hwio_phys_addr_t base_addr, hwio_phys_addr_t size,
 		const std::string & mem_file_name) : mem_file_name(mem_file_name),
-		spec(spec), on_bus_base_addr(base_addr), on_bus_size(size) {
+		spec(spec), supported_access_widths(DEFAULT_ACCESS_WIDTHS),
+		on_bus_base_addr(base_addr), on_bus_size(size) {
 	unsigned page_size = sysconf(_SC_PAGESIZE);
 	// round up addr space size
 	size_t s = on_bus_size;
@@ -63,37 +64,128 @@ const std::vector<hwio_comp_spec> & hwio_device_mmap::get_spec() const {
 	return spec;
 }
 
+void hwio_device_mmap::access_widths(unsigned widths) {
+	supported_access_widths = (widths & HWIO_ACCESS_ALL) | HWIO_ACCESS_8;
+}
+
+unsigned hwio_device_mmap::access_widths() const {
+	return supported_access_widths;
+}
+
+bool hwio_device_mmap::access_aligned() const {
+	return true;
+}
+
 uint8_t hwio_device_mmap::read8(hwio_phys_addr_t offset) {
-	return *((uint8_t *) ((char *) dev_mem + page_offset + offset));
+	return *((volatile uint8_t *) ((char *) dev_mem + page_offset + offset));
+}
+
+uint16_t hwio_device_mmap::read16(hwio_phys_addr_t offset) {
+	return *((volatile uint16_t *) ((char *) dev_mem + page_offset + offset));
 }
 
 uint32_t hwio_device_mmap::read32(hwio_phys_addr_t offset) {
-	return *((uint32_t *) ((char *) dev_mem + page_offset + offset));
+	return *((volatile uint32_t *) ((char *) dev_mem + page_offset + offset));
 }
 
 uint64_t hwio_device_mmap::read64(hwio_phys_addr_t offset) {
-	uint64_t d = *((uint32_t *) ((char *) dev_mem + page_offset + offset));
-	uint64_t tmp = (*((uint32_t *) ((char *) dev_mem + page_offset + offset + sizeof(uint32_t))));
-	d |= tmp << sizeof(uint32_t) * 8;
-	return d;
-	// return *((uint64_t *) ((char *) dev_mem + page_offset + offset));
+	char * addr = ((char *) dev_mem + page_offset + offset);
+	if (!(supported_access_widths & HWIO_ACCESS_64)) {
+		// bus does not support 64b accesses, split to 2x 32b
+		uint64_t d = *(volatile uint32_t *) addr;
+		uint64_t tmp = *(volatile uint32_t *) (addr + sizeof(uint32_t));
+		return d | (tmp << sizeof(uint32_t) * 8);
+	}
+	return *((volatile uint64_t *) addr);
 }
 
 void hwio_device_mmap::write8(hwio_phys_addr_t offset, uint8_t val) {
 	char * addr = ((char *) dev_mem + page_offset + offset);
-	*((uint8_t *) addr) = val;
+	*((volatile uint8_t *) addr) = val;
+}
+
+void hwio_device_mmap::write16(hwio_phys_addr_t offset, uint16_t val) {
+	char * addr = ((char *) dev_mem + page_offset + offset);
+	*((volatile uint16_t *) addr) = val;
 }
 
 void hwio_device_mmap::write32(hwio_phys_addr_t offset, uint32_t val) {
 	char * addr = ((char *) dev_mem + page_offset + offset);
-	*((uint32_t *) addr) = val;
+	*((volatile uint32_t *) addr) = val;
 }
 
 void hwio_device_mmap::write64(hwio_phys_addr_t offset, uint64_t val) {
 	char * addr = ((char *) dev_mem + page_offset + offset);
-	//*(uint64_t *)addr = val;
-	*(uint32_t *) addr = (uint32_t) val;
-	*(uint32_t *) (addr + sizeof(uint32_t)) = val >> (sizeof(uint32_t) * 8);
+	if (!(supported_access_widths & HWIO_ACCESS_64)) {
+		// bus does not support 64b accesses, split to 2x 32b
+		*(volatile uint32_t *) addr = (uint32_t) val;
+		*(volatile uint32_t *) (addr + sizeof(uint32_t)) = val
+				>> (sizeof(uint32_t) * 8);
+		return;
+	}
+	*((volatile uint64_t *) addr) = val;
+}
+
+template<typename T>
+static void keyhole_read(volatile T * reg, uint8_t * dst, size_t n) {
+	for (uint8_t * end = dst + n; dst < end; dst += sizeof(T)) {
+		T v = *reg;
+		memcpy(dst, &v, sizeof(T));
+	}
+}
+
+template<typename T>
+static void keyhole_write(volatile T * reg, const uint8_t * data, size_t n) {
+	for (const uint8_t * end = data + n; data < end; data += sizeof(T)) {
+		T v;
+		memcpy(&v, data, sizeof(T));
+		*reg = v;
+	}
+}
+
+void hwio_device_mmap::read_keyhole(hwio_phys_addr_t offset, void * dst,
+		size_t n, size_t width) {
+	check_keyhole_args(offset, n, width);
+	char * addr = ((char *) dev_mem + page_offset + offset);
+	uint8_t * d = reinterpret_cast<uint8_t*>(dst);
+	switch (width) {
+	case sizeof(uint64_t):
+		keyhole_read((volatile uint64_t *) addr, d, n);
+		break;
+	case sizeof(uint32_t):
+		keyhole_read((volatile uint32_t *) addr, d, n);
+		break;
+	case sizeof(uint16_t):
+		keyhole_read((volatile uint16_t *) addr, d, n);
+		break;
+	default:
+		keyhole_read((volatile uint8_t *) addr, d, n);
+	}
+}
+
+void hwio_device_mmap::write_keyhole(hwio_phys_addr_t offset,
+		const void * data, size_t n, size_t width) {
+	check_keyhole_args(offset, n, width);
+	char * addr = ((char *) dev_mem + page_offset + offset);
+	const uint8_t * d = reinterpret_cast<const uint8_t*>(data);
+	switch (width) {
+	case sizeof(uint64_t):
+		keyhole_write((volatile uint64_t *) addr, d, n);
+		break;
+	case sizeof(uint32_t):
+		keyhole_write((volatile uint32_t *) addr, d, n);
+		break;
+	case sizeof(uint16_t):
+		keyhole_write((volatile uint16_t *) addr, d, n);
+		break;
+	default:
+		keyhole_write((volatile uint8_t *) addr, d, n);
+	}
+}
+
+void hwio_device_mmap::flush_batch(const hwio_batch & batch) {
+	ihwio_dev::flush_batch(batch);
+	__sync_synchronize();
 }
 
 std::string hwio_device_mmap::to_str() {
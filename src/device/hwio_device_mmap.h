@@ -31,6 +31,8 @@ class hwio_device_mmap: public ihwio_dev {
 	size_t addr_space_size;
 	// pointer on mmaped device memory
 	void *dev_mem;
+	// mask of HWIO_ACCESS_* flags which can be used on this device
+	unsigned supported_access_widths;
 
 
 public:
@@ -38,6 +40,9 @@ public:
 	const hwio_phys_addr_t on_bus_base_addr;
 	const hwio_phys_addr_t on_bus_size;
 	static const std::string DEFAULT_MEM_PATH;
+	// 16b and 64b accesses are not enabled by default (not supported
+	// by 32b register slaves, 64b access is split to 2x 32b)
+	static const unsigned DEFAULT_ACCESS_WIDTHS = HWIO_ACCESS_8 | HWIO_ACCESS_32;
 	/*
 	 * @param devI base address where address space of device starts
 	 **/
@@ -54,15 +59,43 @@ public:
 
 	virtual void attach() override;
 	virtual const std::vector<hwio_comp_spec> & get_spec() const override;
+	/*
+	 * @return name of file from which device is mmaped
+	 * */
+	const std::string & mem_path() const {
+		return mem_file_name;
+	}
+
+	/*
+	 * Set access widths used for bulk transfers (e.g. enable native 64b
+	 * accesses for devices on 64b bus), default is DEFAULT_ACCESS_WIDTHS
+	 *
+	 * @param widths mask of HWIO_ACCESS_* flags, HWIO_ACCESS_8 is always enabled
+	 * */
+	void access_widths(unsigned widths);
+	virtual unsigned access_widths() const override;
+	virtual bool access_aligned() const override;
 
 	virtual uint8_t read8(hwio_phys_addr_t offset) override;
+	virtual uint16_t read16(hwio_phys_addr_t offset) override;
 	virtual uint32_t read32(hwio_phys_addr_t offset) override;
 	virtual uint64_t read64(hwio_phys_addr_t offset) override;
 
+	virtual void read_keyhole(hwio_phys_addr_t offset, void * dst, size_t n,
+			size_t width) override;
+	virtual void write_keyhole(hwio_phys_addr_t offset, const void * data,
+			size_t n, size_t width) override;
+
 	virtual void write8(hwio_phys_addr_t offset, uint8_t val) override;
+	virtual void write16(hwio_phys_addr_t offset, uint16_t val) override;
 	virtual void write32(hwio_phys_addr_t offset, uint32_t val) override;
 	virtual void write64(hwio_phys_addr_t offset, uint64_t val) override;
 
+	/*
+	 * Accesses are executed back to back followed by a single memory barrier
+	 * */
+	virtual void flush_batch(const hwio_batch & batch) override;
+
 	virtual std::string to_str() override;
 
 	virtual ~hwio_device_mmap() override;
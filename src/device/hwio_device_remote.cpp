@@ -1,11 +1,38 @@
 #include "hwio_device_remote.h"
+#include "hwio_batch.h"
 
 #include <assert.h>
+#include <algorithm>
 #include <sstream>
 
 using namespace std;
 namespace hwio {
 
+/*
+ * Cancel all requests which are still in flight, responses are discarded
+ * and the destination buffers are not used anymore
+ * */
+static void cancel_pending(std::vector<hwio_async_token> & pending) {
+	for (auto & t : pending)
+		t.cancel();
+}
+
+/*
+ * Wait for all requests, if some of them fails the remaining ones are
+ * canceled (so the caller can release their buffers) and the first error
+ * is rethrown
+ * */
+static void wait_pending(std::vector<hwio_async_token> & pending) {
+	for (auto & t : pending) {
+		try {
+			t.wait();
+		} catch (...) {
+			cancel_pending(pending);
+			throw;
+		}
+	}
+}
+
 void hwio_device_remote::assert_response(Hwio_packet_header * h,
 		HWIO_CMD expected, const string & msg) {
 	if (h->command != expected) {
@@ -32,15 +59,43 @@ void hwio_device_remote::attach() {
 	// devices are automatically attached on server
 }
 
+unsigned hwio_device_remote::access_widths() const {
+	return HWIO_ACCESS_ALL;
+}
+
+bool hwio_device_remote::access_aligned() const {
+	return false;
+}
+
 void hwio_device_remote::read(hwio_phys_addr_t offset, void *__restrict dst,
 		size_t n) {
 
 #ifdef LOG_INFO
-	LOG_INFO << "[CLIENT] Read " << (int) id << ": " << name_get() << " 0x"
+	LOG_INFO << "[CLIENT] Read " << (int) id << ": " << name() << " 0x"
 	<< hex << offset << ", " << dec << endl;
 #endif
-	assert(
-			n <= UINT16_MAX && "[TODO] split large data to multiple transactions");
+	const size_t max_chunk = BUFFER_SIZE - sizeof(Hwio_packet_header);
+	if (n > max_chunk) {
+		// large transfer, split in to chunks and keep them in flight
+		// (number of chunks in flight is limited by window of connection)
+		uint8_t * d = reinterpret_cast<uint8_t*>(dst);
+		std::vector<hwio_async_token> pending;
+		try {
+			while (n) {
+				size_t chunk = std::min(n, max_chunk);
+				pending.push_back(read_async(offset, d, chunk));
+				offset += chunk;
+				d += chunk;
+				n -= chunk;
+			}
+		} catch (...) {
+			cancel_pending(pending);
+			throw;
+		}
+		wait_pending(pending);
+		return;
+	}
+
 	auto buff = reinterpret_cast<HwioFrame<RdReq>*>(server->tx_buffer);
 	buff->header.body_len = sizeof(RdReq);
 	buff->header.command = HWIO_CMD_READ;
@@ -51,16 +106,82 @@ void hwio_device_remote::read(hwio_phys_addr_t offset, void *__restrict dst,
 	server->tx_pckt();
 
 	Hwio_packet_header h;
-	server->rx_pckt(&h);
-	assert_response(&h, HWIO_CMD_READ_RESP,
-			"Wrong response from server on read request ");
+	if (!server->rx_pckt(&h, HWIO_CMD_READ_RESP, dst, n)) {
+		assert_response(&h, HWIO_CMD_READ_RESP,
+				"Wrong response from server on read request ");
+		throw hwio_error_rw("Wrong size of response on read request");
+	}
+}
 
-	auto resp = reinterpret_cast<RdResp*>(server->rx_buffer);
-#ifdef LOG_INFO
-	LOG_INFO << "[CLIENT] Read data: " << resp->data << endl;
-#endif
+hwio_async_token hwio_device_remote::read_async(hwio_phys_addr_t offset,
+		void * dst, size_t n) {
+	assert(
+			n <= BUFFER_SIZE - sizeof(Hwio_packet_header) && "use read() for transfers larger than BUFFER_SIZE");
+	auto buff = reinterpret_cast<HwioFrame<RdReq>*>(server->tx_buffer);
+	buff->header.body_len = sizeof(RdReq);
+	buff->header.command = HWIO_CMD_READ;
+	buff->body.addr = offset;
+	buff->body.devId = id;
+	buff->body.size = n;
 
-	memcpy(dst, (void *) resp->data, n);
+	return server->tx_pckt_async(HWIO_CMD_READ_RESP, dst, n);
+}
+
+hwio_async_token hwio_device_remote::write_async(hwio_phys_addr_t offset,
+		const void * data, size_t n) {
+	// writes have no response, the request is completed after send
+	write(offset, data, n);
+	return hwio_async_token();
+}
+
+void hwio_device_remote::async_flush() {
+	server->async_flush();
+}
+
+void hwio_device_remote::readv(const std::vector<hwio_iovec> & items) {
+	const size_t max_body = BUFFER_SIZE - sizeof(Hwio_packet_header);
+	auto buff = reinterpret_cast<HwioFrame<RdReqMulti>*>(server->tx_buffer);
+	auto it = items.begin();
+	while (it != items.end()) {
+		if (it->size > max_body) {
+			// item does not fit in to a single frame
+			read(it->offset, it->data, it->size);
+			++it;
+			continue;
+		}
+		// pack as many items as possible while the request and response fit
+		RdReqMulti * req = &buff->body;
+		size_t req_size = 0;
+		size_t resp_size = 0;
+		auto end = it;
+		while (end != items.end() && req_size + sizeof(RdReqMulti) <= max_body
+				&& resp_size + end->size <= max_body) {
+			req->devId = id;
+			req->addr = end->offset;
+			req->size = end->size;
+			req++;
+			req_size += sizeof(RdReqMulti);
+			resp_size += end->size;
+			++end;
+		}
+		buff->header.command = HWIO_CMD_READ_MULTIPLE;
+		buff->header.body_len = req_size;
+		server->tx_pckt();
+
+		Hwio_packet_header h;
+		server->rx_pckt(&h);
+		assert_response(&h, HWIO_CMD_READ_MULTIPLE_RESP,
+				"Wrong response from server on read multiple request ");
+		if (h.body_len != resp_size)
+			throw hwio_error_rw("Wrong size of response on read multiple request");
+
+		auto resp = reinterpret_cast<RdMultiResp*>(server->rx_buffer);
+		const char * data = resp->data;
+		for (; it != end; ++it) {
+			memcpy(it->data, data, it->size);
+			data += it->size;
+		}
+	}
 }
 
 uint8_t hwio_device_remote::read8(hwio_phys_addr_t offset) {
@@ -69,6 +190,12 @@ uint8_t hwio_device_remote::read8(hwio_phys_addr_t offset) {
 	return res;
 }
 
+uint16_t hwio_device_remote::read16(hwio_phys_addr_t offset) {
+	uint16_t res;
+	read(offset, &res, sizeof(res));
+	return res;
+}
+
 uint32_t hwio_device_remote::read32(hwio_phys_addr_t offset) {
 	uint32_t res;
 	read(offset, &res, sizeof(res));
@@ -83,25 +210,143 @@ uint64_t hwio_device_remote::read64(hwio_phys_addr_t offset) {
 
 void hwio_device_remote::write(hwio_phys_addr_t offset, const void * data,
 		size_t n) {
-	assert(
-			n <= UINT16_MAX && "[TODO] split large data to multiple transactions");
 #ifdef LOG_INFO
-	LOG_INFO << "[CLIENT] Write " << (int) id << ": " << name_get() << " 0x"
+	LOG_INFO << "[CLIENT] Write " << (int) id << ": " << name() << " 0x"
 	<< hex << offset << ", " << dec << data << endl;
 #endif
+	// large transfers are split in to chunks which are sent back to back
+	const size_t max_chunk = BUFFER_SIZE - sizeof(Hwio_packet_header)
+			- sizeof(WrReq);
 	auto buff = reinterpret_cast<HwioFrame<WrReq>*>(server->tx_buffer);
-	buff->header.body_len = sizeof(buff->body._) + n;
-	buff->header.command = HWIO_CMD_WRITE;
-	buff->body._.addr = offset;
-	buff->body._.devId = id;
-	buff->body._.size = n;
+	const uint8_t * d = reinterpret_cast<const uint8_t*>(data);
+	do {
+		size_t chunk = std::min(n, max_chunk);
+		buff->header.body_len = sizeof(buff->body._) + chunk;
+		buff->header.command = HWIO_CMD_WRITE;
+		buff->body._.addr = offset;
+		buff->body._.devId = id;
+		buff->body._.size = chunk;
 
-	memcpy(buff->body.data, data, n);
-	server->tx_pckt();
+		// data are sent directly from buffer of user
+		server->tx_pckt(d, chunk);
+		offset += chunk;
+		d += chunk;
+		n -= chunk;
+	} while (n);
 }
+
+void hwio_device_remote::writev(const std::vector<hwio_iovec> & items) {
+	const size_t max_body = BUFFER_SIZE - sizeof(Hwio_packet_header);
+	auto buff = reinterpret_cast<HwioFrame<WrReqMulti>*>(server->tx_buffer);
+	auto it = items.begin();
+	while (it != items.end()) {
+		if (sizeof(WrReqMulti) + it->size > max_body) {
+			// item does not fit in to a single frame
+			write(it->offset, it->data, it->size);
+			++it;
+			continue;
+		}
+		char * dst = reinterpret_cast<char *>(&buff->body);
+		size_t req_size = 0;
+		for (; it != items.end()
+				&& req_size + sizeof(WrReqMulti) + it->size <= max_body; ++it) {
+			auto req = reinterpret_cast<WrReqMulti*>(dst + req_size);
+			req->_.devId = id;
+			req->_.addr = it->offset;
+			req->_.size = it->size;
+			memcpy(req->data, it->data, it->size);
+			req_size += sizeof(WrReqMulti) + it->size;
+		}
+		buff->header.command = HWIO_CMD_WRITE_MULTIPLE;
+		buff->header.body_len = req_size;
+		server->tx_pckt();
+	}
+}
+
+void hwio_device_remote::read_keyhole(hwio_phys_addr_t offset, void * dst,
+		size_t n, size_t width) {
+	check_keyhole_args(offset, n, width);
+	const size_t max_body = BUFFER_SIZE - sizeof(Hwio_packet_header);
+	const size_t max_chunk = max_body - max_body % width;
+	auto buff = reinterpret_cast<HwioFrame<KeyholeReq>*>(server->tx_buffer);
+	uint8_t * d = reinterpret_cast<uint8_t*>(dst);
+	std::vector<hwio_async_token> pending;
+	try {
+		while (n) {
+			size_t chunk = std::min(n, max_chunk);
+			buff->header.command = HWIO_CMD_READ_KEYHOLE;
+			buff->header.body_len = sizeof(KeyholeReq);
+			buff->body.devId = id;
+			buff->body.addr = offset;
+			buff->body.width = width;
+			buff->body.size = chunk;
+			pending.push_back(
+					server->tx_pckt_async(HWIO_CMD_READ_RESP, d, chunk));
+			d += chunk;
+			n -= chunk;
+		}
+	} catch (...) {
+		cancel_pending(pending);
+		throw;
+	}
+	wait_pending(pending);
+}
+
+void hwio_device_remote::write_keyhole(hwio_phys_addr_t offset,
+		const void * data, size_t n, size_t width) {
+	check_keyhole_args(offset, n, width);
+	const size_t max_body = BUFFER_SIZE - sizeof(Hwio_packet_header)
+			- sizeof(WrKeyholeReq);
+	const size_t max_chunk = max_body - max_body % width;
+	auto buff = reinterpret_cast<HwioFrame<WrKeyholeReq>*>(server->tx_buffer);
+	const uint8_t * d = reinterpret_cast<const uint8_t*>(data);
+	while (n) {
+		size_t chunk = std::min(n, max_chunk);
+		buff->header.command = HWIO_CMD_WRITE_KEYHOLE;
+		buff->header.body_len = sizeof(WrKeyholeReq) + chunk;
+		buff->body._.devId = id;
+		buff->body._.addr = offset;
+		buff->body._.width = width;
+		buff->body._.size = chunk;
+		server->tx_pckt(d, chunk);
+		d += chunk;
+		n -= chunk;
+	}
+}
+
+void hwio_device_remote::fill(hwio_phys_addr_t offset, uint64_t pattern,
+		size_t width, size_t n) {
+	if (width != sizeof(uint8_t) && width != sizeof(uint16_t)
+			&& width != sizeof(uint32_t) && width != sizeof(uint64_t))
+		throw hwio_error_rw("Fill: unknown pattern width");
+#ifdef LOG_INFO
+	LOG_INFO << "[CLIENT] Fill " << (int) id << ": " << name() << " 0x"
+	<< hex << offset << ", " << dec << n << endl;
+#endif
+	// size in request is only 32b, the chunks have to keep the phase of pattern
+	const size_t max_chunk = UINT32_MAX - UINT32_MAX % sizeof(uint64_t);
+	auto buff = reinterpret_cast<HwioFrame<FillReq>*>(server->tx_buffer);
+	while (n) {
+		size_t chunk = std::min(n, max_chunk);
+		buff->header.command = HWIO_CMD_FILL;
+		buff->header.body_len = sizeof(FillReq);
+		buff->body.devId = id;
+		buff->body.addr = offset;
+		buff->body.width = width;
+		buff->body.size = chunk;
+		buff->body.pattern = pattern;
+		server->tx_pckt();
+		offset += chunk;
+		n -= chunk;
+	}
+}
+
 void hwio_device_remote::write8(hwio_phys_addr_t offset, uint8_t val) {
 	write(offset, &val, sizeof(val));
 }
+void hwio_device_remote::write16(hwio_phys_addr_t offset, uint16_t val) {
+	write(offset, &val, sizeof(val));
+}
 void hwio_device_remote::write32(hwio_phys_addr_t offset, uint32_t val) {
 	write(offset, &val, sizeof(val));
 }
@@ -109,6 +354,193 @@ void hwio_device_remote::write64(hwio_phys_addr_t offset, uint64_t val) {
 	write(offset, &val, sizeof(val));
 }
 
+uint64_t hwio_device_remote::rmw(hwio_phys_addr_t offset, HWIO_RMW_OP op,
+		size_t width, uint64_t mask, uint64_t value) {
+	auto buff = reinterpret_cast<HwioFrame<RmwReq>*>(server->tx_buffer);
+	buff->header.command = HWIO_CMD_RMW;
+	buff->header.body_len = sizeof(RmwReq);
+	buff->body.devId = id;
+	buff->body.addr = offset;
+	buff->body.width = width;
+	buff->body.op = op;
+	buff->body.mask = mask;
+	buff->body.value = value;
+	server->tx_pckt();
+
+	uint64_t old = 0;
+	Hwio_packet_header h;
+	if (!server->rx_pckt(&h, HWIO_CMD_READ_RESP, &old, width)) {
+		assert_response(&h, HWIO_CMD_READ_RESP,
+				"Wrong response from server on rmw request ");
+		throw hwio_error_rw("Wrong size of response on rmw request");
+	}
+	return old;
+}
+
+uint32_t hwio_device_remote::rmw32(hwio_phys_addr_t offset, uint32_t mask,
+		uint32_t value) {
+	return rmw(offset, HWIO_RMW_MASKED, sizeof(uint32_t), mask, value);
+}
+uint64_t hwio_device_remote::rmw64(hwio_phys_addr_t offset, uint64_t mask,
+		uint64_t value) {
+	return rmw(offset, HWIO_RMW_MASKED, sizeof(uint64_t), mask, value);
+}
+uint32_t hwio_device_remote::toggle_bits32(hwio_phys_addr_t offset,
+		uint32_t mask) {
+	return rmw(offset, HWIO_RMW_TOGGLE, sizeof(uint32_t), mask, 0);
+}
+uint64_t hwio_device_remote::toggle_bits64(hwio_phys_addr_t offset,
+		uint64_t mask) {
+	return rmw(offset, HWIO_RMW_TOGGLE, sizeof(uint64_t), mask, 0);
+}
+
+bool hwio_device_remote::wait_until(hwio_phys_addr_t offset, uint32_t mask,
+		uint32_t expected, uint32_t timeout_us) {
+	auto buff = reinterpret_cast<HwioFrame<WaitReq>*>(server->tx_buffer);
+	buff->header.command = HWIO_CMD_WAIT_UNTIL;
+	buff->header.body_len = sizeof(WaitReq);
+	buff->body.devId = id;
+	buff->body.addr = offset;
+	buff->body.mask = mask;
+	buff->body.expected = expected;
+	buff->body.timeout_us = timeout_us;
+	server->tx_pckt();
+
+	WaitResp resp;
+	Hwio_packet_header h;
+	if (!server->rx_pckt(&h, HWIO_CMD_WAIT_UNTIL_RESP, &resp, sizeof(resp))) {
+		assert_response(&h, HWIO_CMD_WAIT_UNTIL_RESP,
+				"Wrong response from server on wait_until request ");
+		throw hwio_error_rw("Wrong size of response on wait_until request");
+	}
+	return resp.done;
+}
+
+hwio_program_result hwio_device_remote::run_program(
+		const hwio_program & prog) {
+	hwio_program::check(prog.insns.data(), prog.insns.size(), prog.slot_cnt);
+	auto buff = reinterpret_cast<HwioFrame<ProgramReq>*>(server->tx_buffer);
+	size_t insns_size = prog.insns.size() * sizeof(hwio_program_insn);
+	buff->header.command = HWIO_CMD_PROGRAM;
+	buff->header.body_len = sizeof(ProgramReq) + insns_size;
+	buff->body.devId = id;
+	buff->body.slot_cnt = prog.slot_cnt;
+	buff->body.insn_cnt = prog.insns.size();
+	memcpy(buff->body.insns, prog.insns.data(), insns_size);
+	server->tx_pckt();
+
+	struct PACKED {
+		ProgramResp resp;
+		uint32_t slots[hwio_program::MAX_SLOTS];
+	} resp;
+	size_t resp_size = sizeof(ProgramResp) + prog.slot_cnt * sizeof(uint32_t);
+	Hwio_packet_header h;
+	if (!server->rx_pckt(&h, HWIO_CMD_PROGRAM_RESP, &resp, resp_size)) {
+		assert_response(&h, HWIO_CMD_PROGRAM_RESP,
+				"Wrong response from server on program request ");
+		throw hwio_error_rw("Wrong size of response on program request");
+	}
+	hwio_program_result res;
+	res.status = static_cast<hwio_program_status_e>(resp.resp.status);
+	res.pc = resp.resp.pc;
+	res.slots.resize(prog.slot_cnt);
+	memcpy(res.slots.data(), resp.slots, prog.slot_cnt * sizeof(uint32_t));
+	return res;
+}
+void hwio_device_remote::flush_batch(const hwio_batch & batch) {
+	const size_t max_body = BUFFER_SIZE - sizeof(Hwio_packet_header);
+	auto buff = reinterpret_cast<HwioFrame<BatchReq>*>(server->tx_buffer);
+	char * body = reinterpret_cast<char *>(&buff->body);
+
+	// responses of all frames are received in to one buffer
+	// and the data is copied to destinations of reads at the end
+	size_t read_size = 0;
+	for (auto & o : batch.ops) {
+		if (o.op == hwio_batch::OP_READ)
+			read_size += o.size;
+	}
+	std::vector<uint8_t> resp_data(read_size);
+	size_t resp_offset = 0;
+
+	size_t req_size = sizeof(BatchReq);
+	size_t resp_size = 0;
+	// resp_data is released on error, frames in flight have to be canceled
+	std::vector<hwio_async_token> pending;
+	auto send_frame = [&]() {
+		buff->header.command = HWIO_CMD_BATCH;
+		buff->header.body_len = req_size;
+		buff->body.devId = id;
+		try {
+			pending.push_back(
+					server->tx_pckt_async(HWIO_CMD_BATCH_RESP,
+							resp_data.data() + resp_offset, resp_size));
+		} catch (...) {
+			cancel_pending(pending);
+			throw;
+		}
+		resp_offset += resp_size;
+		req_size = sizeof(BatchReq);
+		resp_size = 0;
+	};
+
+	server->batch_begin();
+	for (auto & o : batch.ops) {
+		// large accesses are split in to multiple items
+		size_t done = 0;
+		while (done < o.size) {
+			size_t space = max_body - req_size;
+			size_t chunk = o.size - done;
+			if (o.op == hwio_batch::OP_READ)
+				chunk = std::min(chunk, max_body - resp_size);
+			else if (o.op == hwio_batch::OP_WRITE)
+				chunk = std::min(chunk,
+						space > sizeof(BatchItem) ? space - sizeof(BatchItem) : 0);
+			else if (space < sizeof(BatchItem) + sizeof(uint64_t))
+				chunk = 0;
+			else if (o.width)
+				chunk = std::min<size_t>(chunk, UINT32_MAX - UINT32_MAX % o.width);
+			if (space <= sizeof(BatchItem) || chunk == 0) {
+				send_frame();
+				continue;
+			}
+
+			auto item = reinterpret_cast<BatchItem*>(body + req_size);
+			item->addr = o.offset + done;
+			item->width = o.width;
+			item->size = chunk;
+			req_size += sizeof(BatchItem);
+			switch (o.op) {
+			case hwio_batch::OP_READ:
+				item->op = HWIO_BATCH_READ;
+				resp_size += chunk;
+				break;
+			case hwio_batch::OP_WRITE:
+				item->op = HWIO_BATCH_WRITE;
+				memcpy(body + req_size, &batch.data[o.data_offset + done], chunk);
+				req_size += chunk;
+				break;
+			case hwio_batch::OP_FILL:
+				item->op = HWIO_BATCH_FILL;
+				memcpy(body + req_size, &o.pattern, sizeof(o.pattern));
+				req_size += sizeof(o.pattern);
+				break;
+			}
+			done += chunk;
+		}
+	}
+	if (req_size > sizeof(BatchReq))
+		send_frame();
+	server->batch_end();
+	wait_pending(pending);
+
+	const uint8_t * d = resp_data.data();
+	for (auto & o : batch.ops) {
+		if (o.op == hwio_batch::OP_READ) {
+			memcpy(o.dst, d, o.size);
+			d += o.size;
+		}
+	}
+}
 
 std::string hwio_device_remote::to_str() {
 	std::stringstream ss;
@@ -18,6 +18,11 @@ namespace hwio {
 class hwio_device_remote: public ihwio_dev {
 	hwio_client_to_server_con * server;
 	void assert_response(Hwio_packet_header * h, HWIO_CMD expected, const std::string & msg);
+	/*
+	 * Send HWIO_CMD_RMW request and receive original value of register
+	 * */
+	uint64_t rmw(hwio_phys_addr_t offset, HWIO_RMW_OP op, size_t width,
+			uint64_t mask, uint64_t value);
 public:
 	dev_id_t id;
 	std::vector<hwio_comp_spec> spec;
@@ -42,7 +47,7 @@ public:
 			memcpy(buff->body.args, args, sizeof(ARGS_T));
 		}
 
-		buff->header.body_len = sizeof(RemoteCall) - 1 + ARGS_T_size;
+		buff->header.body_len = sizeof(RemoteCall) + ARGS_T_size;
 
 		server->tx_pckt();
 		Hwio_packet_header h;
@@ -71,7 +76,7 @@ public:
 			memcpy(buff->body.args, args, sizeof(ARGS_T));
 		}
 
-		buff->header.body_len = sizeof(RemoteCall) - 1 + ARGS_T_size;
+		buff->header.body_len = sizeof(RemoteCall) + ARGS_T_size;
 
 		server->tx_pckt();
 	}
@@ -124,18 +129,152 @@ public:
 		server->tx_pckt();
 	}
 
+	/*
+	 * Asynchronous remote call, request is sent and the return value
+	 * is stored in to ret once the response is received
+	 *
+	 * @attention ret has to be valid until the request is completed
+	 * */
+	template <typename ARGS_T, typename RET_T>
+	hwio_async_token remote_call_async(const char * fn_name, ARGS_T * args, RET_T * ret) {
+		auto buff = reinterpret_cast<HwioFrame<RemoteCall>*>(server->tx_buffer);
+		buff->header.command = HWIO_CMD_REMOTE_CALL;
+		strncpy((char *)buff->body.fn_name, fn_name, MAX_NAME_LEN);
+		buff->body.dev_id = id;
+
+		size_t ARGS_T_size = 0;
+		if (!std::is_same<ARGS_T, void>::value) {
+			ARGS_T_size = sizeof(ARGS_T);
+			memcpy(buff->body.args, args, sizeof(ARGS_T));
+		}
+		buff->header.body_len = sizeof(RemoteCall) + ARGS_T_size;
+
+		if (std::is_void<RET_T>::value)
+			return server->tx_pckt_async(0, nullptr, 0);
+		return server->tx_pckt_async(HWIO_CMD_REMOTE_CALL_RET, ret, sizeof(RET_T));
+	}
+
+	template <typename ARGS_T, typename RET_T>
+	hwio_async_token remote_call_async(const uint32_t fn_id, ARGS_T * args, RET_T * ret) {
+		auto buff = reinterpret_cast<HwioFrame<RemoteCallFast>*>(server->tx_buffer);
+		buff->header.command = HWIO_CMD_REMOTE_CALL_FAST;
+		buff->body.fn_id = fn_id;
+		buff->body.dev_id = id;
+
+		size_t ARGS_T_size = 0;
+		if (!std::is_same<ARGS_T, void>::value) {
+			ARGS_T_size = sizeof(ARGS_T);
+			memcpy(buff->body.args, args, sizeof(ARGS_T));
+		}
+		buff->header.body_len = sizeof(RemoteCallFast) + ARGS_T_size;
+
+		if (std::is_void<RET_T>::value)
+			return server->tx_pckt_async(0, nullptr, 0);
+		return server->tx_pckt_async(HWIO_CMD_REMOTE_CALL_RET, ret, sizeof(RET_T));
+	}
+
+	/*
+	 * Asynchronous read, data is stored in to dst once the response is received
+	 * (the number of requests in flight is limited by
+	 * hwio_client_to_server_con::max_in_flight, n <= BUFFER_SIZE - header)
+	 *
+	 * @attention dst has to be valid until the request is completed
+	 * */
+	hwio_async_token read_async(hwio_phys_addr_t offset, void * dst, size_t n);
+	/*
+	 * Asynchronous write, there is no response from server
+	 * and the request is completed once it is sent
+	 * */
+	hwio_async_token write_async(hwio_phys_addr_t offset, const void * data,
+			size_t n);
+	/*
+	 * Wait for all asynchronous requests on the connection to server
+	 * */
+	void async_flush();
+
+	/*
+	 * Server splits the accesses for its devices, client can use any width
+	 * */
+	virtual unsigned access_widths() const override;
+	virtual bool access_aligned() const override;
+
+	/*
+	 * Read of data larger than BUFFER_SIZE is split in to chunks
+	 * which are pipelined using read_async
+	 * */
 	virtual void read(hwio_phys_addr_t offset, void *__restrict dst, size_t n)
 			override;
 	virtual uint8_t read8(hwio_phys_addr_t offset) override;
+	virtual uint16_t read16(hwio_phys_addr_t offset) override;
 	virtual uint32_t read32(hwio_phys_addr_t offset) override;
 	virtual uint64_t read64(hwio_phys_addr_t offset) override;
 
+	/*
+	 * Items are packed into HWIO_CMD_READ_MULTIPLE frames,
+	 * one round trip per BUFFER_SIZE of data
+	 * */
+	virtual void readv(const std::vector<hwio_iovec> & items) override;
+
 	virtual void write(hwio_phys_addr_t offset, const void * data, size_t n)
 			override;
+	/*
+	 * Items are packed into HWIO_CMD_WRITE_MULTIPLE frames
+	 * */
+	virtual void writev(const std::vector<hwio_iovec> & items) override;
+	/*
+	 * Data is split in to HWIO_CMD_READ_KEYHOLE requests which are pipelined
+	 * and the accesses are performed on server
+	 * */
+	virtual void read_keyhole(hwio_phys_addr_t offset, void * dst, size_t n,
+			size_t width) override;
+	/*
+	 * Data is sent in HWIO_CMD_WRITE_KEYHOLE frames
+	 * and the accesses are performed on server
+	 * */
+	virtual void write_keyhole(hwio_phys_addr_t offset, const void * data,
+			size_t n, size_t width) override;
+
+	/*
+	 * Fill is performed on server (memset is using fill)
+	 * */
+	virtual void fill(hwio_phys_addr_t offset, uint64_t pattern, size_t width,
+			size_t n) override;
+
 	virtual void write8(hwio_phys_addr_t offset, uint8_t val) override;
+	virtual void write16(hwio_phys_addr_t offset, uint16_t val) override;
 	virtual void write32(hwio_phys_addr_t offset, uint32_t val) override;
 	virtual void write64(hwio_phys_addr_t offset, uint64_t val) override;
 
+	/*
+	 * Read-modify-write is executed by server in a single HWIO_CMD_RMW request
+	 * */
+	virtual uint32_t rmw32(hwio_phys_addr_t offset, uint32_t mask,
+			uint32_t value) override;
+	virtual uint64_t rmw64(hwio_phys_addr_t offset, uint64_t mask,
+			uint64_t value) override;
+	virtual uint32_t toggle_bits32(hwio_phys_addr_t offset, uint32_t mask)
+			override;
+	virtual uint64_t toggle_bits64(hwio_phys_addr_t offset, uint64_t mask)
+			override;
+
+	/*
+	 * The register is polled by server in a single HWIO_CMD_WAIT_UNTIL request
+	 * */
+	virtual bool wait_until(hwio_phys_addr_t offset, uint32_t mask,
+			uint32_t expected, uint32_t timeout_us) override;
+
+	/*
+	 * The program is executed by server in a single HWIO_CMD_PROGRAM request
+	 * */
+	virtual hwio_program_result run_program(const hwio_program & prog)
+			override;
+
+	/*
+	 * Accesses are packed in to HWIO_CMD_BATCH frames, one frame
+	 * and one response if they fit in to BUFFER_SIZE
+	 * */
+	virtual void flush_batch(const hwio_batch & batch) override;
+
 	virtual std::string to_str() override;
 	virtual ~hwio_device_remote() override;
 
@@ -0,0 +1,303 @@
+#include "ihwio_dev.h"
+#include "hwio_batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace hwio {
+
+/*
+ * Select the widest access (in bytes) which is enabled in widths,
+ * fits in to n bytes and satisfies the alignment rules of the device
+ * (the value of HWIO_ACCESS_* flag is the access width in bytes)
+ * */
+static size_t select_access_width(unsigned widths, bool aligned,
+		hwio_phys_addr_t offset, size_t n) {
+	for (size_t w = sizeof(uint64_t); w > sizeof(uint8_t); w >>= 1) {
+		if ((widths & w) && n >= w && (!aligned || offset % w == 0))
+			return w;
+	}
+	return sizeof(uint8_t);
+}
+
+void ihwio_dev::read(hwio_phys_addr_t offset, void *__restrict dst,
+		size_t n) {
+	const unsigned widths = access_widths();
+	const bool aligned = access_aligned();
+	uint8_t * d = reinterpret_cast<uint8_t*>(dst);
+
+	while (n) {
+		size_t w = select_access_width(widths, aligned, offset, n);
+		switch (w) {
+		case sizeof(uint64_t): {
+			uint64_t v = read64(offset);
+			memcpy(d, &v, w);
+			break;
+		}
+		case sizeof(uint32_t): {
+			uint32_t v = read32(offset);
+			memcpy(d, &v, w);
+			break;
+		}
+		case sizeof(uint16_t): {
+			uint16_t v = read16(offset);
+			memcpy(d, &v, w);
+			break;
+		}
+		default:
+			*d = read8(offset);
+		}
+		offset += w;
+		d += w;
+		n -= w;
+	}
+}
+
+void ihwio_dev::memset(hwio_phys_addr_t offset, uint8_t c, size_t n) {
+	fill(offset, c, sizeof(uint8_t), n);
+}
+
+void ihwio_dev::fill(hwio_phys_addr_t offset, uint64_t pattern, size_t width,
+		size_t n) {
+	if (width != sizeof(uint8_t) && width != sizeof(uint16_t)
+			&& width != sizeof(uint32_t) && width != sizeof(uint64_t))
+		throw hwio_error_rw("Fill: unknown pattern width");
+
+	// pattern repeated twice so any access can be copied from it
+	// starting on position of access in pattern
+	uint8_t pat[2 * sizeof(uint64_t)];
+	for (size_t i = 0; i < sizeof(pat); i++)
+		pat[i] = pattern >> ((i % width) * 8);
+
+	const unsigned widths = access_widths();
+	const bool aligned = access_aligned();
+	size_t pos = 0;
+	while (pos < n) {
+		size_t w = select_access_width(widths, aligned, offset, n - pos);
+		const uint8_t * v = pat + pos % width;
+		switch (w) {
+		case sizeof(uint64_t): {
+			uint64_t v64;
+			memcpy(&v64, v, w);
+			write64(offset, v64);
+			break;
+		}
+		case sizeof(uint32_t): {
+			uint32_t v32;
+			memcpy(&v32, v, w);
+			write32(offset, v32);
+			break;
+		}
+		case sizeof(uint16_t): {
+			uint16_t v16;
+			memcpy(&v16, v, w);
+			write16(offset, v16);
+			break;
+		}
+		default:
+			write8(offset, *v);
+		}
+		offset += w;
+		pos += w;
+	}
+}
+
+void ihwio_dev::write(hwio_phys_addr_t offset, const void * data, size_t n) {
+	const unsigned widths = access_widths();
+	const bool aligned = access_aligned();
+	const uint8_t * d = reinterpret_cast<const uint8_t*>(data);
+
+	while (n) {
+		size_t w = select_access_width(widths, aligned, offset, n);
+		switch (w) {
+		case sizeof(uint64_t): {
+			uint64_t v;
+			memcpy(&v, d, w);
+			write64(offset, v);
+			break;
+		}
+		case sizeof(uint32_t): {
+			uint32_t v;
+			memcpy(&v, d, w);
+			write32(offset, v);
+			break;
+		}
+		case sizeof(uint16_t): {
+			uint16_t v;
+			memcpy(&v, d, w);
+			write16(offset, v);
+			break;
+		}
+		default:
+			write8(offset, *d);
+		}
+		offset += w;
+		d += w;
+		n -= w;
+	}
+}
+
+void ihwio_dev::readv(const std::vector<hwio_iovec> & items) {
+	for (auto & it : items)
+		read(it.offset, it.data, it.size);
+}
+
+void ihwio_dev::writev(const std::vector<hwio_iovec> & items) {
+	for (auto & it : items)
+		write(it.offset, it.data, it.size);
+}
+
+void ihwio_dev::check_keyhole_args(hwio_phys_addr_t offset, size_t n,
+		size_t width) const {
+	if (width != sizeof(uint8_t) && width != sizeof(uint16_t)
+			&& width != sizeof(uint32_t) && width != sizeof(uint64_t))
+		throw hwio_error_rw("Keyhole access: unknown access width");
+	if (!(access_widths() & width))
+		throw hwio_error_rw("Keyhole access: width not supported by device");
+	if (n % width)
+		throw hwio_error_rw("Keyhole access: size is not multiple of width");
+	if (access_aligned() && offset % width)
+		throw hwio_error_rw("Keyhole access: unaligned address");
+}
+
+void ihwio_dev::read_keyhole(hwio_phys_addr_t offset, void * dst, size_t n,
+		size_t width) {
+	check_keyhole_args(offset, n, width);
+	uint8_t * d = reinterpret_cast<uint8_t*>(dst);
+	for (; n; n -= width, d += width) {
+		switch (width) {
+		case sizeof(uint64_t): {
+			uint64_t v = read64(offset);
+			memcpy(d, &v, width);
+			break;
+		}
+		case sizeof(uint32_t): {
+			uint32_t v = read32(offset);
+			memcpy(d, &v, width);
+			break;
+		}
+		case sizeof(uint16_t): {
+			uint16_t v = read16(offset);
+			memcpy(d, &v, width);
+			break;
+		}
+		default:
+			*d = read8(offset);
+		}
+	}
+}
+
+void ihwio_dev::write_keyhole(hwio_phys_addr_t offset, const void * data,
+		size_t n, size_t width) {
+	check_keyhole_args(offset, n, width);
+	const uint8_t * d = reinterpret_cast<const uint8_t*>(data);
+	for (; n; n -= width, d += width) {
+		switch (width) {
+		case sizeof(uint64_t): {
+			uint64_t v;
+			memcpy(&v, d, width);
+			write64(offset, v);
+			break;
+		}
+		case sizeof(uint32_t): {
+			uint32_t v;
+			memcpy(&v, d, width);
+			write32(offset, v);
+			break;
+		}
+		case sizeof(uint16_t): {
+			uint16_t v;
+			memcpy(&v, d, width);
+			write16(offset, v);
+			break;
+		}
+		default:
+			write8(offset, *d);
+		}
+	}
+}
+
+// wait_until polls register in tight loop this many times before it starts
+// to sleep, the sleep is doubled after each check up to WAIT_MAX_SLEEP_US
+static const unsigned WAIT_SPIN_CNT = 64;
+static const unsigned WAIT_MAX_SLEEP_US = 1000;
+
+bool ihwio_dev::wait_until(hwio_phys_addr_t offset, uint32_t mask,
+		uint32_t expected, uint32_t timeout_us) {
+	auto deadline = std::chrono::steady_clock::now()
+			+ std::chrono::microseconds(timeout_us);
+	unsigned sleep_us = 1;
+	for (unsigned i = 0;; i++) {
+		if ((read32(offset) & mask) == expected)
+			return true;
+		auto now = std::chrono::steady_clock::now();
+		if (now >= deadline)
+			return false;
+		if (i < WAIT_SPIN_CNT)
+			continue;
+		auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+				deadline - now);
+		std::this_thread::sleep_for(
+				std::min(std::chrono::microseconds(sleep_us), remaining));
+		sleep_us = std::min(sleep_us * 2, WAIT_MAX_SLEEP_US);
+	}
+}
+
+hwio_program_result ihwio_dev::run_program(const hwio_program & prog) {
+	return prog.exec(this);
+}
+
+void ihwio_dev::flush_batch(const hwio_batch & batch) {
+	for (auto & o : batch.ops) {
+		switch (o.op) {
+		case hwio_batch::OP_READ:
+			read(o.offset, o.dst, o.size);
+			break;
+		case hwio_batch::OP_WRITE:
+			write(o.offset, &batch.data[o.data_offset], o.size);
+			break;
+		case hwio_batch::OP_FILL:
+			fill(o.offset, o.pattern, o.width, o.size);
+			break;
+		}
+	}
+}
+
+uint16_t ihwio_dev::read16(hwio_phys_addr_t offset) {
+	uint16_t v;
+	read(offset, &v, sizeof(v));
+	return v;
+}
+
+void ihwio_dev::write16(hwio_phys_addr_t offset, uint16_t val) {
+	write(offset, &val, sizeof(val));
+}
+
+uint32_t ihwio_dev::rmw32(hwio_phys_addr_t offset, uint32_t mask,
+		uint32_t value) {
+	uint32_t old = read32(offset);
+	write32(offset, (old & ~mask) | (value & mask));
+	return old;
+}
+
+uint64_t ihwio_dev::rmw64(hwio_phys_addr_t offset, uint64_t mask,
+		uint64_t value) {
+	uint64_t old = read64(offset);
+	write64(offset, (old & ~mask) | (value & mask));
+	return old;
+}
+
+uint32_t ihwio_dev::toggle_bits32(hwio_phys_addr_t offset, uint32_t mask) {
+	uint32_t old = read32(offset);
+	write32(offset, old ^ mask);
+	return old;
+}
+
+uint64_t ihwio_dev::toggle_bits64(hwio_phys_addr_t offset, uint64_t mask) {
+	uint64_t old = read64(offset);
+	write64(offset, old ^ mask);
+	return old;
+}
+
+}
@@ -8,6 +8,7 @@
 
 #include "hwio_typedefs.h"
 #include "hwio_comp_spec.h"
+#include "hwio_program.h"
 
 namespace hwio {
 
@@ -25,6 +26,32 @@ class hwio_error_dev_init_fail: public std::runtime_error {
 	using std::runtime_error::runtime_error;
 };
 
+/*
+ * Flags of bus access widths supported by device
+ * (value of the flag is the width of access in bytes)
+ * */
+enum hwio_access_width_e {
+	HWIO_ACCESS_8 = 1 << 0,
+	HWIO_ACCESS_16 = 1 << 1,
+	HWIO_ACCESS_32 = 1 << 2,
+	HWIO_ACCESS_64 = 1 << 3,
+	HWIO_ACCESS_ALL = HWIO_ACCESS_8 | HWIO_ACCESS_16 | HWIO_ACCESS_32
+			| HWIO_ACCESS_64,
+};
+
+/*
+ * Item of scatter-gather access (readv/writev)
+ * */
+struct hwio_iovec {
+	// offset relative to the component's base
+	hwio_phys_addr_t offset;
+	// buffer for read data or data to write
+	void * data;
+	size_t size;
+};
+
+class hwio_batch;
+
 /*
  * Interface for device classes
  * contains virtual read and write methods
@@ -43,39 +70,48 @@ public:
 	 * */
 	virtual void attach() = 0;
 
+	/*
+	 * @return bit mask of HWIO_ACCESS_* flags, access widths which can be
+	 * 	used on this device (8b access has to be always supported)
+	 * */
+	virtual unsigned access_widths() const {
+		return HWIO_ACCESS_8 | HWIO_ACCESS_32;
+	}
+
+	/*
+	 * @return true if accesses wider than 8b have to be naturally aligned
+	 * */
+	virtual bool access_aligned() const {
+		return true;
+	}
+
+	/*
+	 * Check arguments of keyhole access
+	 *
+	 * @throw hwio_error_rw if width is not supported by device
+	 * 		or n is not multiple of width
+	 * */
+	void check_keyhole_args(hwio_phys_addr_t offset, size_t n,
+			size_t width) const;
+
 	/**
 	 * Read data from the component. Platform dependent.
 	 *
+	 * Unaligned head and tail are transfered using narrower accesses,
+	 * the rest is transfered using the widest access from access_widths().
+	 *
 	 * @param offset The offset relative to the component's base.
 	 * @param dst Pointer on buffer to store data in
 	 * @param n Size of data to read
 	 * @throw hwio_error_rw
 	 */
-	virtual void read(hwio_phys_addr_t offset, void *__restrict dst, size_t n) {
-		while (true) {
-			//if (n >= sizeof(uint64_t)) {
-			//	*(uint64_t*) dst = read64(offset);
-			//	n -= sizeof(uint64_t);
-			//	offset += sizeof(uint64_t);
-			//	dst = ((uint8_t*) dst) + sizeof(uint64_t);
-			//	continue;
-            //
-			//} else
-			if (n >= sizeof(uint32_t)) {
-				*(uint32_t*) dst = read32(offset);
-				n -= sizeof(uint32_t);
-				offset += sizeof(uint32_t);
-				dst = ((uint8_t*) dst) + sizeof(uint32_t);
-				continue;
-
-			} else {
-				for (unsigned i = 0; i < n; i++)
-					*((uint8_t*) dst + i) = read8(offset + i);
-				return;
-			}
-		}
-	}
+	virtual void read(hwio_phys_addr_t offset, void *__restrict dst, size_t n);
 	virtual uint8_t read8(hwio_phys_addr_t offset) = 0;
+	/*
+	 * Default implementation uses read() of 2 bytes, device which enables
+	 * HWIO_ACCESS_16 in access_widths() has to override it
+	 * */
+	virtual uint16_t read16(hwio_phys_addr_t offset);
 	virtual uint32_t read32(hwio_phys_addr_t offset) = 0;
 	virtual uint64_t read64(hwio_phys_addr_t offset) = 0;
 
@@ -87,34 +123,20 @@ public:
 	 * @param n specified number of bytes
 	 * @throw hwio_error_rw
 	 */
-	virtual void memset(hwio_phys_addr_t offset, uint8_t c, size_t n) {
-		uint32_t fill32 = c;
-		fill32 |= c << 8 | c;
-		fill32 |= fill32 << 2 * 8;
-	    //uint64_t fill64 = (((uint64_t) fill32) << sizeof(uint32_t) * 8)
-	    //		| fill32;
-
-		while (true) {
-			//if (n >= sizeof(uint64_t)) {
-			//	write64(offset, fill64);
-			//	n -= sizeof(uint64_t);
-			//	offset += sizeof(uint64_t);
-			//	continue;
-            //
-			//} else
-			if (n >= sizeof(uint32_t)) {
-				write32(offset, fill32);
-				n -= sizeof(uint32_t);
-				offset += sizeof(uint32_t);
-				continue;
-
-			} else {
-				for (unsigned i = 0; i < n; i++)
-					write8(offset + i, c);
-				return;
-			}
-		}
-	}
+	virtual void memset(hwio_phys_addr_t offset, uint8_t c, size_t n);
+
+	/**
+	 * Fill the component memory with repeated pattern.
+	 *
+	 * @param offset The offset relative to the component's base.
+	 * @param pattern value which is repeated (little endian)
+	 * @param width size of pattern in bytes (1, 2, 4, 8)
+	 * @param n specified number of bytes (pattern is truncated
+	 * 		if it is not multiple of width)
+	 * @throw hwio_error_rw
+	 */
+	virtual void fill(hwio_phys_addr_t offset, uint64_t pattern, size_t width,
+			size_t n);
 
 	/*
 	 * Write data of size n to device on specified offset
@@ -124,35 +146,136 @@ public:
 	 * @param n Size of data
 	 * @throw hwio_error_rw
 	 * */
-	virtual void write(hwio_phys_addr_t offset, const void * data, size_t n) {
-		while (true) {
-			//if (n >= sizeof(uint64_t)) {
-			//	write64(offset, *(uint64_t*) data);
-			//	n -= sizeof(uint64_t);
-			//	offset += sizeof(uint64_t);
-			//	data = ((uint8_t*) data) + sizeof(uint64_t);
-			//	continue;
-            //
-			//} else
-			if (n >= sizeof(uint32_t)) {
-				write32(offset, *(uint32_t*) data);
-				n -= sizeof(uint32_t);
-				offset += sizeof(uint32_t);
-				data = ((uint8_t*) data) + sizeof(uint32_t);
-				continue;
-
-			} else {
-				for (unsigned i = 0; i < n; i++)
-					write8(offset + i, *((uint8_t*) data + i));
-				return;
-			}
-		}
-	}
+	virtual void write(hwio_phys_addr_t offset, const void * data, size_t n);
+
+	/*
+	 * Scatter-gather read, read all items in specified order
+	 *
+	 * @param items list of (offset, dst, size)
+	 * @throw hwio_error_rw
+	 * */
+	virtual void readv(const std::vector<hwio_iovec> & items);
+
+	/*
+	 * Scatter-gather write, write all items in specified order
+	 *
+	 * @param items list of (offset, data, size)
+	 * @throw hwio_error_rw
+	 * */
+	virtual void writev(const std::vector<hwio_iovec> & items);
+
+	/*
+	 * Repeated read from a single address (e.g. FIFO data register)
+	 *
+	 * @param offset The offset relative to the component's base.
+	 * @param dst Pointer on buffer to store data in
+	 * @param n Size of data in bytes (has to be multiple of width)
+	 * @param width width of single access in bytes (1, 2, 4, 8)
+	 * @throw hwio_error_rw
+	 * */
+	virtual void read_keyhole(hwio_phys_addr_t offset, void * dst, size_t n,
+			size_t width);
+
+	/*
+	 * Repeated write to a single address (e.g. FIFO data register)
+	 *
+	 * @param offset The offset relative to the component's base.
+	 * @param data The data to write into component
+	 * @param n Size of data in bytes (has to be multiple of width)
+	 * @param width width of single access in bytes (1, 2, 4, 8)
+	 * @throw hwio_error_rw
+	 * */
+	virtual void write_keyhole(hwio_phys_addr_t offset, const void * data,
+			size_t n, size_t width);
 
 	virtual void write8(hwio_phys_addr_t offset, uint8_t val) = 0;
+	/*
+	 * Default implementation uses write() of 2 bytes, device which enables
+	 * HWIO_ACCESS_16 in access_widths() has to override it
+	 * */
+	virtual void write16(hwio_phys_addr_t offset, uint16_t val);
 	virtual void write32(hwio_phys_addr_t offset, uint32_t val) = 0;
 	virtual void write64(hwio_phys_addr_t offset, uint64_t val) = 0;
 
+	/*
+	 * Read-modify-write of register, new = (old & ~mask) | (value & mask)
+	 *
+	 * On remote device the operation is executed by server in a single
+	 * request (atomic against other clients of the server), locally it is
+	 * a read followed by a write.
+	 *
+	 * @param offset The offset relative to the component's base.
+	 * @param mask bits which are modified
+	 * @param value new value of modified bits
+	 * @return original value of register
+	 * @throw hwio_error_rw
+	 * */
+	virtual uint32_t rmw32(hwio_phys_addr_t offset, uint32_t mask,
+			uint32_t value);
+	virtual uint64_t rmw64(hwio_phys_addr_t offset, uint64_t mask,
+			uint64_t value);
+
+	/*
+	 * Invert bits of register, new = old ^ mask (same atomicity as rmw32)
+	 *
+	 * @return original value of register
+	 * @throw hwio_error_rw
+	 * */
+	virtual uint32_t toggle_bits32(hwio_phys_addr_t offset, uint32_t mask);
+	virtual uint64_t toggle_bits64(hwio_phys_addr_t offset, uint64_t mask);
+
+	/*
+	 * Set/clear bits of register (see rmw32)
+	 *
+	 * @return original value of register
+	 * */
+	uint32_t set_bits32(hwio_phys_addr_t offset, uint32_t bits) {
+		return rmw32(offset, bits, bits);
+	}
+	uint32_t clear_bits32(hwio_phys_addr_t offset, uint32_t bits) {
+		return rmw32(offset, bits, 0);
+	}
+	uint64_t set_bits64(hwio_phys_addr_t offset, uint64_t bits) {
+		return rmw64(offset, bits, bits);
+	}
+	uint64_t clear_bits64(hwio_phys_addr_t offset, uint64_t bits) {
+		return rmw64(offset, bits, 0);
+	}
+
+	/*
+	 * Wait until (read32(offset) & mask) == expected
+	 *
+	 * Locally the register is polled with adaptive backoff (spin, then sleep
+	 * with increasing period), on remote device the register is polled
+	 * by server and only the result is sent back.
+	 *
+	 * @param offset The offset relative to the component's base.
+	 * @param timeout_us max time to wait [us], 0 to check only once
+	 * @return true if the condition was met, false on timeout
+	 * @throw hwio_error_rw
+	 * */
+	virtual bool wait_until(hwio_phys_addr_t offset, uint32_t mask,
+			uint32_t expected, uint32_t timeout_us);
+
+	/*
+	 * Execute register micro-program (see hwio_program.h)
+	 *
+	 * On remote device the whole program is executed by server
+	 * in a single request.
+	 *
+	 * @return status of program, index of last instruction and values of slots
+	 * @throw std::invalid_argument if the program is malformed
+	 * @throw hwio_error_rw
+	 * */
+	virtual hwio_program_result run_program(const hwio_program & prog);
+
+	/*
+	 * Execute all accesses recorded in batch in order (use hwio_batch::flush)
+	 *
+	 * @throw hwio_error_rw
+	 * */
+	virtual void flush_batch(const hwio_batch & batch);
+
 	/**
 	 * == operator for unique component searching
 	 */
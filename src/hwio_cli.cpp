@@ -5,10 +5,14 @@
 #include <pwd.h>
 #include <assert.h>
 #include <algorithm>
+#include <memory>
+#include <sstream>
 
 #include "bus/hwio_bus_json.h"
 #include "hwio_bus_remote.h"
 #include "hwio_bus_devicetree.h"
+#include "hwio_bus_fdt.h"
+#include "hwio_bus_catalog.h"
 
 namespace hwio {
 
@@ -18,10 +22,81 @@ const char * hwio_help_str() {
 	"   --hwio_config <path.json>   load hwio configuration from json file\n"//
 	"   --hwio_devicetree <path>   root of devicetree to load device info from (def. \"/proc/device-tree\")\n"//
 	"   --hwio_device_mem <path>   file with memory space of devices, use with --hwio_devicetree (def. \"/dev/mem\")\n"//
+	"   --hwio_fdt <path.dtb>      flattened devicetree to load device info from (e.g. \"/sys/firmware/fdt\")\n"//
 	"   --hwio_remote <ip:port>    connect to remote hwio server\n"//
 	"   --hwio_json <path.json>      load devices from json file\n";
 }
 
+ihwio_bus * hwio_bus_from_ptree(hwio_bus_json::ptree& n);
+
+/**
+ * @return path of file/directory from which bus described by json node
+ * 		loads devices
+ **/
+static std::string hwio_bus_source_from_ptree(hwio_bus_json::ptree& n) {
+	auto type = n.get<std::string>("type");
+	if (type == "devicetree")
+		return n.get<std::string>("devicetree", "");
+	else if (type == "fdt")
+		return n.get<std::string>("fdt", hwio_bus_fdt::DEFAULT_FDT_PATH);
+	else if (type == "json")
+		return n.get<std::string>("file", "");
+	throw wrong_format(
+			std::string("bus of type ") + type + " can not be cached in catalog");
+}
+
+std::string hwio_catalog_source_options(hwio_bus_json::ptree& n) {
+	std::stringstream ss;
+	boost::property_tree::write_json(ss, n, false);
+	return ss.str();
+}
+
+/**
+ * @return devices of bus which can be stored in catalog
+ **/
+static std::vector<hwio_device_mmap *> hwio_bus_mmap_devices(ihwio_bus * bus) {
+	std::vector<hwio_device_mmap *> res;
+	if (auto b = dynamic_cast<hwio_bus_devicetree*>(bus)) {
+		res = b->_all_devices;
+	} else if (auto b = dynamic_cast<hwio_bus_fdt*>(bus)) {
+		res = b->_all_devices;
+	} else if (auto b = dynamic_cast<hwio_bus_json*>(bus)) {
+		for (auto d : b->_all_devices) {
+			auto _d = dynamic_cast<hwio_device_mmap*>(d);
+			assert(_d != nullptr);
+			res.push_back(_d);
+		}
+	}
+	return res;
+}
+
+void hwio_catalog_build(const std::string & catalog_path,
+		hwio_bus_json::ptree& source) {
+	auto source_path = hwio_bus_source_from_ptree(source);
+	std::unique_ptr<ihwio_bus> bus(hwio_bus_from_ptree(source));
+	hwio_bus_catalog::write(catalog_path, source_path,
+			hwio_bus_mmap_devices(bus.get()),
+			hwio_catalog_source_options(source));
+}
+
+size_t hwio_catalog_rebuild(hwio_bus_json::ptree& config) {
+	size_t cnt = 0;
+	for (hwio_bus_json::value_type& busNode : config.get_child("buses")) {
+		auto & n = busNode.second;
+		if (n.get<std::string>("type") != "catalog")
+			continue;
+		auto file = n.get<std::string>("file", "");
+		auto source = n.get_child_optional("source");
+		if (file == "" || !source) {
+			throw wrong_format(
+					"definition of catalog bus in json missing \"file\" or \"source\"");
+		}
+		hwio_catalog_build(file, *source);
+		cnt++;
+	}
+	return cnt;
+}
+
 /**
  * load hwio_bus from json node
  **/
@@ -33,14 +108,31 @@ ihwio_bus * hwio_bus_from_ptree(hwio_bus_json::ptree& n) {
 			throw wrong_format(
 					"definition of remote bus in json missing \"host\" attribute");
 		}
-		return new hwio_bus_remote(host);
+		auto latency_name = n.get<std::string>("latency", "default");
+		hwio_latency_e latency;
+		if (latency_name == "default") {
+			latency = HWIO_LATENCY_DEFAULT;
+		} else if (latency_name == "low") {
+			latency = HWIO_LATENCY_LOW;
+		} else {
+			throw wrong_format(
+					std::string("unknown latency of remote bus (") + latency_name
+							+ "), expected \"default\" or \"low\"");
+		}
+		auto bus = new hwio_bus_remote(host, latency);
+		auto max_in_flight = n.get<size_t>("max_in_flight", 0);
+		if (max_in_flight)
+			bus->max_in_flight(max_in_flight);
+		return bus;
 	} else if (type == "json") {
 		auto file = n.get<std::string>("file", "");
 		if (file == ""){
 			throw wrong_format(
 					"definition of json bus in json missing \"file\" attribute");
 		}
-		return new hwio_bus_json(file);
+		return new hwio_bus_json(file,
+				hwio_access_widths_from_ptree(n,
+						hwio_device_mmap::DEFAULT_ACCESS_WIDTHS));
 	} else if (type == "devicetree") {
 		auto devicetree = n.get<std::string>("devicetree", "");
 		if (devicetree == ""){
@@ -52,7 +144,41 @@ ihwio_bus * hwio_bus_from_ptree(hwio_bus_json::ptree& n) {
 			throw wrong_format(
 					"definition of devicetree bus in json missing \"mem\" attribute");
 		}
-		return new hwio_bus_devicetree(devicetree, mem);
+		return new hwio_bus_devicetree(devicetree, mem,
+				hwio_access_widths_from_ptree(n,
+						hwio_device_mmap::DEFAULT_ACCESS_WIDTHS));
+	} else if (type == "fdt") {
+		auto fdt = n.get<std::string>("fdt", hwio_bus_fdt::DEFAULT_FDT_PATH);
+		auto mem = n.get<std::string>("mem", hwio_device_mmap::DEFAULT_MEM_PATH);
+		return new hwio_bus_fdt(fdt, mem,
+				hwio_access_widths_from_ptree(n,
+						hwio_device_mmap::DEFAULT_ACCESS_WIDTHS));
+	} else if (type == "catalog") {
+		auto file = n.get<std::string>("file", "");
+		if (file == "") {
+			throw wrong_format(
+					"definition of catalog bus in json missing \"file\" attribute");
+		}
+		auto source = n.get_child_optional("source");
+		if (!source) {
+			throw wrong_format(
+					"definition of catalog bus in json missing \"source\" bus");
+		}
+		auto source_path = hwio_bus_source_from_ptree(*source);
+		auto source_options = hwio_catalog_source_options(*source);
+		try {
+			return new hwio_bus_catalog(file, source_path, source_options);
+		} catch (const hwio_catalog_err &) {
+			// catalog missing or outdated, rebuild it from source
+		}
+		auto bus = hwio_bus_from_ptree(*source);
+		try {
+			hwio_bus_catalog::write(file, source_path,
+					hwio_bus_mmap_devices(bus), source_options);
+		} catch (const hwio_catalog_err &) {
+			// catalog is only a cache (e.g. directory is read only)
+		}
+		return bus;
 	} else {
 		throw wrong_format(
 				std::string("unknown definition of bus (") + type + ")");
@@ -149,6 +275,7 @@ ihwio_bus * hwio_init(int & argc, char * argv[]) {
 		    { "hwio_device_mem", required_argument, nullptr, 'm' }, //
 		    { "hwio_remote", required_argument, nullptr, 'r' },     //
 		    { "hwio_json", required_argument, nullptr, 'j' },       //
+		    { "hwio_fdt", required_argument, nullptr, 'f' },        //
 		    { nullptr, no_argument, nullptr, 0 }                    //
 	};
 
@@ -186,6 +313,10 @@ ihwio_bus * hwio_init(int & argc, char * argv[]) {
 				buses.push_back(new hwio_bus_json(optarg));
 				break;
 
+			case 'f':
+				buses.push_back(new hwio_bus_fdt(optarg));
+				break;
+
 			case 'd':
 				if (hwio_devicetree != nullptr) {
 					if (hwio_device_mem == nullptr)
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <getopt.h>
+#include <boost/property_tree/ptree.hpp>
 
 #include "ihwio_bus.h"
 #include "hwio.h"
@@ -12,6 +13,30 @@ const char * hwio_help_str();
 
 ihwio_bus * hwio_init(int & argc, char * argv[]);
 
+/**
+ * Discover devices of bus described by json node and store them
+ * in to catalog file (for "catalog" bus in config)
+ *
+ * @throw hwio_catalog_err, wrong_format
+ * */
+void hwio_catalog_build(const std::string & catalog_path,
+		boost::property_tree::ptree& source);
+
+/**
+ * Rebuild catalogs of all "catalog" buses in config (explicit rebuild
+ * for changes of the source which are not detected by catalog)
+ *
+ * @return number of rebuilt catalogs
+ * @throw hwio_catalog_err, wrong_format
+ * */
+size_t hwio_catalog_rebuild(boost::property_tree::ptree& config);
+
+/**
+ * @return options of bus described by json node which are stored in catalog
+ * 		(the whole node serialized, catalog is rebuilt if any of them changes)
+ * */
+std::string hwio_catalog_source_options(boost::property_tree::ptree& source);
+
 std::vector<ihwio_dev*> hwio_select_devs_from_vector(const std::vector<ihwio_dev*>& devices, int index);
 
 char ** copy_argv(int argc, char * argv[], std::vector<char *> & to_free);
@@ -1,4 +1,5 @@
 #include "hwio_comp_spec.h"
+#include "hwio_comp_spec_literal.h"
 
 #include <string.h>
 #include <assert.h>
@@ -25,48 +26,18 @@ hwio_comp_spec::hwio_comp_spec(const std::string & compatibility_str) :
 		name(""), vendor(""), type(""), version() {
 	/**
 	 * Parses the given compat string into the spec instance.
+	 *
+	 * should look like this:
+	 *  <vendor>,<type>-<version>
 	 */
-	const size_t len = compatibility_str.size();
-
-	// should look like this:
-	//  <vendor>,<type>-<version>
-	size_t comma = compatibility_str.find_last_of(',');
-	size_t hyphen = compatibility_str.find_last_of('-');
-	size_t type_begin = comma + 1;
-	size_t version_begin = hyphen + 1;
-	size_t type_end = hyphen;
-	size_t vendor_end = comma;
-
-	if (comma == std::string::npos && hyphen == std::string::npos) {
-		// <vendor>
-		type = compatibility_str;
-	} else if (comma != std::string::npos && hyphen == std::string::npos) {
-		// <vendor>,<type>
-		type = type_begin;
-		vendor = compatibility_str.substr(0, vendor_end);
-
-	} else if (comma == std::string::npos && hyphen != std::string::npos) {
-		//  <type>-<version> or <type> only, with - in type
-		try {
-			version = hwio_version(compatibility_str.substr(version_begin, compatibility_str.size()));
-		} catch (const std::runtime_error & e) {
-			type_end = len;
-		}
-		type = compatibility_str.substr(0, type_end);
-
-	} else {
-		//  <vendor>,<type>-<version>
-		// or <vendor>,<type> only, with - in type
-		type_end = hyphen - type_begin;
-		try {
-			version = hwio_version(compatibility_str.substr(version_begin, compatibility_str.size()));
-		} catch (const std::runtime_error & e) {
-			type_end = len;
-		}
-		type = compatibility_str.substr(type_begin, type_end);
-		vendor = compatibility_str.substr(0, vendor_end);
-	}
+	auto v = hwio_comp_spec_parse(compatibility_str.data(),
+			compatibility_str.size());
+	vendor = compatibility_str.substr(v.vendor_off, v.vendor_len);
+	type = compatibility_str.substr(v.type_off, v.type_len);
+	version = hwio_version(v.version_major, v.version_minor,
+			v.version_subminor);
 }
+
 void hwio_comp_spec::name_set(const std::string & name) {
 	this->name = name;
 }
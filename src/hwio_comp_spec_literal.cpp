@@ -0,0 +1,50 @@
+#include "hwio_comp_spec_literal.h"
+
+#include <mutex>
+#include <unordered_set>
+
+namespace hwio {
+
+/*
+ * Table of interned strings (the set never removes items so pointers
+ * to strings stay valid)
+ * */
+struct hwio_atom_table {
+	std::mutex lock;
+	std::unordered_set<std::string> strings;
+};
+
+static hwio_atom_table & atom_table() {
+	// function static to be usable from static initializers
+	static hwio_atom_table t;
+	return t;
+}
+
+hwio_atom::hwio_atom() :
+		hwio_atom(intern("", 0)) {
+}
+
+hwio_atom hwio_atom::intern(const char * s, size_t len) {
+	auto & t = atom_table();
+	std::lock_guard<std::mutex> guard(t.lock);
+	auto r = t.strings.emplace(s, len);
+	return hwio_atom(&*r.first);
+}
+
+bool hwio_atom::find(const std::string & s, hwio_atom & atom) {
+	auto & t = atom_table();
+	std::lock_guard<std::mutex> guard(t.lock);
+	auto r = t.strings.find(s);
+	if (r == t.strings.end())
+		return false;
+	atom = hwio_atom(&*r);
+	return true;
+}
+
+hwio_spec_literal::hwio_spec_literal(const hwio_comp_spec_view & v) :
+		vendor(hwio_atom::intern(v.str + v.vendor_off, v.vendor_len)), type(
+				hwio_atom::intern(v.str + v.type_off, v.type_len)), version(
+				v.version_major, v.version_minor, v.version_subminor) {
+}
+
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <string>
+
+#include "hwio_comp_spec.h"
+
+namespace hwio {
+
+/**
+ * Result of parsing of compatibility string "<vendor>,<type>-<version>"
+ * (vendor and type are offsets in to parsed string)
+ * */
+struct hwio_comp_spec_view {
+	const char * str;
+	size_t vendor_off;
+	size_t vendor_len;
+	size_t type_off;
+	size_t type_len;
+	int version_major;
+	int version_minor;
+	int version_subminor;
+	// false if string is empty, contains white chars or vendor/type is empty
+	bool valid;
+};
+
+constexpr bool hwio_is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+constexpr bool hwio_is_alpha(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/**
+ * Parse decimal number starting at s[i]
+ *
+ * @return index after the number (i if there is not any digit)
+ * */
+constexpr size_t hwio_parse_uint(const char * s, size_t i, size_t len,
+		int & val) {
+	val = 0;
+	while (i < len && hwio_is_digit(s[i])) {
+		val = val * 10 + (s[i] - '0');
+		i++;
+	}
+	return i;
+}
+
+/**
+ * Parse version "<major>.<minor>[.<subminor>]" (subminor is a number
+ * or a single letter), same format as hwio_version(const std::string &)
+ *
+ * @return false if string is not a version
+ * */
+constexpr bool hwio_version_parse(const char * s, size_t len, int & maj,
+		int & min, int & sub) {
+	size_t i = hwio_parse_uint(s, 0, len, maj);
+	if (i == 0 || i >= len || s[i] != '.')
+		return false;
+	size_t j = hwio_parse_uint(s, i + 1, len, min);
+	if (j == i + 1)
+		return false;
+	if (j == len) {
+		sub = HWIO_VERSION_NA;
+		return true;
+	}
+	if (s[j] != '.' || j + 1 == len)
+		return false;
+	if (j + 2 == len && hwio_is_alpha(s[j + 1])) {
+		sub = int(s[j + 1]);
+		return true;
+	}
+	return hwio_parse_uint(s, j + 1, len, sub) == len;
+}
+
+/**
+ * Parse compatibility string, can be evaluated in compile time
+ *
+ * <vendor>,<type>-<version>, vendor and version are optional, if version
+ * can not be parsed it is part of the type
+ * */
+constexpr hwio_comp_spec_view hwio_comp_spec_parse(const char * s,
+		size_t len) {
+	hwio_comp_spec_view v = { s, 0, 0, 0, len, HWIO_VERSION_NA,
+			HWIO_VERSION_NA, HWIO_VERSION_NA, len > 0 };
+	size_t comma = len;
+	size_t hyphen = len;
+	for (size_t i = 0; i < len; i++) {
+		if (s[i] == ',')
+			comma = i;
+		else if (s[i] == '-')
+			hyphen = i;
+		else if (s[i] <= ' ' || s[i] > '~')
+			v.valid = false;
+	}
+	size_t type_end = len;
+	if (hyphen != len && (comma == len || hyphen > comma)
+			&& hwio_version_parse(s + hyphen + 1, len - hyphen - 1,
+					v.version_major, v.version_minor, v.version_subminor)) {
+		type_end = hyphen;
+	} else {
+		v.version_major = v.version_minor = v.version_subminor =
+		HWIO_VERSION_NA;
+	}
+	if (comma != len) {
+		v.vendor_len = comma;
+		v.type_off = comma + 1;
+		if (comma == 0)
+			v.valid = false;
+	}
+	v.type_len = type_end - v.type_off;
+	if (v.type_len == 0)
+		v.valid = false;
+	return v;
+}
+
+/**
+ * Interned string, equal strings are represented by the same atom
+ * and can be compared by pointer
+ * */
+class hwio_atom {
+	const std::string * _str;
+	explicit hwio_atom(const std::string * s) :
+			_str(s) {
+	}
+public:
+	// empty string
+	hwio_atom();
+
+	static hwio_atom intern(const char * s, size_t len);
+	static hwio_atom intern(const std::string & s) {
+		return intern(s.data(), s.size());
+	}
+	/**
+	 * Find atom of already interned string (the string is not interned)
+	 *
+	 * @return false if string is not interned
+	 * */
+	static bool find(const std::string & s, hwio_atom & atom);
+
+	const std::string & str() const {
+		return *_str;
+	}
+	bool empty() const {
+		return _str->empty();
+	}
+	bool operator==(const hwio_atom & other) const {
+		return _str == other._str;
+	}
+	bool operator!=(const hwio_atom & other) const {
+		return _str != other._str;
+	}
+
+	struct hasher {
+		size_t operator()(const hwio_atom & a) const {
+			return std::hash<const std::string *>()(a._str);
+		}
+	};
+};
+
+/**
+ * Compatibility specification with interned vendor and type,
+ * (usually created by _hwio_spec literal)
+ * */
+class hwio_spec_literal {
+public:
+	hwio_atom vendor;
+	hwio_atom type;
+	hwio_version version;
+
+	explicit hwio_spec_literal(const hwio_comp_spec_view & v);
+
+	/**
+	 * Same as hwio_comp_spec::operator== (version of this is the pattern)
+	 * */
+	bool matches(const hwio_atom & vendor, const hwio_atom & type,
+			const hwio_version & version) const {
+		return (this->vendor.empty() || vendor.empty() || this->vendor == vendor)
+				&& (this->type.empty() || type.empty() || this->type == type)
+				&& version == this->version;
+	}
+
+	explicit operator hwio_comp_spec() const {
+		return hwio_comp_spec(vendor.str(), type.str(), version);
+	}
+};
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#ifdef __clang__
+#pragma clang diagnostic ignored "-Wgnu-string-literal-operator-template"
+#endif
+/**
+ * "xlnx,axi-dma-1.00.a"_hwio_spec
+ *
+ * String is parsed in compile time (malformed string is a compile error),
+ * vendor and type are interned only once for each literal.
+ * */
+template<typename CharT, CharT ... cs>
+const hwio_spec_literal & operator"" _hwio_spec() {
+	static constexpr char str[] = { cs..., '\0' };
+	static constexpr hwio_comp_spec_view v = hwio_comp_spec_parse(str,
+			sizeof...(cs));
+	static_assert(v.valid, "Malformed hwio compatibility string");
+	static const hwio_spec_literal spec(v);
+	return spec;
+}
+#pragma GCC diagnostic pop
+
+}
@@ -0,0 +1,189 @@
+#include "hwio_program.h"
+#include "ihwio_dev.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+namespace hwio {
+
+constexpr size_t hwio_program::MAX_INSNS;
+constexpr size_t hwio_program::MAX_SLOTS;
+constexpr size_t hwio_program::MAX_STEPS;
+
+hwio_program::hwio_program() :
+		slot_cnt(0) {
+}
+
+size_t hwio_program::add(uint8_t op, size_t slot, hwio_phys_addr_t addr,
+		uint32_t mask, uint32_t value, uint32_t arg) {
+	if (insns.size() >= MAX_INSNS)
+		throw std::invalid_argument("[HWIO] Too many instructions in program");
+	if (slot >= MAX_SLOTS)
+		throw std::invalid_argument(
+				"[HWIO] Program slot " + std::to_string(slot) + " out of range");
+	if (slot >= slot_cnt)
+		slot_cnt = slot + 1;
+	hwio_program_insn i;
+	i.op = op;
+	i.slot = slot;
+	i.addr = addr;
+	i.mask = mask;
+	i.value = value;
+	i.arg = arg;
+	insns.push_back(i);
+	return insns.size() - 1;
+}
+
+size_t hwio_program::read(hwio_phys_addr_t addr, size_t slot) {
+	return add(HWIO_PROG_READ, slot, addr, 0, 0, 0);
+}
+
+size_t hwio_program::write(hwio_phys_addr_t addr, uint32_t value) {
+	return add(HWIO_PROG_WRITE, 0, addr, 0, value, 0);
+}
+
+size_t hwio_program::write_slot(hwio_phys_addr_t addr, size_t slot,
+		uint32_t mask, uint32_t value) {
+	return add(HWIO_PROG_WRITE_SLOT, slot, addr, mask, value, 0);
+}
+
+size_t hwio_program::rmw(hwio_phys_addr_t addr, uint32_t mask, uint32_t value,
+		size_t slot) {
+	return add(HWIO_PROG_RMW, slot, addr, mask, value, 0);
+}
+
+size_t hwio_program::poll(hwio_phys_addr_t addr, uint32_t mask,
+		uint32_t expected, uint32_t timeout_us) {
+	return add(HWIO_PROG_POLL, 0, addr, mask, expected, timeout_us);
+}
+
+size_t hwio_program::set(size_t slot, uint32_t value) {
+	return add(HWIO_PROG_SET, slot, 0, 0, value, 0);
+}
+
+size_t hwio_program::jump_if(size_t slot, uint32_t mask, uint32_t value,
+		size_t target) {
+	return add(HWIO_PROG_JUMP_IF, slot, 0, mask, value, target);
+}
+
+size_t hwio_program::jump_if_not(size_t slot, uint32_t mask, uint32_t value,
+		size_t target) {
+	return add(HWIO_PROG_JUMP_IF_NOT, slot, 0, mask, value, target);
+}
+
+size_t hwio_program::loop(size_t slot, size_t target) {
+	return add(HWIO_PROG_LOOP, slot, 0, 0, 0, target);
+}
+
+void hwio_program::set_target(size_t insn, size_t target) {
+	insns.at(insn).arg = target;
+}
+
+hwio_program_result hwio_program::exec(ihwio_dev * dev) const {
+	check(insns.data(), insns.size(), slot_cnt);
+	hwio_program_result res;
+	res.slots.resize(slot_cnt, 0);
+	res.status = exec(dev, insns.data(), insns.size(), res.slots.data(),
+			res.pc);
+	return res;
+}
+
+void hwio_program::check(const hwio_program_insn * insns, size_t insn_cnt,
+		size_t slot_cnt) {
+	if (insn_cnt > MAX_INSNS)
+		throw std::invalid_argument("[HWIO] Too many instructions in program");
+	if (slot_cnt > MAX_SLOTS)
+		throw std::invalid_argument("[HWIO] Too many slots in program");
+	for (size_t pc = 0; pc < insn_cnt; pc++) {
+		const hwio_program_insn & i = insns[pc];
+		if (i.op > HWIO_PROG_LOOP)
+			throw std::invalid_argument(
+					"[HWIO] Unknown program instruction "
+							+ std::to_string(int(i.op)) + " at "
+							+ std::to_string(pc));
+		if (i.slot >= slot_cnt && i.op != HWIO_PROG_WRITE
+				&& i.op != HWIO_PROG_POLL)
+			throw std::invalid_argument(
+					"[HWIO] Program slot out of range at "
+							+ std::to_string(pc));
+		bool jump = i.op == HWIO_PROG_JUMP_IF || i.op == HWIO_PROG_JUMP_IF_NOT
+				|| i.op == HWIO_PROG_LOOP;
+		// jump to the end finishes the program
+		if (jump && i.arg > insn_cnt)
+			throw std::invalid_argument(
+					"[HWIO] Program jump target out of range at "
+							+ std::to_string(pc));
+	}
+}
+
+uint64_t hwio_program::poll_time(const hwio_program_insn * insns,
+		size_t insn_cnt) {
+	uint64_t t = 0;
+	for (size_t pc = 0; pc < insn_cnt; pc++)
+		if (insns[pc].op == HWIO_PROG_POLL)
+			t += insns[pc].arg;
+	return t;
+}
+
+hwio_program_status_e hwio_program::exec(ihwio_dev * dev,
+		const hwio_program_insn * insns, size_t insn_cnt, uint32_t * slots,
+		size_t & pc, uint64_t max_poll_time) {
+	using namespace std::chrono;
+	// time which can be still spent in polls [us]
+	uint64_t poll_budget = max_poll_time;
+	pc = 0;
+	for (size_t step = 0; pc < insn_cnt; step++) {
+		if (step >= MAX_STEPS)
+			return HWIO_PROG_STEP_LIMIT;
+		const hwio_program_insn & i = insns[pc];
+		size_t next = pc + 1;
+		switch (i.op) {
+		case HWIO_PROG_READ:
+			slots[i.slot] = dev->read32(i.addr);
+			break;
+		case HWIO_PROG_WRITE:
+			dev->write32(i.addr, i.value);
+			break;
+		case HWIO_PROG_WRITE_SLOT:
+			dev->write32(i.addr, (slots[i.slot] & i.mask) | i.value);
+			break;
+		case HWIO_PROG_RMW:
+			slots[i.slot] = dev->rmw32(i.addr, i.mask, i.value);
+			break;
+		case HWIO_PROG_POLL: {
+			uint32_t timeout = std::min<uint64_t>(i.arg, poll_budget);
+			auto start = steady_clock::now();
+			bool done = dev->wait_until(i.addr, i.mask, i.value, timeout);
+			if (poll_budget != UINT64_MAX) {
+				uint64_t t = duration_cast<microseconds>(
+						steady_clock::now() - start).count();
+				poll_budget -= std::min(t, poll_budget);
+			}
+			if (!done)
+				return HWIO_PROG_TIMEOUT;
+			break;
+		}
+		case HWIO_PROG_SET:
+			slots[i.slot] = i.value;
+			break;
+		case HWIO_PROG_JUMP_IF:
+			if ((slots[i.slot] & i.mask) == i.value)
+				next = i.arg;
+			break;
+		case HWIO_PROG_JUMP_IF_NOT:
+			if ((slots[i.slot] & i.mask) != i.value)
+				next = i.arg;
+			break;
+		case HWIO_PROG_LOOP:
+			if (--slots[i.slot] != 0)
+				next = i.arg;
+			break;
+		}
+		pc = next;
+	}
+	return HWIO_PROG_DONE;
+}
+
+}
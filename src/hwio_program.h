@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "hwio_typedefs.h"
+
+namespace hwio {
+
+class ihwio_dev;
+
+/*
+ * Operations of register micro-program, all registers are 32b
+ * (slots are 32b variables of program, their values are returned to user)
+ * */
+enum hwio_program_op_e {
+	HWIO_PROG_READ = 0, // slots[slot] = read32(addr)
+	HWIO_PROG_WRITE = 1, // write32(addr, value)
+	HWIO_PROG_WRITE_SLOT = 2, // write32(addr, (slots[slot] & mask) | value)
+	HWIO_PROG_RMW = 3, // slots[slot] = rmw32(addr, mask, value)
+	HWIO_PROG_POLL = 4, // wait_until(addr, mask, value, arg [us]),
+	                    // the program stops on timeout
+	                    // (server limits the total time of polls)
+	HWIO_PROG_SET = 5, // slots[slot] = value
+	HWIO_PROG_JUMP_IF = 6, // if ((slots[slot] & mask) == value) goto arg
+	HWIO_PROG_JUMP_IF_NOT = 7, // if ((slots[slot] & mask) != value) goto arg
+	HWIO_PROG_LOOP = 8, // if (--slots[slot] != 0) goto arg
+};
+
+/*
+ * Single instruction of register micro-program (also the wire format
+ * of HWIO_CMD_PROGRAM)
+ * */
+struct __attribute__((__packed__)) hwio_program_insn {
+	uint8_t op; // hwio_program_op_e
+	uint8_t slot;
+	uint32_t addr;
+	uint32_t mask;
+	uint32_t value;
+	uint32_t arg; // target of jump or timeout of poll
+};
+
+enum hwio_program_status_e {
+	HWIO_PROG_DONE = 0, // all instructions executed
+	HWIO_PROG_TIMEOUT = 1, // HWIO_PROG_POLL instruction timed out
+	HWIO_PROG_STEP_LIMIT = 2, // the program executed too many instructions
+};
+
+struct hwio_program_result {
+	hwio_program_status_e status;
+	// index of instruction where the program stopped
+	// (number of instructions if it finished)
+	size_t pc;
+	std::vector<uint32_t> slots;
+};
+
+/*
+ * Sequence of register accesses executed as a whole, on remote device
+ * the program is executed by server in a single request
+ *
+ * Builder methods return index of the created instruction, which can be
+ * used as a target of jumps, forward jumps are resolved by set_target().
+ * */
+class hwio_program {
+public:
+	// limits of single program (the program has to fit in to a single frame)
+	static constexpr size_t MAX_INSNS = 100;
+	static constexpr size_t MAX_SLOTS = 32;
+	// limit of executed instructions (protection against endless loops)
+	static constexpr size_t MAX_STEPS = 100000;
+
+	std::vector<hwio_program_insn> insns;
+	// number of slots used by program
+	size_t slot_cnt;
+
+	hwio_program();
+
+	size_t read(hwio_phys_addr_t addr, size_t slot);
+	size_t write(hwio_phys_addr_t addr, uint32_t value);
+	size_t write_slot(hwio_phys_addr_t addr, size_t slot,
+			uint32_t mask = 0xffffffff, uint32_t value = 0);
+	size_t rmw(hwio_phys_addr_t addr, uint32_t mask, uint32_t value,
+			size_t slot);
+	size_t poll(hwio_phys_addr_t addr, uint32_t mask, uint32_t expected,
+			uint32_t timeout_us);
+	size_t set(size_t slot, uint32_t value);
+	size_t jump_if(size_t slot, uint32_t mask, uint32_t value, size_t target);
+	size_t jump_if_not(size_t slot, uint32_t mask, uint32_t value,
+			size_t target);
+	size_t loop(size_t slot, size_t target);
+
+	/*
+	 * @return index of the next instruction (target for backward jumps)
+	 * */
+	size_t label() const {
+		return insns.size();
+	}
+	/*
+	 * Set the target of jump instruction
+	 * */
+	void set_target(size_t insn, size_t target);
+
+	/*
+	 * Execute program on device (without check of remote devices)
+	 * */
+	hwio_program_result exec(ihwio_dev * dev) const;
+
+	/*
+	 * Check that opcodes, slots and jump targets of program are valid
+	 *
+	 * @throw std::invalid_argument
+	 * */
+	static void check(const hwio_program_insn * insns, size_t insn_cnt,
+			size_t slot_cnt);
+	/*
+	 * @return sum of timeouts of all poll instructions [us]
+	 * 	(time of the polls if each of them is executed once)
+	 * */
+	static uint64_t poll_time(const hwio_program_insn * insns,
+			size_t insn_cnt);
+	/*
+	 * Execute checked program
+	 *
+	 * @param slots array of slot_cnt values, used as input and output
+	 * @param pc index of instruction where the program stopped
+	 * @param max_poll_time limit of the total time spent in polls [us],
+	 * 		poll which would exceed it times out earlier (polls in loops)
+	 * @throw hwio_error_rw
+	 * */
+	static hwio_program_status_e exec(ihwio_dev * dev,
+			const hwio_program_insn * insns, size_t insn_cnt, uint32_t * slots,
+			size_t & pc, uint64_t max_poll_time = UINT64_MAX);
+
+private:
+	size_t add(uint8_t op, size_t slot, hwio_phys_addr_t addr, uint32_t mask,
+			uint32_t value, uint32_t arg);
+};
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "hwio.h"
+#include "hwio_program.h"
 
 #include <iostream>
 
@@ -29,6 +30,9 @@ typedef uint16_t dev_id_t;
 struct PACKED Hwio_packet_header {
 	uint8_t command;
 	uint16_t body_len;
+	// id of request copied by server to the response,
+	// 0 is used for synchronous requests
+	uint16_t tag;
 };
 
 template<typename bodyT>
@@ -99,12 +103,117 @@ struct PACKED DevQueryResp {
 	dev_id_t ids[MAX_ITEMS_PER_QUERY_RESP];
 };
 
+// item of HWIO_CMD_READ_MULTIPLE, frame body is an array of these
 struct PACKED RdReqMulti {
 	dev_id_t devId;
 	physAddr_t addr;
 	uint16_t size;
 };
 
+struct PACKED RdMultiResp {
+	char data[0]; // concatenated data of all items
+};
+
+// repeated access on a single address (FIFO/keyhole register)
+struct PACKED KeyholeReq {
+	dev_id_t devId;
+	physAddr_t addr;
+	uint8_t width; // width of single access in bytes
+	uint16_t size; // total size of data in bytes (multiple of width)
+};
+
+struct PACKED WrKeyholeReq {
+	KeyholeReq _;
+	char data[0];
+};
+
+struct PACKED FillReq {
+	dev_id_t devId;
+	physAddr_t addr;
+	uint8_t width; // size of pattern in bytes
+	uint32_t size; // total size of filled memory in bytes
+	uint64_t pattern;
+};
+
+// operation of HWIO_CMD_RMW
+enum HWIO_RMW_OP {
+	HWIO_RMW_MASKED = 0, // new = (old & ~mask) | (value & mask)
+	HWIO_RMW_TOGGLE = 1, // new = old ^ mask
+};
+
+// read-modify-write of a single register executed by server
+struct PACKED RmwReq {
+	dev_id_t devId;
+	physAddr_t addr;
+	uint8_t width; // width of register in bytes (4 or 8)
+	uint8_t op; // HWIO_RMW_OP
+	uint64_t mask;
+	uint64_t value;
+};
+
+// wait until (register & mask) == expected, register is polled by server
+struct PACKED WaitReq {
+	dev_id_t devId;
+	physAddr_t addr;
+	uint32_t mask;
+	uint32_t expected;
+	uint32_t timeout_us;
+};
+
+struct PACKED WaitResp {
+	uint8_t done; // 1 if the condition was met, 0 on timeout
+	uint32_t value; // last value of register
+};
+
+// register micro-program executed by server, see hwio_program.h
+struct PACKED ProgramReq {
+	dev_id_t devId;
+	uint8_t slot_cnt;
+	uint16_t insn_cnt;
+	hwio_program_insn insns[0];
+};
+
+struct PACKED ProgramResp {
+	uint8_t status; // hwio_program_status_e
+	uint16_t pc; // index of instruction where the program stopped
+	uint32_t slots[0]; // values of all slots of program
+};
+
+// item of HWIO_CMD_BATCH, frame body is BatchReq followed by these
+enum HWIO_BATCH_OP {
+	HWIO_BATCH_READ = 0, // data is in response
+	HWIO_BATCH_WRITE = 1, // followed by size bytes of data
+	HWIO_BATCH_FILL = 2, // followed by 8B of pattern
+};
+
+struct PACKED BatchItem {
+	uint8_t op; // HWIO_BATCH_OP
+	physAddr_t addr;
+	uint8_t width; // width of access for fill
+	uint32_t size;
+};
+
+struct PACKED BatchReq {
+	dev_id_t devId;
+	char items[0]; // sequence of BatchItem
+};
+
+// request for shared memory transport, see hwio_shm_ring.h
+struct PACKED ShmAttachReq {
+	uint32_t ring_size; // requested size of ring in bytes, 0 for default
+};
+
+// memfd and eventfds (requests, responses) are passed in SCM_RIGHTS
+struct PACKED ShmAttachResp {
+	uint32_t ring_size;
+};
+
+// item of HWIO_CMD_WRITE_MULTIPLE, frame body is a sequence of these
+struct PACKED WrReqMulti {
+	RdReqMulti _;
+	char data[0];
+};
+
 // Command codes used by hwio server
 enum HWIO_CMD {
 	HWIO_CMD_READ = 1,  // read from device
@@ -133,19 +242,42 @@ enum HWIO_CMD {
 	HWIO_CMD_REMOTE_CALL_RET = 11,
 	// HwioFrame<RemoteCallRet>
         HWIO_CMD_READ_MULTIPLE = 12,
-        // HwioFrame<RdReqMulti>
+        // HwioFrame<RdReqMulti[]>
         HWIO_CMD_READ_MULTIPLE_RESP = 13,
         // HwioFrame<RdMultiResp>
         HWIO_CMD_WRITE_MULTIPLE = 14,
-        // HwioFrame<WrReqMulti>
+        // HwioFrame<WrReqMulti[]> (without response)
         HWIO_CMD_WRITE_KEYHOLE = 15,
-        // HwioFrame<WrReqRange>
+        // HwioFrame<WrKeyholeReq> (without response)
         HWIO_CMD_REMOTE_CALL_FAST = 16,
         // HwioFrame<RemoteCallFast>
         HWIO_CMD_GET_REMOTE_CALL_ID = 17,
         // HwioFrame<GetRemoteCallId>
         HWIO_CMD_GET_REMOTE_CALL_ID_RESP = 17,
         // HwioFrame<GetRemoteCallIdResp>
+        HWIO_CMD_READ_KEYHOLE = 18,
+        // HwioFrame<KeyholeReq>, response is HwioFrame<RdResp>
+        HWIO_CMD_FILL = 19,
+        // HwioFrame<FillReq> (without response)
+        HWIO_CMD_SHM_ATTACH = 20,
+        // HwioFrame<ShmAttachReq> (only on unix domain socket)
+        HWIO_CMD_SHM_ATTACH_RESP = 21,
+        // HwioFrame<ShmAttachResp>, all next messages are in shared memory
+        HWIO_CMD_RMW = 22,
+        // HwioFrame<RmwReq>, response is HwioFrame<RdResp> with original value
+        HWIO_CMD_WAIT_UNTIL = 23,
+        // HwioFrame<WaitReq>, response is sent once the condition is met
+        // or on timeout, next requests of client are processed after it
+        HWIO_CMD_WAIT_UNTIL_RESP = 24,
+        // HwioFrame<WaitResp>
+        HWIO_CMD_PROGRAM = 25,
+        // HwioFrame<ProgramReq>
+        HWIO_CMD_PROGRAM_RESP = 26,
+        // HwioFrame<ProgramResp>
+        HWIO_CMD_BATCH = 27,
+        // HwioFrame<BatchReq>, accesses are executed in order
+        HWIO_CMD_BATCH_RESP = 28,
+        // HwioFrame<RdMultiResp> with concatenated data of reads
 };
 
 // error codes for messages used by hwio server
@@ -1,12 +1,17 @@
 #include "hwio_remote_utils.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <sstream>
 #include <stdexcept>
+#include <netinet/tcp.h>
 
 namespace hwio {
 
+const char * UNIX_ADDR_PREFIX = "unix:";
+const char * SHM_ADDR_PREFIX = "shm:";
+
 void parse_ip_and_port(const std::string & _addrString, std::string & ip,
 		std::string & port) {
 	std::string addrString = _addrString;
@@ -61,9 +66,52 @@ struct addrinfo * parse_ip_and_port(const std::string & host) {
 	}
 }
 
+struct addrinfo * parse_addr(const std::string & host) {
+	size_t prefix_len = strlen(UNIX_ADDR_PREFIX);
+	if (host.compare(0, prefix_len, UNIX_ADDR_PREFIX) != 0) {
+		prefix_len = strlen(SHM_ADDR_PREFIX);
+		if (host.compare(0, prefix_len, SHM_ADDR_PREFIX) != 0)
+			return parse_ip_and_port(host);
+	}
+
+	std::string path = host.substr(prefix_len);
+	struct sockaddr_un * un;
+	if (path.size() == 0 || path.size() >= sizeof(un->sun_path))
+		throw std::runtime_error(
+				std::string("[HWIO] Wrong unix socket path: ") + path);
+
+	// addrinfo and the address are allocated in one block, released by free_addr
+	auto res = reinterpret_cast<struct addrinfo *>(calloc(1,
+			sizeof(struct addrinfo) + sizeof(struct sockaddr_un)));
+	if (res == nullptr)
+		throw std::bad_alloc();
+	un = reinterpret_cast<struct sockaddr_un *>(res + 1);
+	un->sun_family = AF_UNIX;
+	strncpy(un->sun_path, path.c_str(), sizeof(un->sun_path) - 1);
+
+	res->ai_family = AF_UNIX;
+	res->ai_socktype = SOCK_STREAM;
+	res->ai_protocol = 0;
+	res->ai_addr = reinterpret_cast<struct sockaddr *>(un);
+	res->ai_addrlen = sizeof(struct sockaddr_un);
+	return res;
+}
+
+void free_addr(struct addrinfo * addr) {
+	if (addr == nullptr)
+		return;
+	if (addr->ai_family == AF_UNIX)
+		free(addr);
+	else
+		freeaddrinfo(addr);
+}
+
 std::string addrinfo_to_str(const struct addrinfo * addr) {
 	if (addr == nullptr)
 		return "<NULL>";
+	if (addr->ai_family == AF_UNIX)
+		return std::string(UNIX_ADDR_PREFIX)
+				+ ((struct sockaddr_un *) addr->ai_addr)->sun_path;
 
 	std::stringstream ss;
 	char ipstr[INET_ADDRSTRLEN];
@@ -80,4 +128,34 @@ std::string addrinfo_to_str(const struct addrinfo * addr) {
 	return ss.str();
 }
 
+static bool is_tcp_socket(int fd) {
+	int domain = 0;
+	socklen_t len = sizeof(domain);
+	if (getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &domain, &len) < 0)
+		return false;
+	return domain == AF_INET || domain == AF_INET6;
+}
+
+void socket_set_latency(int fd, hwio_latency_e latency) {
+	if (latency == HWIO_LATENCY_DEFAULT || !is_tcp_socket(fd))
+		return;
+	int one = 1;
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0)
+		throw std::runtime_error(
+				std::string("[HWIO] Can not set TCP_NODELAY: ") + strerror(errno));
+	// the kernel may switch back to delayed ACK later, TCP_NODELAY alone
+	// already removes the stall on small requests
+	setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+}
+
+bool socket_set_cork(int fd, bool enable) {
+	if (!is_tcp_socket(fd))
+		return false;
+	int v = enable;
+	if (setsockopt(fd, IPPROTO_TCP, TCP_CORK, &v, sizeof(v)) < 0)
+		throw std::runtime_error(
+				std::string("[HWIO] Can not set TCP_CORK: ") + strerror(errno));
+	return true;
+}
+
 }
@@ -5,10 +5,51 @@
 #include <string>
 #include <arpa/inet.h>
 #include <netdb.h> /* getprotobyname */
+#include <sys/un.h>
 
 namespace hwio {
 
+// prefix of address of unix domain socket (unix:/path/to.sock)
+extern const char * UNIX_ADDR_PREFIX;
+// prefix of address of unix domain socket, the connection then uses
+// shared memory transport (shm:/path/to.sock)
+extern const char * SHM_ADDR_PREFIX;
+
 struct addrinfo * parse_ip_and_port(const std::string & host);
+
+/*
+ * Parse address of server in format ip:port, [ipv6]:port, unix:/path/to.sock
+ * or shm:/path/to.sock
+ *
+ * @note the result has to be released by free_addr
+ * */
+struct addrinfo * parse_addr(const std::string & host);
+void free_addr(struct addrinfo * addr);
+
 std::string addrinfo_to_str(const struct addrinfo * addr);
 
+/*
+ * Profile of socket options of connection between client and server
+ * */
+enum hwio_latency_e {
+	// system defaults (Nagle algorithm, delayed ACK)
+	HWIO_LATENCY_DEFAULT,
+	// TCP_NODELAY and TCP_QUICKACK, for interactive request/response traffic
+	HWIO_LATENCY_LOW,
+};
+
+/*
+ * Apply latency profile to connected socket
+ * (only TCP sockets are affected, unix domain sockets are left as they are)
+ * */
+void socket_set_latency(int fd, hwio_latency_e latency);
+
+/*
+ * Enable/disable TCP_CORK, while the socket is corked only full segments
+ * are sent (used for explicit batches of requests)
+ *
+ * @return false if the socket is not a TCP socket
+ * */
+bool socket_set_cork(int fd, bool enable);
+
 }
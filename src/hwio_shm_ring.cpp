@@ -0,0 +1,231 @@
+#include "hwio_shm_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+namespace hwio {
+
+const uint64_t hwio_shm_ring::MIN_SPIN_NS = 1000;
+const uint64_t hwio_shm_ring::MAX_SPIN_NS = 100000;
+const size_t hwio_shm_channel::DEFAULT_RING_SIZE = 256 * 1024;
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+hwio_shm_ring::hwio_shm_ring(void * mem, size_t size, int efd) :
+		ctrl(reinterpret_cast<hwio_shm_ring_ctrl *>(mem)),
+		data(reinterpret_cast<uint8_t *>(mem) + sizeof(hwio_shm_ring_ctrl)),
+		size(size), efd(efd), spin_ns(MIN_SPIN_NS) {
+	if (size == 0 || (size & (size - 1)))
+		throw std::runtime_error("[HWIO] size of shm ring has to be power of 2");
+}
+
+size_t hwio_shm_ring::readable() const {
+	uint64_t used = ctrl->head.load(std::memory_order_acquire)
+			- ctrl->tail.load(std::memory_order_relaxed);
+	// the other side could corrupt the control block
+	return std::min<uint64_t>(used, size);
+}
+
+size_t hwio_shm_ring::writable() const {
+	uint64_t used = ctrl->head.load(std::memory_order_relaxed)
+			- ctrl->tail.load(std::memory_order_acquire);
+	return size - std::min<uint64_t>(used, size);
+}
+
+size_t hwio_shm_ring::read(void * dst, size_t n) {
+	n = std::min(n, readable());
+	if (n == 0)
+		return 0;
+	uint64_t tail = ctrl->tail.load(std::memory_order_relaxed);
+	size_t off = tail & (size - 1);
+	size_t first = std::min(n, size - off);
+	uint8_t * d = reinterpret_cast<uint8_t *>(dst);
+	memcpy(d, data + off, first);
+	memcpy(d + first, data, n - first);
+	ctrl->tail.store(tail + n, std::memory_order_release);
+	return n;
+}
+
+size_t hwio_shm_ring::write(const void * src, size_t n) {
+	n = std::min(n, writable());
+	if (n == 0)
+		return 0;
+	uint64_t head = ctrl->head.load(std::memory_order_relaxed);
+	size_t off = head & (size - 1);
+	size_t first = std::min(n, size - off);
+	const uint8_t * s = reinterpret_cast<const uint8_t *>(src);
+	memcpy(data + off, s, first);
+	memcpy(data, s + first, n - first);
+	ctrl->head.store(head + n, std::memory_order_release);
+	return n;
+}
+
+void hwio_shm_ring::notify() {
+	// pairs with the fence in prepare_sleep, either the consumer sees
+	// the new head or we see its sleeping flag
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (ctrl->consumer_sleeping.load(std::memory_order_relaxed)) {
+		eventfd_t v = 1;
+		while (eventfd_write(efd, v) < 0 && errno == EINTR)
+			;
+	}
+}
+
+bool hwio_shm_ring::spin_wait() {
+	if (readable())
+		return true;
+	auto start = std::chrono::steady_clock::now();
+	auto deadline = start + std::chrono::nanoseconds(spin_ns);
+	while (true) {
+		for (int i = 0; i < 64; i++) {
+			if (readable()) {
+				// data arrived while spinning, spinning was worth it
+				spin_ns = std::min(spin_ns * 2, MAX_SPIN_NS);
+				return true;
+			}
+			cpu_relax();
+		}
+		if (std::chrono::steady_clock::now() >= deadline)
+			break;
+	}
+	spin_ns = std::max(spin_ns / 2, MIN_SPIN_NS);
+	return false;
+}
+
+bool hwio_shm_ring::prepare_sleep() {
+	ctrl->consumer_sleeping.store(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (readable()) {
+		ctrl->consumer_sleeping.store(0, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+void hwio_shm_ring::wake_up() {
+	ctrl->consumer_sleeping.store(0, std::memory_order_relaxed);
+	eventfd_t v;
+	// eventfd is non-blocking, the counter may be already cleared
+	eventfd_read(efd, &v);
+}
+
+int hwio_shm_ring::event_fd() const {
+	return efd;
+}
+
+size_t hwio_shm_ring::mem_size(size_t size) {
+	return sizeof(hwio_shm_ring_ctrl) + size;
+}
+
+hwio_shm_channel::hwio_shm_channel(size_t ring_size) :
+		mem_fd(-1), mem(MAP_FAILED), ring_size(ring_size), req_efd(-1),
+		resp_efd(-1), req(nullptr), resp(nullptr) {
+	mem_fd = syscall(SYS_memfd_create, "hwio_shm", MFD_CLOEXEC);
+	if (mem_fd < 0)
+		throw std::runtime_error(
+				std::string("[HWIO] memfd_create failed: ") + strerror(errno));
+	if (ftruncate(mem_fd, 2 * hwio_shm_ring::mem_size(ring_size)) < 0) {
+		close(mem_fd);
+		throw std::runtime_error(
+				std::string("[HWIO] ftruncate of shm failed: ") + strerror(errno));
+	}
+	req_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	resp_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (req_efd < 0 || resp_efd < 0) {
+		close(mem_fd);
+		if (req_efd >= 0)
+			close(req_efd);
+		if (resp_efd >= 0)
+			close(resp_efd);
+		throw std::runtime_error(
+				std::string("[HWIO] eventfd failed: ") + strerror(errno));
+	}
+	map();
+	// memory of memfd is zeroed, construct the control blocks
+	new (mem) hwio_shm_ring_ctrl();
+	new (reinterpret_cast<uint8_t *>(mem) + hwio_shm_ring::mem_size(ring_size)) hwio_shm_ring_ctrl();
+}
+
+hwio_shm_channel::hwio_shm_channel(int mem_fd, int req_efd, int resp_efd,
+		size_t ring_size) :
+		mem_fd(mem_fd), mem(MAP_FAILED), ring_size(ring_size), req_efd(
+				req_efd), resp_efd(resp_efd), req(nullptr), resp(nullptr) {
+	map();
+}
+
+void hwio_shm_channel::map() {
+	size_t s = hwio_shm_ring::mem_size(ring_size);
+	if (ring_size == 0 || (ring_size & (ring_size - 1))) {
+		close(mem_fd);
+		close(req_efd);
+		close(resp_efd);
+		throw std::runtime_error("[HWIO] size of shm ring has to be power of 2");
+	}
+	// fd may come from other process, it has to have exactly the size
+	// of both rings (access behind the end of file would SIGBUS)
+	struct stat st;
+	if (fstat(mem_fd, &st) < 0 || uint64_t(st.st_size) != 2 * s) {
+		close(mem_fd);
+		close(req_efd);
+		close(resp_efd);
+		throw std::runtime_error("[HWIO] shm has wrong size");
+	}
+	mem = mmap(nullptr, 2 * s, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+	if (mem == MAP_FAILED) {
+		close(mem_fd);
+		close(req_efd);
+		close(resp_efd);
+		throw std::runtime_error(
+				std::string("[HWIO] mmap of shm failed: ") + strerror(errno));
+	}
+	uint8_t * m = reinterpret_cast<uint8_t *>(mem);
+	req = new hwio_shm_ring(m, ring_size, req_efd);
+	resp = new hwio_shm_ring(m + s, ring_size, resp_efd);
+}
+
+int hwio_shm_channel::get_mem_fd() const {
+	return mem_fd;
+}
+
+int hwio_shm_channel::get_req_efd() const {
+	return req_efd;
+}
+
+int hwio_shm_channel::get_resp_efd() const {
+	return resp_efd;
+}
+
+size_t hwio_shm_channel::get_ring_size() const {
+	return ring_size;
+}
+
+hwio_shm_channel::~hwio_shm_channel() {
+	delete req;
+	delete resp;
+	if (mem != MAP_FAILED)
+		munmap(mem, 2 * hwio_shm_ring::mem_size(ring_size));
+	close(mem_fd);
+	close(req_efd);
+	close(resp_efd);
+}
+
+}
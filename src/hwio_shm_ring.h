@@ -0,0 +1,144 @@
+#pragma once
+/*
+ * Shared memory transport between hwio client and server on the same host
+ *
+ * Client and server share a memfd with a pair of single-producer/single-consumer
+ * rings (requests client -> server, responses server -> client). Data in the
+ * rings use the same framing as the socket connection.
+ *
+ * The consumer of the ring spins for a while if the ring is empty and then
+ * it sleeps on eventfd. The producer writes to the eventfd only if the consumer
+ * is sleeping, there is no syscall on the fast path.
+ * */
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace hwio {
+
+/*
+ * Control block of the ring in shared memory
+ * (head and tail are free running byte counters)
+ * */
+struct hwio_shm_ring_ctrl {
+	// written only by producer
+	alignas(64) std::atomic<uint64_t> head;
+	// written only by consumer
+	alignas(64) std::atomic<uint64_t> tail;
+	// set by consumer before it goes to sleep on eventfd
+	alignas(64) std::atomic<uint32_t> consumer_sleeping;
+};
+
+class hwio_shm_ring {
+	hwio_shm_ring_ctrl * ctrl;
+	uint8_t * data;
+	size_t size;
+	// eventfd used to wake up the consumer
+	int efd;
+
+	// current spin time of consumer, adapted by spin_wait
+	uint64_t spin_ns;
+
+public:
+	static const uint64_t MIN_SPIN_NS;
+	static const uint64_t MAX_SPIN_NS;
+
+	/*
+	 * @param mem control block followed by data of the ring
+	 * @param size size of data of the ring (power of 2)
+	 * @param efd eventfd for consumer wake up
+	 * */
+	hwio_shm_ring(void * mem, size_t size, int efd);
+
+	/*
+	 * @return number of bytes which can be read from the ring
+	 * */
+	size_t readable() const;
+	/*
+	 * @return number of bytes which can be written to the ring
+	 * */
+	size_t writable() const;
+
+	/*
+	 * Copy up to n bytes from the ring
+	 * @return number of copied bytes
+	 * */
+	size_t read(void * dst, size_t n);
+	/*
+	 * Copy up to n bytes to the ring (notify has to be called to wake up consumer)
+	 * @return number of copied bytes
+	 * */
+	size_t write(const void * src, size_t n);
+
+	/*
+	 * Wake up the consumer if it is sleeping
+	 * */
+	void notify();
+
+	/*
+	 * Spin until the ring is not empty or spin time expires, the spin time is
+	 * prolonged if data arrived during spinning and shortened otherwise
+	 *
+	 * @return true if there are data in the ring
+	 * */
+	bool spin_wait();
+
+	/*
+	 * Announce that consumer is going to sleep on eventfd
+	 *
+	 * @return false if the ring is not empty and consumer should not sleep
+	 * */
+	bool prepare_sleep();
+	/*
+	 * Consumer woke up, clear the sleeping flag and the eventfd counter
+	 * */
+	void wake_up();
+
+	int event_fd() const;
+
+	/*
+	 * @return size of shared memory required for the ring with data of size
+	 * */
+	static size_t mem_size(size_t size);
+};
+
+/*
+ * Shared memory with the pair of rings and eventfds of a single client
+ * */
+class hwio_shm_channel {
+	int mem_fd;
+	void * mem;
+	size_t ring_size;
+	int req_efd;
+	int resp_efd;
+
+	void map();
+
+public:
+	static const size_t DEFAULT_RING_SIZE;
+
+	hwio_shm_ring * req;
+	hwio_shm_ring * resp;
+
+	/*
+	 * Create new shared memory and eventfds (server side)
+	 * */
+	hwio_shm_channel(size_t ring_size);
+	/*
+	 * Map shared memory created by the other side (client side),
+	 * the channel takes ownership of the file descriptors
+	 * */
+	hwio_shm_channel(int mem_fd, int req_efd, int resp_efd, size_t ring_size);
+
+	hwio_shm_channel(const hwio_shm_channel &) = delete;
+	hwio_shm_channel & operator=(const hwio_shm_channel &) = delete;
+
+	int get_mem_fd() const;
+	int get_req_efd() const;
+	int get_resp_efd() const;
+	size_t get_ring_size() const;
+
+	~hwio_shm_channel();
+};
+
+}
@@ -2,28 +2,111 @@
 #include "hwio_remote_utils.h"
 
 #include <algorithm>
+#include <chrono>
 #include <stdexcept>
 #include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/socket.h>
 
 using namespace std;
 using namespace hwio;
 
 const char * HwioServer::DEFAULT_ADDR = "0.0.0.0:8896";
+const size_t HwioServer::DEFAULT_TX_HIGH_WATER = 256 * 1024;
+const uint64_t HwioServer::DEFAULT_PROGRAM_MAX_POLL_TIME = 2000;
+thread_local char * HwioServer::rx_buffer;
+thread_local char HwioServer::tx_buffer[BUFFER_SIZE];
 
 HwioServer::HwioServer(struct addrinfo * addr, std::vector<ihwio_bus *> buses) :
-		addr(addr), master_socket(-1), log_level(logWARNING), buses(buses) {
-	client_timeout.tv_nsec = 1000 * POLL_TIMEOUT_MS;
+		addr(addr), master_socket(-1), epoll_fd(-1), wake_efd(-1),
+		wait_timer_fd(-1), shm_tx_timer_fd(-1),
+		exec_stop(false), log_level(logWARNING), edge_triggered(false),
+		tx_high_water(DEFAULT_TX_HIGH_WATER), latency(HWIO_LATENCY_DEFAULT),
+		program_max_poll_time(DEFAULT_PROGRAM_MAX_POLL_TIME),
+		buses(buses), busy_poll(false) {
+	busy_poll_stats.spin_ns = 0;
+	busy_poll_stats.busy_ns = 0;
+	busy_poll_stats.polls = 0;
+	busy_poll_stats.empty_polls = 0;
+	client_timeout.tv_nsec = 1000000 * (POLL_TIMEOUT_MS % 1000);
 	client_timeout.tv_sec = POLL_TIMEOUT_MS / 1000;
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0)
+		throw std::runtime_error(
+				std::string("[HWIO, server] epoll_create failed: ")
+						+ strerror(errno));
+	wake_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wake_efd < 0) {
+		close(epoll_fd);
+		throw std::runtime_error(
+				std::string("[HWIO, server] eventfd failed: ") + strerror(errno));
+	}
+	wait_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (wait_timer_fd < 0) {
+		close(wake_efd);
+		close(epoll_fd);
+		throw std::runtime_error(
+				std::string("[HWIO, server] timerfd_create failed: ")
+						+ strerror(errno));
+	}
+	shm_tx_timer_fd = timerfd_create(CLOCK_MONOTONIC,
+			TFD_NONBLOCK | TFD_CLOEXEC);
+	if (shm_tx_timer_fd < 0) {
+		close(wait_timer_fd);
+		close(wake_efd);
+		close(epoll_fd);
+		throw std::runtime_error(
+				std::string("[HWIO, server] timerfd_create failed: ")
+						+ strerror(errno));
+	}
+}
+
+/*
+ * Remove socket file left by previous instance of server
+ *
+ * The path is removed only if it is a socket which nobody listens on,
+ * @throw std::runtime_error (EADDRINUSE) if the path is used
+ * */
+static void unlink_stale_unix_socket(const struct sockaddr * addr,
+		socklen_t addrlen) {
+	const char * path = ((const struct sockaddr_un *) addr)->sun_path;
+	struct stat st;
+	if (lstat(path, &st)) {
+		if (errno == ENOENT)
+			return;
+		throw std::runtime_error(
+				std::string("[HWIO, server] Can not stat ") + path + ": "
+						+ strerror(errno));
+	}
+	bool stale = false;
+	if (S_ISSOCK(st.st_mode)) {
+		int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (s < 0)
+			throw std::runtime_error(
+					std::string("[HWIO, server] socket failed: ")
+							+ strerror(errno));
+		stale = connect(s, addr, addrlen) < 0 && errno == ECONNREFUSED;
+		close(s);
+	}
+	if (!stale)
+		throw std::runtime_error(
+				std::string("[HWIO, server] Can not listen on ") + path + ": "
+						+ strerror(EADDRINUSE));
+	unlink(path);
 }
 
 void HwioServer::prepare_server_socket() {
-	struct sockaddr_in * addr = ((struct sockaddr_in *) this->addr->ai_addr);
 	int opt = true;
+	if (addr->ai_family == AF_UNIX)
+		unlink_stale_unix_socket(addr->ai_addr, addr->ai_addrlen);
 	//create a master socket
-	if ((master_socket = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+	if ((master_socket = socket(addr->ai_family, SOCK_STREAM, 0)) < 0) {
 		std::stringstream errss;
 		errss << "hwio_server socket failed: " << gai_strerror(master_socket);
 		throw std::runtime_error(std::string("[HWIO, server]") + errss.str());
@@ -48,12 +131,16 @@ void HwioServer::prepare_server_socket() {
 		throw std::runtime_error(std::string("[HWIO, server]") + errss.str());
 	}
 	//bind the socket
-	err = bind(master_socket, (sockaddr *) addr, sizeof(*addr));
+	err = bind(master_socket, addr->ai_addr, addr->ai_addrlen);
 	if (err < 0) {
 		std::stringstream errss;
 		errss << "hwio_server bind failed: " << gai_strerror(err);
 		throw std::runtime_error(std::string("[HWIO, server]") + errss.str());
 	}
+	if (addr->ai_family == AF_UNIX) {
+		// removed in destructor
+		unix_socket_path = ((struct sockaddr_un *) addr->ai_addr)->sun_path;
+	}
 
 	err = listen(master_socket, MAX_PENDING_CONNECTIONS);
 	if (err < 0) {
@@ -62,10 +149,12 @@ void HwioServer::prepare_server_socket() {
 		throw std::runtime_error(std::string("[HWIO, server]") + errss.str());
 	}
 
-	struct pollfd pfd;
-	pfd.fd = master_socket;
-	pfd.events = POLLIN;
-	poll_fds.push_back(pfd);
+	// all pending connections are accepted at once
+	fcntl(master_socket, F_SETFL, fcntl(master_socket, F_GETFL) | O_NONBLOCK);
+	epoll_add(master_socket, FD_MASTER, nullptr);
+	epoll_add(wake_efd, FD_WAKE, nullptr);
+	epoll_add(wait_timer_fd, FD_WAIT_TIMER, nullptr);
+	epoll_add(shm_tx_timer_fd, FD_SHM_TX_TIMER, nullptr);
 
 	// now can accept the incoming connection
 	if (log_level >= logDEBUG)
@@ -93,9 +182,39 @@ HwioServer::PProcRes HwioServer::handle_msg(ClientInfo * client,
 	case HWIO_CMD_WRITE:
 		return handle_write(client, header);
 
+	case HWIO_CMD_READ_MULTIPLE:
+		return handle_read_multiple(client, header);
+
+	case HWIO_CMD_WRITE_MULTIPLE:
+		return handle_write_multiple(client, header);
+
+	case HWIO_CMD_READ_KEYHOLE:
+		return handle_read_keyhole(client, header);
+
+	case HWIO_CMD_WRITE_KEYHOLE:
+		return handle_write_keyhole(client, header);
+
+	case HWIO_CMD_FILL:
+		return handle_fill(client, header);
+
+	case HWIO_CMD_RMW:
+		return handle_rmw(client, header);
+
+	case HWIO_CMD_WAIT_UNTIL:
+		return handle_wait_until(client, header);
+
+	case HWIO_CMD_PROGRAM:
+		return handle_program(client, header);
+
+	case HWIO_CMD_BATCH:
+		return handle_batch(client, header);
+
 	case HWIO_CMD_REMOTE_CALL:
 		return handle_remote_call(client, header);
 
+	case HWIO_CMD_SHM_ATTACH:
+		return handle_shm_attach(client, header);
+
 	case HWIO_CMD_PING_REQUEST:
 		if (header.body_len != 0)
 			return send_err(MALFORMED_PACKET, "ECHO_REQUEST: size has to be 0");
@@ -154,381 +273,506 @@ ClientInfo * HwioServer::add_new_client(int socket) {
 	else
 		clients.push_back(client);
 
-	assert(fd_to_client.find(socket) == fd_to_client.end());
-	fd_to_client[socket] = client;
-	struct pollfd pfd;
-	pfd.events = POLLIN;
-	pfd.fd = socket;
-	pfd.revents = 0;
-	poll_fds.push_back(pfd);
+	epoll_add(socket, FD_CLIENT, client);
 	return client;
 }
 
 void HwioServer::remove_client(int socket) {
-	std::map<int, ClientInfo*>::iterator _client = fd_to_client.find(socket);
 	ClientInfo * client = nullptr;
-	if (_client == fd_to_client.end()) {
+	if (socket >= 0 && size_t(socket) < fd_table.size()
+			&& fd_table[socket].kind == FD_CLIENT)
+		client = fd_table[socket].client;
+	if (client == nullptr) {
 		if (log_level >= logWARNING) {
 			std::cout << "[WARNING] " << "Socket: " << socket << " is not in client database." << endl;
 		}
 		return;
-	} else {
-		client = _client->second;
 	}
 	assert(client->fd == socket);
+	if (client->shm && fd_table[client->shm->get_req_efd()].kind == FD_SHM)
+		epoll_del(client->shm->get_req_efd());
+	wait_remove(client);
+	if (workers.size()) {
+		std::lock_guard<std::mutex> lock(exec_lock);
+		if (client->parked_devs.size()) {
+			exec_release(client->parked_devs);
+			client->parked_devs.clear();
+		}
+		exec_parked.erase(
+				std::remove(exec_parked.begin(), exec_parked.end(), client),
+				exec_parked.end());
+		exec_done_clients.erase(
+				std::remove(exec_done_clients.begin(), exec_done_clients.end(),
+						client), exec_done_clients.end());
+		if (client->pending) {
+			// removed once its requests in worker threads are completed,
+			// the socket stays in fd_table until then
+			client->closing = true;
+			epoll_ctl(epoll_fd, EPOLL_CTL_DEL, socket, nullptr);
+			return;
+		}
+	}
+	epoll_del(socket);
 	clients[client->id] = nullptr;
-	fd_to_client.erase(socket);
+	client->rx_buffer.curr_len = 0;
+	rx_release(client);
 	delete client;
 }
 
+void HwioServer::disconnect_client(ClientInfo * client) {
+	// Somebody disconnected, get his details and print
+	// packet had wrong format or connection was disconnected.
+	if (log_level >= logINFO) {
+		std::cout << "[INFO] " << "Client " << client->id << " socket:"
+				<< client->fd << " disconnected" << endl;
+
+		for (auto d : client->devices) {
+			std::cout << "    owned device:" << endl;
+			for (auto & s : d->get_spec())
+				std::cout << "        " << s.to_str() << endl;
+		}
+	}
+	remove_client(client->fd);
+}
+
 size_t HwioServer::get_client_cnt() {
 	size_t i = 0;
 	for (auto c : clients) {
 		if (c != nullptr)
 			i++;
 	}
-	assert(i == fd_to_client.size());
 	return i;
 }
 
-void HwioServer::pool_client_msgs() {
-	//sigset_t origmask;
-	//sigprocmask(0, nullptr, &origmask);
-
-	// wait for an activity on one of the sockets , timeout is NULL ,
-	// so wait indefinitely
-	int err = ppoll(&poll_fds[0], poll_fds.size(), &client_timeout, nullptr);
-	if (err == 0) {
-		// timeout
-		return;
-	} else if (err < 0) {
-		if (errno == EINTR) {
-			if (log_level >= logINFO)
-				LOG_ERR << "ppoll interrupted by signal" << endl;
-			return;
-		}
-		if (log_level >= logERROR)
-			LOG_ERR << "ppoll error" << endl;
-		throw std::runtime_error("Error condition upon execution of ppoll()! errno = " + std::to_string(errno));
-	}
+void HwioServer::epoll_add(int fd, fd_kind_e kind, ClientInfo * client) {
+	if (size_t(fd) >= fd_table.size())
+		fd_table.resize(fd + 1, { FD_NONE, nullptr });
+	assert(fd_table[fd].kind == FD_NONE);
+	fd_table[fd] = {kind, client};
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN | (edge_triggered ? EPOLLET : 0);
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		throw std::runtime_error(
+				std::string("[HWIO, server] epoll_ctl ADD failed: ")
+						+ strerror(errno));
+}
+
+void HwioServer::epoll_del(int fd) {
+	// the eventfd of shared memory is shared with client process,
+	// it would stay in epoll after close
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	fd_table[fd] = {FD_NONE, nullptr};
+}
 
-	// If something happened on the master socket,
-	// then its an incoming connection and we need to spot new client info instance
-	for (auto & fd : poll_fds) {
-		auto e = fd.revents;
-		if (fd.fd < 0 || fd.revents == 0)
-			continue;
+void HwioServer::epoll_set_events(int fd, uint32_t events) {
+	struct epoll_event ev;
+	ev.events = events | (edge_triggered ? EPOLLET : 0);
+	ev.data.fd = fd;
+	epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
 
-		if (fd.revents != POLLIN)
-			std::cerr << "fd:" << fd.fd << " revents:" << fd.revents
-					<< std::endl;
+void HwioServer::accept_clients() {
+	// master socket is non-blocking, accept until there is no connection
+	while (true) {
+		struct sockaddr_storage address;
+		socklen_t addrlen = sizeof(address);
+		// responses which do not fit in to socket are queued in client
+		int new_socket = accept4(master_socket, (struct sockaddr *) &address,
+				&addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (new_socket < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			throw runtime_error("error in accept for client socket");
+		}
 
-		if ((e & POLLERR) | (e & POLLHUP) | (e & POLLNVAL)) {
-			if (fd.fd == master_socket) {
-				LOG_ERR << "Error on master socket" << std::endl;
-				throw std::runtime_error("Error condition on master socket! fd.revents = " + std::to_string(e));
+		if (log_level >= logINFO) {
+			//inform user of socket number - used in send and receive commands
+			std::cout << "[INFO] New connection, ";
+			if (address.ss_family == AF_INET) {
+				auto a = (struct sockaddr_in *) &address;
+				std::cout << "ip:" << inet_ntoa(a->sin_addr) << ", port:"
+						<< ntohs(a->sin_port);
 			} else {
-				LOG_ERR << "Error on socket " << fd.fd << " fd.revents = " << std::to_string(e) << std::endl;
-				remove_client(fd.fd);
-				removed_poll_fds.push_back(fd.fd);
-			}
-		} else if (fd.fd == master_socket) {
-			struct sockaddr_in address;
-			int addrlen = sizeof(address);
-			int new_socket;
-			if ((new_socket = accept(master_socket,
-					(struct sockaddr *) &address, (socklen_t*) &addrlen))
-					< 0)
-				throw runtime_error("error in accept for client socket");
-
-			if (log_level >= logINFO) {
-				//inform user of socket number - used in send and receive commands
-				std::cout << "[INFO] New connection, ip:"
-						<< inet_ntoa(address.sin_addr) << ", port:"
-						<< ntohs(address.sin_port) << " socket:"
-						<< new_socket << endl;
+				std::cout << addrinfo_to_str(addr);
 			}
-			add_new_client(new_socket);
-		} else {
-			handle_multiple_client_requests(fd.fd);
+			std::cout << " socket:" << new_socket << endl;
 		}
-	}
-	if (removed_poll_fds.size() > 0) {
-		auto new_poll_fds = std::vector<struct pollfd>();
-		// Clean up after fd error condition
-		for (auto & fd : poll_fds) {
-			bool add = true;
-			for (auto & rfd : removed_poll_fds) {
-				if (fd.fd == rfd) {
-					add = false;
-					break;
-				}
-			}
-			if (add)
-				new_poll_fds.push_back(fd);
+		set_socket_busy_poll(new_socket);
+		try {
+			socket_set_latency(new_socket, latency);
+		} catch (const std::runtime_error & err) {
+			if (log_level >= logWARNING)
+				LOG_ERR << err.what() << std::endl;
 		}
-		poll_fds.swap(new_poll_fds);
-		removed_poll_fds.clear();
+		add_new_client(new_socket);
 	}
 }
-void HwioServer::handle_client_requests(int sd) {
-	// else its some IO operation on some other socket
-	//Check if it was for closing , and also read the
-	//incoming message
-	std::map<int, ClientInfo*>::iterator _client = fd_to_client.find(sd);
-	ClientInfo * client = nullptr;
-	if (_client == fd_to_client.end()) {
-		client = add_new_client(sd);
-	} else {
-		client = _client->second;
+
+void HwioServer::pool_client_msgs() {
+	pool_client_msgs(
+			client_timeout.tv_sec * 1000 + client_timeout.tv_nsec / 1000000);
+}
+
+void HwioServer::pool_client_msgs(int timeout_ms) {
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+	int cnt;
+	if (busy_poll)
+		cnt = busy_poll_wait(events, timeout_ms);
+	else
+		cnt = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, timeout_ms);
+	auto busy_start = std::chrono::steady_clock::now();
+	if (cnt < 0) {
+		if (errno == EINTR) {
+			if (log_level >= logINFO)
+				LOG_ERR << "epoll_wait interrupted by signal" << endl;
+			return;
+		}
+		if (log_level >= logERROR)
+			LOG_ERR << "epoll_wait error" << endl;
+		throw std::runtime_error("Error condition upon execution of epoll_wait()! errno = " + std::to_string(errno));
 	}
-	//std::cout << "handle_client_requests:" << sd << " " << client->id
-	//		<< std::endl;
-	assert(client->fd == sd);
 
-	PProcRes respMeta(true, 0);
-	Hwio_packet_header header;
+	for (int i = 0; i < cnt; i++) {
+		int fd = events[i].data.fd;
+		uint32_t e = events[i].events;
+		// the file descriptor may be removed while processing of previous event
+		fd_info_t info = fd_table[fd];
+		switch (info.kind) {
+		case FD_NONE:
+			break;
 
-	int rx_data_size = 0;
-	uint8_t* data_ptr = reinterpret_cast<uint8_t*>(&header);
-	while (true) {
-		errno = 0;
-		int s = recv(sd, data_ptr+rx_data_size, sizeof(Hwio_packet_header) - rx_data_size, MSG_DONTWAIT);
-		if (s < 0) {
-			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-				continue;
-			} else {
-				// process as error
-				rx_data_size = 0;
-				break;
+		case FD_MASTER:
+			if (e & (EPOLLERR | EPOLLHUP)) {
+				LOG_ERR << "Error on master socket" << std::endl;
+				throw std::runtime_error("Error condition on master socket! events = " + std::to_string(e));
 			}
-		} else if (s == 0) {
-			// process as error
-			rx_data_size = 0;
+			accept_clients();
 			break;
-		} else {
-			rx_data_size += s;
-			if (rx_data_size == sizeof(Hwio_packet_header))
+
+		case FD_WAKE:
+			handle_exec_done();
+			break;
+
+		case FD_WAIT_TIMER:
+			handle_wait_timer();
+			break;
+
+		case FD_SHM_TX_TIMER:
+			handle_shm_tx_timer();
+			break;
+
+		case FD_SHM:
+			handle_shm_client_requests(info.client);
+			break;
+
+		case FD_CLIENT:
+			if (info.client->closing)
 				break;
-		}
-	}
-	if (rx_data_size != 0) {
-		bool err = false;
-		data_ptr = reinterpret_cast<uint8_t*>(&rx_buffer);
-		rx_data_size = 0;
-		if (header.body_len) {
-			while (true) {
-				int s = recv(sd, data_ptr + rx_data_size, header.body_len - rx_data_size, MSG_DONTWAIT);
-				if (s < 0) {
-					if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-						continue;
-					} else {
-						// process as error
-						rx_data_size = 0;
-						break;
-					}
-				} else if (s == 0) {
-					// process as error
-					rx_data_size = 0;
+			if ((e & EPOLLERR) || ((e & EPOLLHUP) && !(e & EPOLLIN))) {
+				if (log_level >= logINFO)
+					LOG_ERR << "Error on socket " << fd << " events = " << std::to_string(e) << std::endl;
+				disconnect_client(info.client);
+				break;
+			}
+			if (e & EPOLLOUT) {
+				bool paused = client_tx_paused(info.client);
+				if (!flush_client_tx(info.client)) {
+					disconnect_client(info.client);
 					break;
-				} else {
-					rx_data_size += s;
-					if (rx_data_size == header.body_len)
-						break;
 				}
+				// continue with requests which are already in rx_buffer
+				if (paused && !client_tx_paused(info.client)
+						&& !parse_msgs(info.client))
+					break;
 			}
-			if (rx_data_size == 0) {
-				respMeta = send_err(MALFORMED_PACKET,
-						std::string(
-								"Wrong frame body (expectedSize="
-										+ std::to_string(int(header.body_len))
-										+ " got="
-										+ std::to_string(rx_data_size)));
-				err = true;
-			}
-		}
-		if (!err) {
-			respMeta = handle_msg(client, header);
-			if (respMeta.tx_size) {
-				size_t bytesWr = 0;
-				int result;
-				while (bytesWr < respMeta.tx_size) {
-					result = send(sd, tx_buffer + bytesWr, respMeta.tx_size - bytesWr, 0);
-					if (result < 0) {
-						if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-							continue;
-						}
-						respMeta = PProcRes(true, 0);
-						if (log_level >= logERROR) {
-							std::cerr
-									<< "[HWIO, server] Can not send response to client "
-									<< (client->id) << " (socket=" << (client->fd)
-									<< ")" << std::endl;
-							break; 
-						}
-					}
-					bytesWr += result;
-                                }
-			}
+			if (e & EPOLLIN)
+				handle_multiple_client_requests(info.client);
+			break;
 		}
 	}
+	if (busy_poll) {
+		auto busy = std::chrono::steady_clock::now() - busy_start;
+		busy_poll_stats.busy_ns.fetch_add(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count(),
+				std::memory_order_relaxed);
+	}
+}
 
-	if (respMeta.disconnect) {
-		// Somebody disconnected, get his details and print
-		// packet had wrong format or connection was disconnected.
-		if (log_level >= logINFO) {
-			std::cout << "[INFO] " << "Client " << client->id << " socket:"
-					<< client->fd << " disconnected" << endl;
+void HwioServer::wakeup() {
+	eventfd_write(wake_efd, 1);
+}
 
-			for (auto d : client->devices) {
-				std::cout << "    owned device:" << endl;
-				for (auto & s : d->get_spec())
-					std::cout << "        " << s.to_str() << endl;
-			}
-		}
-		remove_client(sd);
-		removed_poll_fds.push_back(sd);
-	}
+void HwioServer::rx_acquire(ClientInfo * client) {
+    if (client->rx_buffer.buffer == nullptr)
+        client->rx_buffer.buffer = rx_pool.get();
 }
 
-bool HwioServer::read_from_socket(ClientInfo * client) {
-    char * rd_ptr = client->rx_buffer.buffer;
-    size_t rd_len = RxBuffer::RX_BUFFER_SIZE;
-    
-    if (client->rx_buffer.curr_len > 0) {
-        if (client->rx_buffer.curr_ptr != client->rx_buffer.buffer) {
-           memcpy(client->rx_buffer.buffer, client->rx_buffer.curr_ptr, client->rx_buffer.curr_len);
-        }
-        rd_ptr += client->rx_buffer.curr_len;
-        rd_len -= client->rx_buffer.curr_len;
+void HwioServer::rx_release(ClientInfo * client) {
+    if (client->rx_buffer.buffer && client->rx_buffer.curr_len == 0) {
+        rx_pool.put(client->rx_buffer.buffer);
+        client->rx_buffer.buffer = nullptr;
+        client->rx_buffer.curr_off = 0;
+    }
+}
+
+ssize_t HwioServer::read_from_socket(ClientInfo * client) {
+    rx_acquire(client);
+    struct iovec iov[2];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = client->rx_buffer.free_space(iov);
+    if (msg.msg_iovlen == 0) {
+        // message does not fit in to buffer
+        return -1;
     }
-    client->rx_buffer.curr_ptr = client->rx_buffer.buffer;
-//     std::cout << "read_from_socket:" << (void*)client->rx_buffer.buffer << " " << (void*)rd_ptr << " " << rd_len << std::endl;
     while (true) {
-        errno = 0;
-        int s = recv(client->fd, rd_ptr, rd_len, MSG_DONTWAIT);
+        ssize_t s = recvmsg(client->fd, &msg, MSG_DONTWAIT);
         if (s > 0) {
             client->rx_buffer.curr_len += s;
-//             std::cout << "read_from_socket:" << s << " " << client->rx_buffer.curr_len << std::endl;
-            return true;
-        } else {
-            if (s < 0) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-                    continue;
-                } else {
-                    // process as error
-                    return false;
-                }
-            } else {
-                // process as error
-                return false;
+            return s;
+        } else if (s < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                rx_release(client);
+                return 0;
             }
         }
+        // process as error
+        return -1;
     }
-    // Should never happen
-    return false;
 }
 
-void HwioServer::parse_msgs(ClientInfo * client) {
+bool HwioServer::send_to_client(ClientInfo * client, size_t tx_size) {
+	std::lock_guard<std::mutex> lock(client->tx_lock);
+	if (client->shm) {
+		send_to_shm(client, tx_size);
+		return true;
+	}
+
+	const char * d = tx_buffer;
+	if (client->tx_queued() == 0) {
+		// nothing is queued, send directly
+		while (tx_size) {
+			ssize_t result = send(client->fd, d, tx_size,
+					MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (result < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					break;
+				return false;
+			}
+			d += result;
+			tx_size -= result;
+		}
+		if (tx_size == 0)
+			return true;
+	}
+	// socket is full, the rest is sent once the socket is writable
+	client->tx_queue.insert(client->tx_queue.end(), d, d + tx_size);
+	client_update_events(client);
+	return true;
+}
+
+void HwioServer::queue_to_client(ClientInfo * client, size_t tx_size) {
+	std::lock_guard<std::mutex> lock(client->tx_lock);
+	client->tx_queue.insert(client->tx_queue.end(), tx_buffer,
+			tx_buffer + tx_size);
+}
+
+bool HwioServer::flush_client_tx(ClientInfo * client) {
+	std::lock_guard<std::mutex> lock(client->tx_lock);
+	while (client->tx_queued()) {
+		const char * d = client->tx_queue.data() + client->tx_queue_head;
+		ssize_t result;
+		if (client->shm_offer && !client->shm_fds_sent) {
+			result = send_shm_fds(client, d, client->tx_queued());
+			if (result > 0)
+				client->shm_fds_sent = true;
+		} else {
+			result = send(client->fd, d, client->tx_queued(),
+					MSG_NOSIGNAL | MSG_DONTWAIT);
+		}
+		if (result < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return false;
+		}
+		client->tx_queue_head += result;
+	}
+	if (client->tx_queued() == 0) {
+		client->tx_queue.clear();
+		client->tx_queue_head = 0;
+		if (client->shm_offer)
+			shm_offer_accepted(client);
+	} else if (client->tx_queue_head > client->tx_queue.size() / 2) {
+		client->tx_queue.erase(client->tx_queue.begin(),
+				client->tx_queue.begin() + client->tx_queue_head);
+		client->tx_queue_head = 0;
+	}
+	client_update_events(client);
+	return true;
+}
+
+void HwioServer::client_update_events(ClientInfo * client) {
+	size_t queued = client->tx_queued();
+	if (queued > tx_high_water)
+		client->tx_paused = true;
+	else if (queued <= tx_high_water / 2)
+		client->tx_paused = false;
+
+	uint32_t events = 0;
+	if (client->rx_enabled && !client->tx_paused)
+		events |= EPOLLIN;
+	if (queued)
+		events |= EPOLLOUT;
+	if (events != client->epoll_events) {
+		client->epoll_events = events;
+		epoll_set_events(client->fd, events);
+	}
+}
+
+void HwioServer::client_set_rx(ClientInfo * client, bool enable) {
+	std::lock_guard<std::mutex> lock(client->tx_lock);
+	client->rx_enabled = enable;
+	client_update_events(client);
+}
+
+bool HwioServer::client_tx_paused(ClientInfo * client) {
+	std::lock_guard<std::mutex> lock(client->tx_lock);
+	return client->tx_paused;
+}
+
+bool HwioServer::parse_msgs(ClientInfo * client) {
+    if (client->blocked || client->wait)
+        return true;
+    // responses to socket are collected in tx_queue and sent together
+    size_t batched = 0;
     while (client->rx_buffer.curr_len >= sizeof(Hwio_packet_header)) {
-        Hwio_packet_header *header = reinterpret_cast<Hwio_packet_header*>(client->rx_buffer.curr_ptr);
-//         std::cout << "parse_msgs:" << (void*)header << " " << (void*)client->rx_buffer.curr_ptr << " " << client->rx_buffer.curr_len << std::endl;
+        // client does not read responses, continues once they are sent
+        if (client_tx_paused(client))
+            break;
+        Hwio_packet_header header_copy;
+        const Hwio_packet_header *header = reinterpret_cast<Hwio_packet_header*>(
+                client->rx_buffer.peek(sizeof(Hwio_packet_header),
+                        reinterpret_cast<char*>(&header_copy)));
         PProcRes respMeta(true, 0);
         size_t msg_len = sizeof(Hwio_packet_header) + header->body_len;
         if (msg_len <= client->rx_buffer.curr_len) {
-            rx_buffer = client->rx_buffer.curr_ptr + sizeof(Hwio_packet_header);
+            // the message is processed in place unless it wraps around
+            // the end of the buffer
+            if (rx_wrapped.size() < msg_len)
+                rx_wrapped.resize(RxBuffer::RX_BUFFER_SIZE);
+            header = reinterpret_cast<Hwio_packet_header*>(
+                    client->rx_buffer.peek(msg_len, rx_wrapped.data()));
+            rx_buffer = (char*) header + sizeof(Hwio_packet_header);
 //             std::cout << "parse_msgs:" << msg_len << " " <<  (int)header->command << " " << header->body_len << " " << (void*)rx_buffer << std::endl;
+            if (workers.size()) {
+                exec_res_e r = exec_dispatch(client, *header);
+                if (r == EXEC_DISPATCHED) {
+                    client->rx_buffer.consume(msg_len);
+                    continue;
+                } else if (r == EXEC_WAIT) {
+                    // continues in handle_exec_done
+                    if (!client->shm)
+                        client_set_rx(client, false);
+                    break;
+                }
+            }
             respMeta = handle_msg(client, *header);
+            if (workers.size())
+                exec_inline_done();
             if (respMeta.tx_size) {
-                size_t bytesWr = 0;
-                int result;
-                while (bytesWr < respMeta.tx_size) {
-                    result = send(client->fd, tx_buffer + bytesWr, respMeta.tx_size - bytesWr, 0);
-                    if (result < 0) {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-                            continue;
-                        }
-                        respMeta = PProcRes(true, 0);
-                        if (log_level >= logERROR) {
-                            std::cerr
-                                    << "[HWIO, server] Can not send response to client "
-                                    << (client->id) << " (socket=" << (client->fd)
-                                    << ")" << std::endl;
-                            break; 
-                        }
+                // response belongs to the request with same tag
+                reinterpret_cast<Hwio_packet_header*>(tx_buffer)->tag = header->tag;
+                bool sent = true;
+                if (client->shm) {
+                    sent = send_to_client(client, respMeta.tx_size);
+                } else {
+                    queue_to_client(client, respMeta.tx_size);
+                    batched += respMeta.tx_size;
+                    if (batched >= TX_BATCH_SIZE) {
+                        sent = flush_client_tx(client);
+                        batched = 0;
+                    }
+                }
+                if (!sent) {
+                    respMeta = PProcRes(true, 0);
+                    if (log_level >= logERROR) {
+                        std::cerr
+                                << "[HWIO, server] Can not send response to client "
+                                << (client->id) << " (socket=" << (client->fd)
+                                << ")" << std::endl;
                     }
-                    bytesWr += result;
                 }
             }
-            client->rx_buffer.curr_ptr += msg_len;
-            client->rx_buffer.curr_len -= msg_len;
-//             std::cout << "parse_msgs:" << (void*)client->rx_buffer.curr_ptr << " " << client->rx_buffer.curr_len << std::endl;
+            client->rx_buffer.consume(msg_len);
             if (!respMeta.disconnect) {
+                // continues in handle_wait_timer
+                if (client->wait)
+                    break;
                 continue;
             } else {
-                // Somebody disconnected, get his details and print
-                // packet had wrong format or connection was disconnected.
-                if (log_level >= logINFO) {
-                    std::cout << "[INFO] " << "Client " << client->id << " socket:"
-                            << client->fd << " disconnected" << endl;
-
-                    for (auto d : client->devices) {
-                        std::cout << "    owned device:" << endl;
-                        for (auto & s : d->get_spec())
-                            std::cout << "        " << s.to_str() << endl;
-                    }
-                }
-                remove_client(client->fd);
-                removed_poll_fds.push_back(client->fd);
+                // the last response may be an error message
+                if (batched)
+                    flush_client_tx(client);
+                disconnect_client(client);
+                return false;
             }
         }
         // Message is incomplete break the cycle
         break;
     }
+    if (batched && !flush_client_tx(client)) {
+        disconnect_client(client);
+        return false;
+    }
+    rx_release(client);
+    return true;
 }
 
-void HwioServer::handle_multiple_client_requests(int sd) {
-	// else its some IO operation on some other socket
-	//Check if it was for closing , and also read the
-	//incoming message
-	std::map<int, ClientInfo*>::iterator _client = fd_to_client.find(sd);
-	ClientInfo * client = nullptr;
-	if (_client == fd_to_client.end()) {
-		client = add_new_client(sd);
-	} else {
-		client = _client->second;
-	}
-// 	std::cout << "handle_client_requests:" << sd << " " << client->id
-// 			<< std::endl;
-	assert(client->fd == sd);
-	if(read_from_socket(client)) {
-		parse_msgs(client);
-	} else {
-		// Somebody disconnected, get his details and print
-		// packet had wrong format or connection was disconnected.
-		if (log_level >= logINFO) {
-			std::cout << "[INFO] " << "Client " << client->id << " socket:"
-					<< client->fd << " disconnected" << endl;
-
-			for (auto d : client->devices) {
-				std::cout << "    owned device:" << endl;
-				for (auto & s : d->get_spec())
-					std::cout << "        " << s.to_str() << endl;
-			}
+void HwioServer::handle_multiple_client_requests(ClientInfo * client) {
+	// in edge triggered mode the socket has to be read until it is empty
+	do {
+		// continues in handle_exec_done or once responses are sent
+		if (client->blocked || client->wait || client_tx_paused(client))
+			return;
+		ssize_t s = read_from_socket(client);
+		if (s < 0) {
+			disconnect_client(client);
+			return;
 		}
-		remove_client(sd);
-		removed_poll_fds.push_back(sd);
-        }
+		if (s == 0 || !parse_msgs(client))
+			return;
+	} while (edge_triggered);
 }
 
-
 HwioServer::~HwioServer() {
 	if (log_level >= logINFO)
 		std::cout << "[INFO] Hwio server shutting down" << std::endl;
 
+	stop_workers();
+
+	for (auto w : waits)
+		delete w;
 	for (auto & c : clients) {
 		delete c;
 	}
-	if (master_socket >= 0)
+	if (master_socket >= 0) {
 		close(master_socket);
+		if (unix_socket_path.size())
+			unlink(unix_socket_path.c_str());
+	}
+	close(wake_efd);
+	close(wait_timer_fd);
+	close(shm_tx_timer_fd);
+	close(epoll_fd);
 }
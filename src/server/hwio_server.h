@@ -7,15 +7,30 @@
  * and perform read/write operation on them
  *
  * hwio is not thread safe, this server allows multiple client,
- * uses linux select and runs in single thread
+ * uses linux epoll and by default runs in single thread
+ *
+ * optionally (start_workers) the thread which calls pool_client_msgs only
+ * receives the requests and the requests on devices are executed by worker
+ * threads, each device has its own queue of requests, requests on different
+ * devices run in parallel, requests on the same device are executed in order
+ * (requests which access multiple devices and waits are executed by the thread
+ * with poll after the queues of their devices are drained, the queues are held
+ * meanwhile and the client is parked, the thread with poll never waits on them)
+ *
+ * server can listen on TCP (ip:port) or on unix domain socket
+ * (unix:/path/to.sock, see parse_addr) with the same protocol,
+ * clients on unix domain socket can switch to shared memory transport
+ * (HWIO_CMD_SHM_ATTACH, see hwio_shm_ring.h)
  *
  * */
 #include <string.h>   //strlen, strdup
 #include <unistd.h>    //close
 #include <arpa/inet.h> //close
 #include <sys/socket.h>
-#include <sys/poll.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
+#include <sys/un.h>
 #include <sys/time.h>  //FD_SET, FD_ISSET, FD_ZERO macros
 #include <sstream>     // stringstream
 #include <assert.h>
@@ -24,42 +39,217 @@
 #include <type_traits>
 #include <functional>
 #include <vector>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 #include "hwio_remote.h"
+#include "hwio_shm_ring.h"
+#include "hwio_remote_utils.h"
 #include "ihwio_dev.h"
 #include "ihwio_bus.h"
 
 namespace hwio {
 
+/*
+ * Receive buffer of client, ring of RX_BUFFER_SIZE bytes
+ * (the memory is taken from RxBufferPool only while there are unprocessed data)
+ * */
 class RxBuffer {
     friend class HwioServer;
-    private:
+    public:
         static const size_t RX_BUFFER_SIZE = 65536;
-        char buffer[RX_BUFFER_SIZE];
-        char *curr_ptr;
+    private:
+        // nullptr if the buffer is empty and the memory was returned to pool
+        char *buffer;
+        // offset of unprocessed data
+        size_t curr_off;
         size_t curr_len;
     public:
-        RxBuffer() : curr_len(0) {
-            curr_ptr = buffer;
+        RxBuffer() : buffer(nullptr), curr_off(0), curr_len(0) {
+        }
+        /*
+         * Get free space behind the data (max 2 parts because of wrap)
+         * @return number of used items in iov
+         * */
+        int free_space(struct iovec iov[2]) {
+            size_t free_len = RX_BUFFER_SIZE - curr_len;
+            if (free_len == 0)
+                return 0;
+            size_t wr_off = (curr_off + curr_len) % RX_BUFFER_SIZE;
+            size_t first = std::min(free_len, RX_BUFFER_SIZE - wr_off);
+            iov[0].iov_base = buffer + wr_off;
+            iov[0].iov_len = first;
+            if (first == free_len)
+                return 1;
+            iov[1].iov_base = buffer;
+            iov[1].iov_len = free_len - first;
+            return 2;
+        }
+        /*
+         * Get pointer to len bytes of unprocessed data, the data are copied
+         * to tmp only if they wrap around the end of the buffer
+         * */
+        char * peek(size_t len, char * tmp) {
+            size_t first = RX_BUFFER_SIZE - curr_off;
+            if (len <= first)
+                return buffer + curr_off;
+            memcpy(tmp, buffer + curr_off, first);
+            memcpy(tmp + first, buffer, len - first);
+            return tmp;
+        }
+        /*
+         * Mark len bytes of data as processed
+         * */
+        void consume(size_t len) {
+            curr_len -= len;
+            // new data are received in to a single part if possible
+            curr_off = curr_len ? (curr_off + len) % RX_BUFFER_SIZE : 0;
+        }
+        ~RxBuffer() {
+            delete[] buffer;
+        }
+};
+
+/*
+ * Free receive buffers shared by all clients
+ * */
+class RxBufferPool {
+    std::vector<char *> free_buffers;
+    public:
+        // buffers over this limit are deallocated
+        static const size_t MAX_FREE_BUFFERS = 64;
+
+        char * get() {
+            if (free_buffers.empty())
+                return new char[RxBuffer::RX_BUFFER_SIZE];
+            char * b = free_buffers.back();
+            free_buffers.pop_back();
+            return b;
+        }
+        void put(char * b) {
+            if (free_buffers.size() >= MAX_FREE_BUFFERS)
+                delete[] b;
+            else
+                free_buffers.push_back(b);
+        }
+        ~RxBufferPool() {
+            for (auto b: free_buffers)
+                delete[] b;
         }
-        ~RxBuffer() {}
 };
-    
+
+struct HwioServerWait;
+
 class ClientInfo {
 public:
 	int id;
 	int fd;
 	RxBuffer rx_buffer;
 	std::vector<ihwio_dev *> devices;
+	// shared memory transport, if used the socket only signalizes disconnect
+	hwio_shm_channel * shm;
+	// shared memory offered by HWIO_CMD_SHM_ATTACH response which is still
+	// in tx_queue, it is used once the response is sent
+	hwio_shm_channel * shm_offer;
+	// file descriptors of shm_offer were sent with the first part of response
+	bool shm_fds_sent;
+
+	// state of requests executed by worker threads (guarded by exec_lock of server)
+	// number of requests of this client in worker threads
+	unsigned pending;
+	// processing of requests is stopped until pending requests are completed
+	bool blocked;
+	// client disconnected but some requests are still in worker threads
+	bool closing;
+	// worker thread requested disconnect of client (error in request)
+	bool disconnect_req;
+	// responses are sent under this lock (guards also the tx_* members,
+	// rx_enabled and epoll_events)
+	std::mutex tx_lock;
+	// responses which could not be sent yet because socket (or response ring
+	// of shared memory) was full
+	std::vector<char> tx_queue;
+	// start of unsent data in tx_queue
+	size_t tx_queue_head;
+	// tx_queue is over the high-water mark (or it is not empty
+	// for shared memory), requests are not read
+	bool tx_paused;
+	// requests can be read (cleared while client waits on worker threads)
+	bool rx_enabled;
+	// events of socket currently registered in epoll
+	uint32_t epoll_events;
+	// HWIO_CMD_WAIT_UNTIL request polled by server, next requests
+	// of client are processed once it completes
+	HwioServerWait * wait;
+	// devices held for the request of client which waits until their queues
+	// are drained (guarded by exec_lock, empty if client is not parked)
+	std::vector<ihwio_dev *> parked_devs;
+
 	ClientInfo(int id, int _socket) :
-			id(id), fd(_socket), devices() {
+			id(id), fd(_socket), devices(), shm(nullptr), shm_offer(nullptr), shm_fds_sent(
+					false), pending(0), blocked(
+					false), closing(false), disconnect_req(false), tx_queue_head(
+					0), tx_paused(false), rx_enabled(true), epoll_events(
+					EPOLLIN), wait(nullptr) {
+	}
+	size_t tx_queued() const {
+		return tx_queue.size() - tx_queue_head;
 	}
 	~ClientInfo() {
+		delete shm;
+		delete shm_offer;
 		if (fd >= 0)
 			close(fd);
 	}
 };
 
+/*
+ * Request executed by worker thread of server
+ * */
+struct HwioServerJob {
+	ClientInfo * client;
+	Hwio_packet_header header;
+	std::vector<char> body;
+};
+
+/*
+ * HWIO_CMD_WAIT_UNTIL request which is polled by server
+ * (times are CLOCK_MONOTONIC in ns)
+ * */
+struct HwioServerWait {
+	ClientInfo * client;
+	ihwio_dev * dev;
+	uint16_t tag;
+	WaitReq req;
+	uint64_t deadline;
+	uint64_t next_check;
+	// period of checks, prolonged after each unsuccessful check
+	uint64_t interval;
+	// queue of device is held until the register is checked
+	// (device was busy in worker thread)
+	bool held;
+};
+
+/*
+ * Queue of requests on single device, at most one worker thread
+ * executes requests from the queue at the time
+ * */
+struct HwioDevQueue {
+	std::deque<HwioServerJob *> jobs;
+	// queue is in ready queue of server or its request is being executed
+	bool scheduled;
+	// number of requests executed by the thread with poll which wait on this
+	// queue, held queue is not scheduled again until it is released
+	unsigned holds;
+	HwioDevQueue() :
+			scheduled(false), holds(0) {
+	}
+};
+
 class HwioServer {
 private:
 	/**
@@ -76,15 +266,68 @@ private:
 	struct addrinfo * addr;
 	// socket for accepting clients
 	int master_socket;
+	// path of master socket if it is unix domain socket
+	std::string unix_socket_path;
 
-	// buffers for rx/tx
+	// buffers for rx/tx (per thread because of worker threads)
 	//char rx_buffer[BUFFER_SIZE];
-	char* rx_buffer;
-	char tx_buffer[BUFFER_SIZE];
+	static thread_local char* rx_buffer;
+	static thread_local char tx_buffer[BUFFER_SIZE];
+	// memory for rx_buffer of clients
+	RxBufferPool rx_pool;
+	// copy of request which wraps around the end of RxBuffer
+	std::vector<char> rx_wrapped;
+
+	// kind of file descriptor registered in epoll
+	enum fd_kind_e {
+		FD_NONE = 0,
+		// master_socket
+		FD_MASTER,
+		// socket of client
+		FD_CLIENT,
+		// eventfd of request ring of client with shared memory transport
+		FD_SHM,
+		// wake_efd
+		FD_WAKE,
+		// wait_timer_fd
+		FD_WAIT_TIMER,
+		// shm_tx_timer_fd
+		FD_SHM_TX_TIMER,
+	};
+	struct fd_info_t {
+		fd_kind_e kind;
+		ClientInfo * client;
+	};
+	int epoll_fd;
+	// information about file descriptors in epoll indexed by file descriptor
+	std::vector<fd_info_t> fd_table;
+	// eventfd used to wake up the thread in pool_client_msgs
+	// (requests in worker threads completed or wakeup() called)
+	int wake_efd;
+	// timerfd for polling of registers of HWIO_CMD_WAIT_UNTIL requests
+	int wait_timer_fd;
+	// HWIO_CMD_WAIT_UNTIL requests polled by server
+	std::vector<HwioServerWait *> waits;
+	// timerfd for retry of responses queued because the response ring
+	// of shared memory was full
+	int shm_tx_timer_fd;
 
-	std::vector<struct pollfd> poll_fds;
-	std::vector<int> removed_poll_fds;
-	std::map<int, ClientInfo*> fd_to_client;
+	// worker threads which execute requests on devices
+	// (empty if requests are executed by the thread which calls pool_client_msgs)
+	std::vector<std::thread> workers;
+	// guards all exec_* members, dev_queues and the worker state of clients
+	std::mutex exec_lock;
+	std::condition_variable exec_cv;
+	bool exec_stop;
+	std::map<ihwio_dev *, HwioDevQueue> dev_queues;
+	// queues with requests which are not executed by any worker thread
+	std::deque<HwioDevQueue *> exec_ready;
+	// blocked/closing clients without pending requests
+	std::vector<ClientInfo *> exec_done_clients;
+	// clients which wait until the queues of their parked_devs are drained
+	std::vector<ClientInfo *> exec_parked;
+	// devices held for the request executed by the thread with poll
+	std::vector<ihwio_dev *> exec_inline_devs;
 
 	// meta-informations about clients in server
 	// some items may be nullptr if client has disconnected
@@ -124,6 +367,116 @@ private:
 	 * */
 	PProcRes handle_write(ClientInfo * client, Hwio_packet_header header);
 
+	/*
+	 * HWIO hw read of multiple items by read multiple message
+	 * @return PProcRes with size of tx data in tx_buffer and disconnect flag
+	 * */
+	PProcRes handle_read_multiple(ClientInfo * client, Hwio_packet_header header);
+
+	/*
+	 * HWIO hw write of multiple items by write multiple message
+	 * @return PProcRes with size of tx data in tx_buffer and disconnect flag
+	 * */
+	PProcRes handle_write_multiple(ClientInfo * client, Hwio_packet_header header);
+
+	/*
+	 * HWIO hw repeated read from single address by read keyhole message
+	 * @return PProcRes with size of tx data in tx_buffer and disconnect flag
+	 * */
+	PProcRes handle_read_keyhole(ClientInfo * client, Hwio_packet_header header);
+
+	/*
+	 * HWIO hw repeated write to single address by write keyhole message
+	 * @return PProcRes with size of tx data in tx_buffer and disconnect flag
+	 * */
+	PProcRes handle_write_keyhole(ClientInfo * client, Hwio_packet_header header);
+
+	/*
+	 * HWIO hw fill of memory with pattern by fill message
+	 * @return PProcRes with size of tx data in tx_buffer and disconnect flag
+	 * */
+	PProcRes handle_fill(ClientInfo * client, Hwio_packet_header header);
+
+	/*
+	 * HWIO hw read-modify-write of register by rmw message
+	 * (the response contains the original value of register)
+	 * @return PProcRes with size of tx data in tx_buffer and disconnect flag
+	 * */
+	PProcRes handle_rmw(ClientInfo * client, Hwio_packet_header header);
+
+	/*
+	 * HWIO hw reads, writes and fills executed as hwio_batch by batch message
+	 * @return PProcRes with size of tx data in tx_buffer and disconnect flag
+	 * */
+	PProcRes handle_batch(ClientInfo * client, Hwio_packet_header header);
+
+	/*
+	 * HWIO hw execute register micro-program by program message
+	 * (polls of the program block the thread which executes it)
+	 * @return PProcRes with size of tx data in tx_buffer and disconnect flag
+	 * */
+	PProcRes handle_program(ClientInfo * client, Hwio_packet_header header);
+
+	/*
+	 * HWIO hw wait until register has expected value by wait until message,
+	 * if the condition is not met immediately the register is polled
+	 * in handle_wait_timer and the response is sent from there
+	 * @return PProcRes with size of tx data in tx_buffer and disconnect flag
+	 * */
+	PProcRes handle_wait_until(ClientInfo * client, Hwio_packet_header header);
+	/*
+	 * Build HWIO_CMD_WAIT_UNTIL_RESP in tx_buffer
+	 * @return size of response
+	 * */
+	size_t wait_resp(bool done, uint32_t value);
+	/*
+	 * Check registers of waits which are due, send responses for completed
+	 * ones and continue with next requests of their clients
+	 * (check of register on device busy in worker thread is postponed
+	 * and the queue of device is held until then)
+	 * */
+	void handle_wait_timer();
+	/*
+	 * Set wait_timer_fd to the time of the nearest check of register
+	 * */
+	void wait_arm_timer();
+	/*
+	 * Drop the wait of removed client
+	 * */
+	void wait_remove(ClientInfo * client);
+
+	/*
+	 * Create shared memory transport for client and queue the response with
+	 * its file descriptors to tx_queue of client (the transport is used once
+	 * the response is sent, see flush_client_tx)
+	 * @return PProcRes with size of tx data in tx_buffer and disconnect flag
+	 * */
+	PProcRes handle_shm_attach(ClientInfo * client, Hwio_packet_header header);
+	/*
+	 * Send data with the file descriptors of shm_offer of client
+	 * @return result of sendmsg
+	 * */
+	ssize_t send_shm_fds(ClientInfo * client, const char * data, size_t size);
+	/*
+	 * Switch client to shm_offer once the response with it is sent
+	 * */
+	void shm_offer_accepted(ClientInfo * client);
+	/*
+	 * Move responses from tx_queue of client to its response ring
+	 * (tx_lock of client has to be held)
+	 * */
+	void flush_shm_tx(ClientInfo * client);
+	/*
+	 * Schedule retry of responses queued for clients with shared memory
+	 * (can be called from any thread)
+	 * */
+	void shm_tx_arm_timer();
+	/*
+	 * Retry responses queued for clients with shared memory and continue
+	 * with requests of clients whose responses were all sent
+	 * */
+	void handle_shm_tx_timer();
+
 	/**
 	 * HWIO remote call of plugin function
 	 */
@@ -150,18 +503,164 @@ private:
 	 **/
 	ClientInfo * add_new_client(int socket);
 	void remove_client(int socket);
+	/*
+	 * Log the disconnect of client and remove it
+	 * */
+	void disconnect_client(ClientInfo * client);
+	/*
+	 * Accept all pending connections on master socket
+	 * */
+	void accept_clients();
 
-	void handle_client_requests(int client_fd);
+	/*
+	 * Register file descriptor in epoll and fd_table
+	 * */
+	void epoll_add(int fd, fd_kind_e kind, ClientInfo * client);
+	void epoll_del(int fd);
+	void epoll_set_events(int fd, uint32_t events);
 
-	bool read_from_socket(ClientInfo * client);
-	void parse_msgs(ClientInfo * client);
-	void handle_multiple_client_requests(int client_fd);
+	/*
+	 * Receive available data from client socket to rx_buffer of client
+	 * @return number of received bytes, 0 if there are no data and
+	 * 		-1 if the client disconnected
+	 * */
+	ssize_t read_from_socket(ClientInfo * client);
+	/*
+	 * Copy data from request ring of shared memory to rx_buffer of client
+	 * @return true if some data was copied
+	 * */
+	bool read_from_shm(ClientInfo * client);
+	/*
+	 * Take memory for rx_buffer of client from pool if it does not have any
+	 * */
+	void rx_acquire(ClientInfo * client);
+	/*
+	 * Return memory of rx_buffer of client to pool if there are no data
+	 * */
+	void rx_release(ClientInfo * client);
+	/*
+	 * Process all complete messages in rx_buffer of client
+	 * @return false if the client was disconnected (and removed)
+	 * */
+	bool parse_msgs(ClientInfo * client);
+	/*
+	 * Send tx_size bytes from tx_buffer to client (over socket or shared memory)
+	 * @return false on error
+	 * */
+	bool send_to_client(ClientInfo * client, size_t tx_size);
+	/*
+	 * Write tx_size bytes from tx_buffer to response ring of client, the part
+	 * which does not fit is queued (tx_lock of client has to be held)
+	 * */
+	void send_to_shm(ClientInfo * client, size_t tx_size);
+	/*
+	 * Append response from tx_buffer to tx_queue of client without sending it
+	 * (used to send responses for multiple requests in a single syscall)
+	 * */
+	void queue_to_client(ClientInfo * client, size_t tx_size);
+	/*
+	 * Send data from tx_queue of client until socket is full
+	 * @return false on error
+	 * */
+	bool flush_client_tx(ClientInfo * client);
+	/*
+	 * Update epoll events of client socket from the state of tx_queue
+	 * and rx_enabled (tx_lock of client has to be held)
+	 * */
+	void client_update_events(ClientInfo * client);
+	/*
+	 * Enable/disable reading of requests from client
+	 * */
+	void client_set_rx(ClientInfo * client, bool enable);
+	/*
+	 * @return true if reading of requests is paused because of unsent responses
+	 * */
+	bool client_tx_paused(ClientInfo * client);
+	void handle_multiple_client_requests(ClientInfo * client);
+	/*
+	 * Process requests from shared memory of client, spin for a while
+	 * for next requests before the server returns to poll (requests are not
+	 * read while the responses do not fit in to the response ring)
+	 * */
+	void handle_shm_client_requests(ClientInfo * client);
 
 	static constexpr unsigned MAX_PENDING_CONNECTIONS = 32;
 	static constexpr unsigned POLL_TIMEOUT_MS = 100;
+	static constexpr unsigned MAX_EPOLL_EVENTS = 64;
+	// max number of reads from shared memory of one client before
+	// other clients are served
+	static constexpr unsigned SHM_MAX_READS_PER_POLL = 64;
+	// period of retries of responses which did not fit in to the response
+	// ring of client (client does not notify server when it reads the ring)
+	static constexpr uint64_t SHM_TX_RETRY_NS = 50000;
+	// responses collected from one read of socket are sent when they reach
+	// this size
+	static constexpr size_t TX_BATCH_SIZE = 64 * 1024;
+	// period of checks of register of HWIO_CMD_WAIT_UNTIL, the period starts
+	// on min and it is doubled after each unsuccessful check up to max
+	static constexpr uint64_t WAIT_MIN_POLL_NS = 10000;
+	static constexpr uint64_t WAIT_MAX_POLL_NS = 1000000;
 
 	static ihwio_dev * client_get_dev(ClientInfo * client, dev_id_t devId);
 
+	enum exec_res_e {
+		// request was passed to worker thread
+		EXEC_DISPATCHED,
+		// request has to be executed by the thread with poll
+		EXEC_INLINE,
+		// requests of client in worker threads has to be completed first
+		EXEC_WAIT,
+	};
+	/*
+	 * @return device which is accessed by request or nullptr
+	 * 	if request is not related to a single device
+	 * */
+	ihwio_dev * request_device(ClientInfo * client,
+			const Hwio_packet_header & header);
+	/*
+	 * Add all devices accessed by request to devs
+	 * */
+	void request_devices(ClientInfo * client,
+			const Hwio_packet_header & header, std::vector<ihwio_dev *> & devs);
+	/*
+	 * @return true if none of requests on devices is being executed
+	 * 		by worker thread (exec_lock has to be locked)
+	 *
+	 * New requests are dispatched only by the thread with poll, so devices
+	 * stay idle until it dispatches next request.
+	 * */
+	bool exec_devs_idle(const std::vector<ihwio_dev *> & devs);
+	/*
+	 * Hold/release queues of devices (exec_lock has to be locked),
+	 * held queue is not scheduled to worker threads after its current request
+	 * */
+	void exec_hold(const std::vector<ihwio_dev *> & devs);
+	void exec_release(const std::vector<ihwio_dev *> & devs);
+	/*
+	 * Pass parked clients whose devices are idle to handle_exec_done
+	 * (exec_lock has to be locked)
+	 * */
+	void exec_check_parked();
+	/*
+	 * Release devices held for the request executed by the thread with poll
+	 * */
+	void exec_inline_done();
+	/*
+	 * Pass request from rx_buffer to the queue of its device
+	 * */
+	exec_res_e exec_dispatch(ClientInfo * client,
+			const Hwio_packet_header & header);
+	/*
+	 * Main loop of worker thread
+	 * */
+	void exec_worker();
+	void exec_job(HwioServerJob * job);
+	/*
+	 * Continue processing of clients which were waiting on worker threads
+	 * */
+	void handle_exec_done();
+	void stop_workers();
+
 public:
 	static const char * DEFAULT_ADDR;
 	struct timespec client_timeout;
@@ -169,6 +668,21 @@ public:
 	enum loglevel_e {logERROR=0, logWARNING=1, logINFO=2, logDEBUG=3};
 
 	enum loglevel_e log_level;
+	// use edge triggered epoll (has to be set before prepare_server_socket)
+	bool edge_triggered;
+	// if client has more unsent data than this, requests from it are not read
+	// until the half of data is sent
+	size_t tx_high_water;
+	static const size_t DEFAULT_TX_HIGH_WATER;
+	// profile of socket options of client connections
+	hwio_latency_e latency;
+	// limit of the total time of polls of single HWIO_CMD_PROGRAM [us],
+	// programs with larger sum of poll timeouts are rejected and polls
+	// repeated in loops time out when the limit is reached
+	// (without worker threads the program blocks the thread with poll,
+	// the default is short, longer waits should use HWIO_CMD_WAIT_UNTIL)
+	uint64_t program_max_poll_time;
+	static const uint64_t DEFAULT_PROGRAM_MAX_POLL_TIME;
 	std::vector<ihwio_bus *> buses;
 
 	using plugin_fn_t = std::function<void (ihwio_dev*, void *, void *)> ;
@@ -183,14 +697,84 @@ public:
 	HwioServer(struct addrinfo * addr, std::vector<ihwio_bus *> buses);
 	void prepare_server_socket();
 
+	/*
+	 * Execute requests on devices in worker threads
+	 * (has to be called before the clients are connected)
+	 *
+	 * @param thread_cnt number of worker threads
+	 * */
+	void start_workers(size_t thread_cnt);
+
 	/**
 	 * pool once over all sockets and handle messages
+	 * (waits at most client_timeout)
 	 *
 	 * @attention has to be called in cycle in order to have server running
 	 */
 	void pool_client_msgs();
+	/**
+	 * @param timeout_ms max time to wait for event, -1 to wait until
+	 * 		some event or wakeup()
+	 */
+	void pool_client_msgs(int timeout_ms);
+	/**
+	 * Interrupt waiting in pool_client_msgs (can be called from other thread)
+	 */
+	void wakeup();
 	size_t get_client_cnt();
 
+	// settings of busy poll mode
+	struct busy_poll_cfg_t {
+		// cpu where the thread of server loop is pinned, -1 = no pinning
+		int cpu;
+		// SO_BUSY_POLL of client sockets [us], 0 = not set
+		int socket_busy_poll_us;
+		// SCHED_FIFO priority of the thread of server loop, 0 = not changed
+		int fifo_priority;
+		busy_poll_cfg_t();
+	};
+	// time spent in pool_client_msgs in busy poll mode
+	struct busy_poll_stats_t {
+		// spinning without any event [ns]
+		uint64_t spin_ns;
+		// processing of events [ns]
+		uint64_t busy_ns;
+		// number of epoll_wait calls
+		uint64_t polls;
+		// number of epoll_wait calls without any event
+		uint64_t empty_polls;
+	};
+	/**
+	 * Switch pool_client_msgs to busy poll mode (epoll with zero timeout
+	 * in cycle) for lower latency at the cost of a fully used cpu
+	 *
+	 * @attention the cpu pinning and scheduling policy are applied to
+	 * 		the calling thread, it has to be the thread which calls pool_client_msgs
+	 * @throw std::runtime_error if pinning or scheduling policy can not be set
+	 */
+	void enable_busy_poll(const busy_poll_cfg_t & cfg = busy_poll_cfg_t());
+	busy_poll_stats_t get_busy_poll_stats();
+
+private:
+	// pool_client_msgs spins instead of sleeping in epoll_wait
+	bool busy_poll;
+	busy_poll_cfg_t busy_poll_cfg;
+	struct {
+		std::atomic<uint64_t> spin_ns;
+		std::atomic<uint64_t> busy_ns;
+		std::atomic<uint64_t> polls;
+		std::atomic<uint64_t> empty_polls;
+	} busy_poll_stats;
+	/*
+	 * Apply SO_BUSY_POLL from busy_poll_cfg to the socket of client
+	 * */
+	void set_socket_busy_poll(int fd);
+	/*
+	 * epoll_wait with zero timeout in cycle until some event or timeout
+	 * */
+	int busy_poll_wait(struct epoll_event * events, int timeout_ms);
+
+public:
 	// [TODO] plugin function should be restricted to device class by spec
 	template <typename ARGS_T, typename RET_T>
 	void install_plugin_fn(const std::string & name, void (*plugin_fn)(ihwio_dev* dev, ARGS_T * args, RET_T * ret)) {
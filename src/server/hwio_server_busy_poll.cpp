@@ -0,0 +1,83 @@
+#include "hwio_server.h"
+
+#include <chrono>
+#include <pthread.h>
+#include <sched.h>
+
+using namespace std;
+using namespace hwio;
+
+HwioServer::busy_poll_cfg_t::busy_poll_cfg_t() :
+		cpu(-1), socket_busy_poll_us(0), fifo_priority(0) {
+}
+
+void HwioServer::enable_busy_poll(const busy_poll_cfg_t & cfg) {
+	if (cfg.cpu >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cfg.cpu, &cpus);
+		int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if (err)
+			throw std::runtime_error(
+					std::string("[HWIO, server] Can not pin server to cpu ")
+							+ std::to_string(cfg.cpu) + ": " + strerror(err));
+	}
+	if (cfg.fifo_priority > 0) {
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = cfg.fifo_priority;
+		int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if (err)
+			throw std::runtime_error(
+					std::string("[HWIO, server] Can not set SCHED_FIFO: ")
+							+ strerror(err));
+	}
+	busy_poll_cfg = cfg;
+	busy_poll = true;
+	for (auto c : clients) {
+		if (c && !c->closing)
+			set_socket_busy_poll(c->fd);
+	}
+}
+
+void HwioServer::set_socket_busy_poll(int fd) {
+	if (!busy_poll || busy_poll_cfg.socket_busy_poll_us <= 0)
+		return;
+	int us = busy_poll_cfg.socket_busy_poll_us;
+	if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) < 0
+			&& log_level >= logWARNING)
+		LOG_ERR << "Can not set SO_BUSY_POLL on socket " << fd << ": "
+				<< strerror(errno) << std::endl;
+}
+
+int HwioServer::busy_poll_wait(struct epoll_event * events, int timeout_ms) {
+	auto start = std::chrono::steady_clock::now();
+	auto deadline = start + std::chrono::milliseconds(timeout_ms);
+	uint64_t polls = 0;
+	int cnt;
+	while (true) {
+		cnt = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, 0);
+		polls++;
+		if (cnt != 0)
+			break;
+		if (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline)
+			break;
+	}
+	auto spin = std::chrono::steady_clock::now() - start;
+	busy_poll_stats.spin_ns.fetch_add(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(spin).count(),
+			std::memory_order_relaxed);
+	busy_poll_stats.polls.fetch_add(polls, std::memory_order_relaxed);
+	busy_poll_stats.empty_polls.fetch_add(cnt != 0 ? polls - 1 : polls,
+			std::memory_order_relaxed);
+	return cnt;
+}
+
+HwioServer::busy_poll_stats_t HwioServer::get_busy_poll_stats() {
+	busy_poll_stats_t s;
+	s.spin_ns = busy_poll_stats.spin_ns.load(std::memory_order_relaxed);
+	s.busy_ns = busy_poll_stats.busy_ns.load(std::memory_order_relaxed);
+	s.polls = busy_poll_stats.polls.load(std::memory_order_relaxed);
+	s.empty_polls = busy_poll_stats.empty_polls.load(std::memory_order_relaxed);
+	return s;
+}
@@ -0,0 +1,317 @@
+#include "hwio_server.h"
+
+#include <algorithm>
+#include <sys/eventfd.h>
+
+using namespace std;
+using namespace hwio;
+
+void HwioServer::start_workers(size_t thread_cnt) {
+	if (workers.size())
+		throw std::runtime_error("[HWIO, server] workers already started");
+	if (thread_cnt == 0)
+		return;
+
+	exec_stop = false;
+	for (size_t i = 0; i < thread_cnt; i++)
+		workers.push_back(std::thread(&HwioServer::exec_worker, this));
+}
+
+ihwio_dev * HwioServer::request_device(ClientInfo * client,
+		const Hwio_packet_header & header) {
+	switch (header.command) {
+	case HWIO_CMD_READ:
+	case HWIO_CMD_WRITE:
+	case HWIO_CMD_READ_KEYHOLE:
+	case HWIO_CMD_WRITE_KEYHOLE:
+	case HWIO_CMD_FILL:
+	case HWIO_CMD_RMW:
+	case HWIO_CMD_PROGRAM:
+	case HWIO_CMD_BATCH:
+	case HWIO_CMD_REMOTE_CALL:
+	case HWIO_CMD_REMOTE_CALL_FAST:
+		// all these requests start with id of device
+		if (header.body_len < sizeof(dev_id_t))
+			return nullptr;
+		return client_get_dev(client,
+				*reinterpret_cast<const dev_id_t*>(rx_buffer));
+
+	case HWIO_CMD_READ_MULTIPLE:
+	case HWIO_CMD_WRITE_MULTIPLE: {
+		// only if all items are for the same device
+		ihwio_dev * dev = nullptr;
+		size_t offset = 0;
+		while (offset + sizeof(RdReqMulti) <= header.body_len) {
+			auto item = reinterpret_cast<const RdReqMulti*>(rx_buffer + offset);
+			ihwio_dev * d = client_get_dev(client, item->devId);
+			if (d == nullptr || (dev != nullptr && d != dev))
+				return nullptr;
+			dev = d;
+			offset += sizeof(RdReqMulti);
+			if (header.command == HWIO_CMD_WRITE_MULTIPLE)
+				offset += item->size;
+		}
+		return dev;
+	}
+	default:
+		return nullptr;
+	}
+}
+
+void HwioServer::request_devices(ClientInfo * client,
+		const Hwio_packet_header & header, std::vector<ihwio_dev *> & devs) {
+	switch (header.command) {
+	case HWIO_CMD_READ_MULTIPLE:
+	case HWIO_CMD_WRITE_MULTIPLE: {
+		size_t offset = 0;
+		while (offset + sizeof(RdReqMulti) <= header.body_len) {
+			auto item = reinterpret_cast<const RdReqMulti*>(rx_buffer + offset);
+			ihwio_dev * d = client_get_dev(client, item->devId);
+			if (d != nullptr
+					&& std::find(devs.begin(), devs.end(), d) == devs.end())
+				devs.push_back(d);
+			offset += sizeof(RdReqMulti);
+			if (header.command == HWIO_CMD_WRITE_MULTIPLE)
+				offset += item->size;
+		}
+		break;
+	}
+	case HWIO_CMD_WAIT_UNTIL: {
+		if (header.body_len < sizeof(dev_id_t))
+			break;
+		ihwio_dev * d = client_get_dev(client,
+				*reinterpret_cast<const dev_id_t*>(rx_buffer));
+		if (d != nullptr)
+			devs.push_back(d);
+		break;
+	}
+	default: {
+		ihwio_dev * d = request_device(client, header);
+		if (d != nullptr)
+			devs.push_back(d);
+	}
+	}
+}
+
+bool HwioServer::exec_devs_idle(const std::vector<ihwio_dev *> & devs) {
+	for (auto d : devs) {
+		auto q = dev_queues.find(d);
+		if (q != dev_queues.end() && q->second.scheduled)
+			return false;
+	}
+	return true;
+}
+
+void HwioServer::exec_hold(const std::vector<ihwio_dev *> & devs) {
+	for (auto d : devs)
+		dev_queues[d].holds++;
+}
+
+void HwioServer::exec_release(const std::vector<ihwio_dev *> & devs) {
+	for (auto d : devs) {
+		HwioDevQueue & q = dev_queues[d];
+		assert(q.holds > 0);
+		q.holds--;
+		// requests received while the queue was held
+		if (q.holds == 0 && q.jobs.size() && !q.scheduled) {
+			q.scheduled = true;
+			exec_ready.push_back(&q);
+			exec_cv.notify_one();
+		}
+	}
+}
+
+void HwioServer::exec_check_parked() {
+	for (auto it = exec_parked.begin(); it != exec_parked.end();) {
+		ClientInfo * client = *it;
+		if (!exec_devs_idle(client->parked_devs)) {
+			++it;
+			continue;
+		}
+		// request is dispatched again from handle_exec_done
+		it = exec_parked.erase(it);
+		exec_done_clients.push_back(client);
+		eventfd_write(wake_efd, 1);
+	}
+}
+
+void HwioServer::exec_inline_done() {
+	if (exec_inline_devs.empty())
+		return;
+	std::lock_guard<std::mutex> lock(exec_lock);
+	exec_release(exec_inline_devs);
+	exec_inline_devs.clear();
+}
+
+HwioServer::exec_res_e HwioServer::exec_dispatch(ClientInfo * client,
+		const Hwio_packet_header & header) {
+	ihwio_dev * dev = request_device(client, header);
+
+	std::unique_lock<std::mutex> lock(exec_lock);
+	if (client->disconnect_req) {
+		// client is removed in handle_exec_done
+		client->blocked = true;
+		return EXEC_WAIT;
+	}
+	if (dev == nullptr) {
+		// the request can change the state of client (e.g. device query)
+		// requests in worker threads have to be completed first
+		if (client->pending) {
+			client->blocked = true;
+			return EXEC_WAIT;
+		}
+		// the request may access multiple devices (or wait on a device),
+		// requests of other clients on them have to be completed first
+		// to keep requests on each device serialized
+		if (client->parked_devs.empty()) {
+			request_devices(client, header, client->parked_devs);
+			exec_hold(client->parked_devs);
+		}
+		if (!exec_devs_idle(client->parked_devs)) {
+			// continues in handle_exec_done once the devices are idle
+			if (std::find(exec_parked.begin(), exec_parked.end(), client)
+					== exec_parked.end())
+				exec_parked.push_back(client);
+			client->blocked = true;
+			return EXEC_WAIT;
+		}
+		// devices stay held until the request is executed (exec_inline_done)
+		assert(exec_inline_devs.empty());
+		exec_inline_devs.swap(client->parked_devs);
+		return EXEC_INLINE;
+	}
+
+	auto job = new HwioServerJob;
+	job->client = client;
+	job->header = header;
+	job->body.assign(rx_buffer, rx_buffer + header.body_len);
+	client->pending++;
+
+	HwioDevQueue & q = dev_queues[dev];
+	q.jobs.push_back(job);
+	if (!q.scheduled) {
+		q.scheduled = true;
+		exec_ready.push_back(&q);
+		exec_cv.notify_one();
+	}
+	return EXEC_DISPATCHED;
+}
+
+void HwioServer::exec_worker() {
+	std::unique_lock<std::mutex> lock(exec_lock);
+	while (true) {
+		exec_cv.wait(lock, [this] {
+			return exec_stop || exec_ready.size();
+		});
+		if (exec_stop)
+			return;
+
+		HwioDevQueue * q = exec_ready.front();
+		exec_ready.pop_front();
+		HwioServerJob * job = q->jobs.front();
+		q->jobs.pop_front();
+
+		lock.unlock();
+		exec_job(job);
+		lock.lock();
+
+		// other devices are served before next request on this device
+		if (q->jobs.size() && q->holds == 0) {
+			exec_ready.push_back(q);
+		} else {
+			q->scheduled = false;
+			if (q->holds)
+				exec_check_parked();
+		}
+
+		ClientInfo * client = job->client;
+		delete job;
+		client->pending--;
+		if (client->pending == 0
+				&& (client->blocked || client->closing
+						|| client->disconnect_req)) {
+			exec_done_clients.push_back(client);
+			eventfd_write(wake_efd, 1);
+		}
+	}
+}
+
+void HwioServer::exec_job(HwioServerJob * job) {
+	ClientInfo * client = job->client;
+	PProcRes respMeta(true, 0);
+	rx_buffer = job->body.data();
+	try {
+		respMeta = handle_msg(client, job->header);
+		if (respMeta.tx_size) {
+			// response belongs to the request with same tag
+			reinterpret_cast<Hwio_packet_header*>(tx_buffer)->tag =
+					job->header.tag;
+			if (!send_to_client(client, respMeta.tx_size))
+				respMeta.disconnect = true;
+		}
+	} catch (const std::exception & err) {
+		if (log_level >= logERROR)
+			LOG_ERR << "Request of client " << client->id << " failed: "
+					<< err.what() << std::endl;
+		respMeta.disconnect = true;
+	}
+	if (respMeta.disconnect) {
+		std::lock_guard<std::mutex> lock(exec_lock);
+		client->disconnect_req = true;
+	}
+}
+
+void HwioServer::handle_exec_done() {
+	eventfd_t v;
+	eventfd_read(wake_efd, &v);
+
+	std::vector<ClientInfo *> done;
+	{
+		std::lock_guard<std::mutex> lock(exec_lock);
+		done.swap(exec_done_clients);
+		for (auto c : done)
+			c->blocked = false;
+	}
+
+	for (auto client : done) {
+		if (client->closing || client->disconnect_req) {
+			disconnect_client(client);
+		} else if (client->shm) {
+			handle_shm_client_requests(client);
+		} else {
+			// in edge triggered mode the modification also reports
+			// the data which are already in socket
+			client_set_rx(client, true);
+			parse_msgs(client);
+		}
+	}
+}
+
+void HwioServer::stop_workers() {
+	if (workers.size() == 0)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(exec_lock);
+		exec_stop = true;
+	}
+	exec_cv.notify_all();
+	for (auto & w : workers)
+		w.join();
+	workers.clear();
+
+	// requests which were not executed
+	for (auto & q : dev_queues) {
+		for (auto job : q.second.jobs) {
+			job->client->pending--;
+			delete job;
+		}
+		q.second.jobs.clear();
+	}
+	dev_queues.clear();
+	exec_ready.clear();
+	exec_done_clients.clear();
+	for (auto c : exec_parked)
+		c->parked_devs.clear();
+	exec_parked.clear();
+	exec_inline_devs.clear();
+}
@@ -0,0 +1,54 @@
+#include "hwio_server.h"
+
+using namespace std;
+using namespace hwio;
+
+HwioServer::PProcRes HwioServer::handle_program(ClientInfo * client,
+		Hwio_packet_header header) {
+	if (header.body_len < sizeof(ProgramReq))
+		return send_err(MALFORMED_PACKET, "PROGRAM: size too small");
+
+	auto req = reinterpret_cast<const ProgramReq*>(rx_buffer);
+	if (header.body_len
+			!= sizeof(ProgramReq) + req->insn_cnt * sizeof(hwio_program_insn))
+		return send_err(MALFORMED_PACKET, "PROGRAM: wrong size of packet");
+
+	ihwio_dev * dev = client_get_dev(client, req->devId);
+	if (!dev)
+		return send_err(ACCESS_DENIED, "PROGRAM: device is not allocated");
+
+	try {
+		hwio_program::check(req->insns, req->insn_cnt, req->slot_cnt);
+	} catch (const std::invalid_argument & err) {
+		return send_err(MALFORMED_PACKET,
+				std::string("PROGRAM: ") + err.what());
+	}
+	// polls block the thread which executes the program
+	if (hwio_program::poll_time(req->insns, req->insn_cnt)
+			> program_max_poll_time)
+		return send_err(ACCESS_DENIED,
+				"PROGRAM: total timeout of polls exceeds the limit of server");
+
+	if (log_level >= logDEBUG) {
+		std::cout << "[DEBUG] PROGRAM: client:" << client->id << ", dev:"
+				<< (int) req->devId << " instructions:" << req->insn_cnt
+				<< " slots:" << (int) req->slot_cnt << endl;
+	}
+
+	auto resp = reinterpret_cast<HwioFrame<ProgramResp>*>(tx_buffer);
+	resp->header.command = HWIO_CMD_PROGRAM_RESP;
+	resp->header.body_len = sizeof(ProgramResp)
+			+ req->slot_cnt * sizeof(uint32_t);
+	uint32_t slots[hwio_program::MAX_SLOTS] = { 0 };
+	size_t pc;
+	try {
+		resp->body.status = hwio_program::exec(dev, req->insns, req->insn_cnt,
+				slots, pc, program_max_poll_time);
+	} catch (std::runtime_error & err) {
+		return send_err(IO_ERROR,
+				std::string("Program failed on device: ") + err.what());
+	}
+	resp->body.pc = pc;
+	memcpy(resp->body.slots, slots, req->slot_cnt * sizeof(uint32_t));
+	return PProcRes(false, sizeof(resp->header) + resp->header.body_len);
+}
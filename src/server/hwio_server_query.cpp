@@ -37,9 +37,9 @@ HwioServer::PProcRes HwioServer::device_lookup_resp(ClientInfo * client,
         
 	vector<ihwio_dev *> result;
 	for (auto & bus : buses) {
-		for (auto dev : bus->find_devices(spec)) {
-			result.push_back(dev);
-		}
+		// buses use indexed lookup (hwio_device_registry)
+		auto devs = bus->find_devices(spec);
+		result.insert(result.end(), devs.begin(), devs.end());
 	}
 // 	std::cerr << result.size() << std::endl;
 	int i = 0;
@@ -1,4 +1,5 @@
 #include "hwio_server.h"
+#include "hwio_batch.h"
 
 using namespace std;
 using namespace hwio;
@@ -11,6 +12,8 @@ HwioServer::PProcRes HwioServer::handle_read(ClientInfo * client,
 		return send_err(MALFORMED_PACKET, "READ: size too small");
 
 	rdReq = reinterpret_cast<const RdReq*>(rx_buffer);
+	if (rdReq->size > BUFFER_SIZE - sizeof(Hwio_packet_header))
+		return send_err(MALFORMED_PACKET, "READ: response too large");
 	ihwio_dev * dev = client_get_dev(client, rdReq->devId);
 	if (!dev) {
 		return send_err(ACCESS_DENIED, "READ: device is not allocated");
@@ -40,6 +43,8 @@ HwioServer::PProcRes HwioServer::handle_write(ClientInfo * client,
 		return send_err(MALFORMED_PACKET, "WRITE: size too small");
 
 	const WrReq* wrReq = reinterpret_cast<WrReq*>(rx_buffer);
+	if (header.body_len != sizeof(WrReq) + wrReq->_.size)
+		return send_err(MALFORMED_PACKET, "WRITE: wrong size of packet");
 	if (wrReq->_.devId >= MAX_DEVICES)
 		return send_err(MALFORMED_PACKET, "WRITE: wrong device id");
 
@@ -58,3 +63,262 @@ HwioServer::PProcRes HwioServer::handle_write(ClientInfo * client,
 
 	return PProcRes(false, 0);
 }
+
+HwioServer::PProcRes HwioServer::handle_read_multiple(ClientInfo * client,
+		Hwio_packet_header header) {
+	size_t cnt = header.body_len / sizeof(RdReqMulti);
+	if (cnt == 0 || header.body_len != cnt * sizeof(RdReqMulti))
+		return send_err(MALFORMED_PACKET, "READ_MULTIPLE: wrong size of packet");
+
+	auto items = reinterpret_cast<const RdReqMulti*>(rx_buffer);
+	size_t resp_size = 0;
+	for (size_t i = 0; i < cnt; i++)
+		resp_size += items[i].size;
+	if (resp_size > BUFFER_SIZE - sizeof(Hwio_packet_header))
+		return send_err(MALFORMED_PACKET, "READ_MULTIPLE: response too large");
+
+	if (log_level >= logDEBUG) {
+		std::cout << "[DEBUG] READ_MULTIPLE: client:" << client->id
+				<< ", items:" << cnt << endl;
+	}
+
+	auto resp = reinterpret_cast<HwioFrame<RdMultiResp>*>(tx_buffer);
+	char * data = resp->body.data;
+	for (auto item = items; item < items + cnt; ++item) {
+		ihwio_dev * dev = client_get_dev(client, item->devId);
+		if (!dev)
+			return send_err(ACCESS_DENIED, "READ_MULTIPLE: device is not allocated");
+		try {
+			dev->read(item->addr, data, item->size);
+		} catch (std::runtime_error & err) {
+			return send_err(IO_ERROR, "Can not read from device");
+		}
+		data += item->size;
+	}
+	resp->header.command = HWIO_CMD_READ_MULTIPLE_RESP;
+	resp->header.body_len = resp_size;
+	return PProcRes(false, sizeof(resp->header) + resp_size);
+}
+
+HwioServer::PProcRes HwioServer::handle_write_multiple(ClientInfo * client,
+		Hwio_packet_header header) {
+	size_t offset = 0;
+	while (offset < header.body_len) {
+		if (header.body_len - offset < sizeof(WrReqMulti))
+			return send_err(MALFORMED_PACKET, "WRITE_MULTIPLE: size too small");
+		auto item = reinterpret_cast<const WrReqMulti*>(rx_buffer + offset);
+		offset += sizeof(WrReqMulti) + item->_.size;
+		if (offset > header.body_len)
+			return send_err(MALFORMED_PACKET, "WRITE_MULTIPLE: item data out of packet");
+
+		auto dev = client_get_dev(client, item->_.devId);
+		if (!dev)
+			return send_err(ACCESS_DENIED, "WRITE_MULTIPLE: device is not allocated");
+		dev->write(item->_.addr, item->data, item->_.size);
+	}
+
+	if (log_level >= logDEBUG) {
+		std::cout << "[DEBUG] WRITE_MULTIPLE: client:" << client->id << ", size:"
+				<< header.body_len << endl;
+	}
+	return PProcRes(false, 0);
+}
+
+HwioServer::PProcRes HwioServer::handle_read_keyhole(ClientInfo * client,
+		Hwio_packet_header header) {
+	if (header.body_len != sizeof(KeyholeReq))
+		return send_err(MALFORMED_PACKET, "READ_KEYHOLE: wrong size of packet");
+
+	auto req = reinterpret_cast<const KeyholeReq*>(rx_buffer);
+	if (req->size > BUFFER_SIZE - sizeof(Hwio_packet_header))
+		return send_err(MALFORMED_PACKET, "READ_KEYHOLE: response too large");
+
+	ihwio_dev * dev = client_get_dev(client, req->devId);
+	if (!dev)
+		return send_err(ACCESS_DENIED, "READ_KEYHOLE: device is not allocated");
+
+	if (log_level >= logDEBUG) {
+		std::cout << "[DEBUG] READ_KEYHOLE:" << (int) req->devId << " 0x" << hex
+				<< req->addr << dec << " size:" << req->size << endl;
+	}
+
+	auto resp = reinterpret_cast<HwioFrame<RdResp>*>(tx_buffer);
+	resp->header.command = HWIO_CMD_READ_RESP;
+	resp->header.body_len = req->size;
+	try {
+		dev->read_keyhole(req->addr, resp->body.data, req->size, req->width);
+	} catch (std::runtime_error & err) {
+		return send_err(IO_ERROR,
+				std::string("Can not read from device: ") + err.what());
+	}
+	return PProcRes(false, sizeof(resp->header) + req->size);
+}
+
+HwioServer::PProcRes HwioServer::handle_write_keyhole(ClientInfo * client,
+		Hwio_packet_header header) {
+	if (header.body_len < sizeof(WrKeyholeReq))
+		return send_err(MALFORMED_PACKET, "WRITE_KEYHOLE: size too small");
+
+	auto req = reinterpret_cast<const WrKeyholeReq*>(rx_buffer);
+	if (header.body_len != sizeof(WrKeyholeReq) + req->_.size)
+		return send_err(MALFORMED_PACKET, "WRITE_KEYHOLE: wrong size of packet");
+
+	ihwio_dev * dev = client_get_dev(client, req->_.devId);
+	if (!dev)
+		return send_err(ACCESS_DENIED, "WRITE_KEYHOLE: device is not allocated");
+
+	if (log_level >= logDEBUG) {
+		std::cout << "[DEBUG] WRITE_KEYHOLE: client:" << client->id << ", dev:"
+				<< (int) req->_.devId << " 0x" << hex << req->_.addr << dec
+				<< " size:" << req->_.size << endl;
+	}
+
+	try {
+		dev->write_keyhole(req->_.addr, req->data, req->_.size, req->_.width);
+	} catch (std::runtime_error & err) {
+		return send_err(IO_ERROR,
+				std::string("Can not write to device: ") + err.what());
+	}
+	return PProcRes(false, 0);
+}
+
+HwioServer::PProcRes HwioServer::handle_fill(ClientInfo * client,
+		Hwio_packet_header header) {
+	if (header.body_len != sizeof(FillReq))
+		return send_err(MALFORMED_PACKET, "FILL: wrong size of packet");
+
+	auto req = reinterpret_cast<const FillReq*>(rx_buffer);
+	ihwio_dev * dev = client_get_dev(client, req->devId);
+	if (!dev)
+		return send_err(ACCESS_DENIED, "FILL: device is not allocated");
+
+	if (log_level >= logDEBUG) {
+		std::cout << "[DEBUG] FILL: client:" << client->id << ", dev:"
+				<< (int) req->devId << " 0x" << hex << req->addr << " 0x"
+				<< req->pattern << dec << " size:" << req->size << endl;
+	}
+
+	try {
+		dev->fill(req->addr, req->pattern, req->width, req->size);
+	} catch (std::runtime_error & err) {
+		return send_err(IO_ERROR,
+				std::string("Can not write to device: ") + err.what());
+	}
+	return PProcRes(false, 0);
+}
+
+HwioServer::PProcRes HwioServer::handle_rmw(ClientInfo * client,
+		Hwio_packet_header header) {
+	if (header.body_len != sizeof(RmwReq))
+		return send_err(MALFORMED_PACKET, "RMW: wrong size of packet");
+
+	auto req = reinterpret_cast<const RmwReq*>(rx_buffer);
+	if (req->width != sizeof(uint32_t) && req->width != sizeof(uint64_t))
+		return send_err(MALFORMED_PACKET, "RMW: unsupported width");
+	if (req->op != HWIO_RMW_MASKED && req->op != HWIO_RMW_TOGGLE)
+		return send_err(MALFORMED_PACKET, "RMW: unknown operation");
+
+	ihwio_dev * dev = client_get_dev(client, req->devId);
+	if (!dev)
+		return send_err(ACCESS_DENIED, "RMW: device is not allocated");
+
+	if (log_level >= logDEBUG) {
+		std::cout << "[DEBUG] RMW: client:" << client->id << ", dev:"
+				<< (int) req->devId << " 0x" << hex << req->addr << " mask:0x"
+				<< req->mask << " value:0x" << req->value << dec << " op:"
+				<< (int) req->op << endl;
+	}
+
+	// requests of one device are executed sequentially, no other client
+	// can access the register between the read and the write
+	auto resp = reinterpret_cast<HwioFrame<RdResp>*>(tx_buffer);
+	resp->header.command = HWIO_CMD_READ_RESP;
+	resp->header.body_len = req->width;
+	try {
+		if (req->width == sizeof(uint32_t)) {
+			uint32_t old;
+			if (req->op == HWIO_RMW_TOGGLE)
+				old = dev->toggle_bits32(req->addr, req->mask);
+			else
+				old = dev->rmw32(req->addr, req->mask, req->value);
+			memcpy(resp->body.data, &old, sizeof(old));
+		} else {
+			uint64_t old;
+			if (req->op == HWIO_RMW_TOGGLE)
+				old = dev->toggle_bits64(req->addr, req->mask);
+			else
+				old = dev->rmw64(req->addr, req->mask, req->value);
+			memcpy(resp->body.data, &old, sizeof(old));
+		}
+	} catch (std::runtime_error & err) {
+		return send_err(IO_ERROR,
+				std::string("Can not modify register of device: ") + err.what());
+	}
+	return PProcRes(false, sizeof(resp->header) + req->width);
+}
+
+HwioServer::PProcRes HwioServer::handle_batch(ClientInfo * client,
+		Hwio_packet_header header) {
+	const size_t max_body = BUFFER_SIZE - sizeof(Hwio_packet_header);
+	if (header.body_len < sizeof(BatchReq))
+		return send_err(MALFORMED_PACKET, "BATCH: size too small");
+
+	auto req = reinterpret_cast<const BatchReq*>(rx_buffer);
+	ihwio_dev * dev = client_get_dev(client, req->devId);
+	if (!dev)
+		return send_err(ACCESS_DENIED, "BATCH: device is not allocated");
+
+	// read data is stored directly to the response
+	auto resp = reinterpret_cast<HwioFrame<RdMultiResp>*>(tx_buffer);
+	size_t resp_size = 0;
+	hwio_batch batch(dev);
+	size_t offset = sizeof(BatchReq);
+	while (offset < header.body_len) {
+		if (offset + sizeof(BatchItem) > header.body_len)
+			return send_err(MALFORMED_PACKET, "BATCH: incomplete item");
+		auto item = reinterpret_cast<const BatchItem*>(rx_buffer + offset);
+		offset += sizeof(BatchItem);
+		switch (item->op) {
+		case HWIO_BATCH_READ:
+			if (resp_size + item->size > max_body)
+				return send_err(MALFORMED_PACKET,
+						"BATCH: read data does not fit in to response");
+			batch.read(item->addr, resp->body.data + resp_size, item->size);
+			resp_size += item->size;
+			break;
+		case HWIO_BATCH_WRITE:
+			if (offset + item->size > header.body_len)
+				return send_err(MALFORMED_PACKET, "BATCH: incomplete write");
+			batch.write(item->addr, rx_buffer + offset, item->size);
+			offset += item->size;
+			break;
+		case HWIO_BATCH_FILL: {
+			uint64_t pattern;
+			if (offset + sizeof(pattern) > header.body_len)
+				return send_err(MALFORMED_PACKET, "BATCH: incomplete fill");
+			memcpy(&pattern, rx_buffer + offset, sizeof(pattern));
+			batch.fill(item->addr, pattern, item->width, item->size);
+			offset += sizeof(pattern);
+			break;
+		}
+		default:
+			return send_err(MALFORMED_PACKET, "BATCH: unknown operation");
+		}
+	}
+
+	if (log_level >= logDEBUG) {
+		std::cout << "[DEBUG] BATCH: client:" << client->id << ", dev:"
+				<< (int) req->devId << " items:" << batch.size()
+				<< " read:" << resp_size << endl;
+	}
+
+	try {
+		batch.flush();
+	} catch (std::runtime_error & err) {
+		return send_err(IO_ERROR,
+				std::string("Can not access device: ") + err.what());
+	}
+	resp->header.command = HWIO_CMD_BATCH_RESP;
+	resp->header.body_len = resp_size;
+	return PProcRes(false, sizeof(resp->header) + resp_size);
+}
@@ -0,0 +1,210 @@
+#include "hwio_server.h"
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+using namespace std;
+using namespace hwio;
+
+HwioServer::PProcRes HwioServer::handle_shm_attach(ClientInfo * client,
+		Hwio_packet_header header) {
+	if (header.body_len != sizeof(ShmAttachReq))
+		return send_err(MALFORMED_PACKET, "SHM_ATTACH: wrong size of packet");
+	if (addr->ai_family != AF_UNIX)
+		return send_err(ACCESS_DENIED,
+				"SHM_ATTACH: shared memory is available only on unix domain socket");
+	if (client->shm || client->shm_offer)
+		return send_err(ACCESS_DENIED,
+				"SHM_ATTACH: client already uses shared memory");
+	// the response with file descriptors has to follow previous responses
+	if (!flush_client_tx(client))
+		return PProcRes(true, 0);
+	{
+		std::lock_guard<std::mutex> lock(client->tx_lock);
+		if (client->tx_queued())
+			return send_err(ACCESS_DENIED,
+					"SHM_ATTACH: previous responses were not received by client");
+	}
+
+	auto req = reinterpret_cast<const ShmAttachReq*>(rx_buffer);
+	size_t ring_size = hwio_shm_channel::DEFAULT_RING_SIZE;
+	if (req->ring_size) {
+		// the ring has to fit at least one request and one response
+		if ((req->ring_size & (req->ring_size - 1))
+				|| req->ring_size < 2 * RxBuffer::RX_BUFFER_SIZE)
+			return send_err(MALFORMED_PACKET, "SHM_ATTACH: wrong size of ring");
+		ring_size = req->ring_size;
+	}
+	try {
+		client->shm_offer = new hwio_shm_channel(ring_size);
+	} catch (const std::runtime_error & err) {
+		return send_err(IO_ERROR, err.what());
+	}
+	// server waits in poll until the client writes to eventfd
+	client->shm_offer->req->prepare_sleep();
+
+	auto resp = reinterpret_cast<HwioFrame<ShmAttachResp>*>(tx_buffer);
+	resp->header.command = HWIO_CMD_SHM_ATTACH_RESP;
+	resp->header.body_len = sizeof(ShmAttachResp);
+	resp->header.tag = header.tag;
+	resp->body.ring_size = ring_size;
+
+	// the response is sent once the socket is writable, the file descriptors
+	// are attached to its first part
+	client->shm_fds_sent = false;
+	queue_to_client(client, sizeof(*resp));
+	if (!flush_client_tx(client))
+		return PProcRes(true, 0);
+
+	return PProcRes(false, 0);
+}
+
+ssize_t HwioServer::send_shm_fds(ClientInfo * client, const char * data,
+		size_t size) {
+	hwio_shm_channel * shm = client->shm_offer;
+	int fds[3] = { shm->get_mem_fd(), shm->get_req_efd(), shm->get_resp_efd() };
+	union {
+		char buf[CMSG_SPACE(sizeof(fds))];
+		struct cmsghdr align;
+	} cmsg_buf;
+	struct iovec iov;
+	iov.iov_base = const_cast<char *>(data);
+	iov.iov_len = size;
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg_buf.buf;
+	msg.msg_controllen = sizeof(cmsg_buf.buf);
+	struct cmsghdr * c = CMSG_FIRSTHDR(&msg);
+	c->cmsg_level = SOL_SOCKET;
+	c->cmsg_type = SCM_RIGHTS;
+	c->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(c), fds, sizeof(fds));
+	return sendmsg(client->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+void HwioServer::shm_offer_accepted(ClientInfo * client) {
+	client->shm = client->shm_offer;
+	client->shm_offer = nullptr;
+
+	if (log_level >= logINFO)
+		std::cout << "[INFO] Client " << client->id
+				<< " uses shared memory transport (ring size "
+				<< client->shm->get_ring_size() << ")" << std::endl;
+
+	// all next requests are received from shared memory
+	epoll_add(client->shm->get_req_efd(), FD_SHM, client);
+}
+
+bool HwioServer::read_from_shm(ClientInfo * client) {
+	if (client->shm->req->readable() == 0)
+		return false;
+	rx_acquire(client);
+	struct iovec iov[2];
+	int iovcnt = client->rx_buffer.free_space(iov);
+	size_t s = 0;
+	for (int i = 0; i < iovcnt; i++) {
+		size_t n = client->shm->req->read(iov[i].iov_base, iov[i].iov_len);
+		s += n;
+		if (n < iov[i].iov_len)
+			break;
+	}
+	client->rx_buffer.curr_len += s;
+	return s > 0;
+}
+
+void HwioServer::send_to_shm(ClientInfo * client, size_t tx_size) {
+	hwio_shm_ring * r = client->shm->resp;
+	const char * d = tx_buffer;
+	if (client->tx_queued() == 0) {
+		size_t n = r->write(d, tx_size);
+		d += n;
+		tx_size -= n;
+		r->notify();
+		if (tx_size == 0)
+			return;
+	}
+	// response ring is full, client has to read responses first,
+	// next requests of client are not read until the rest is written
+	client->tx_queue.insert(client->tx_queue.end(), d, d + tx_size);
+	client->tx_paused = true;
+	shm_tx_arm_timer();
+}
+
+void HwioServer::flush_shm_tx(ClientInfo * client) {
+	hwio_shm_ring * r = client->shm->resp;
+	size_t n = r->write(client->tx_queue.data() + client->tx_queue_head,
+			client->tx_queued());
+	if (n == 0)
+		return;
+	r->notify();
+	client->tx_queue_head += n;
+	if (client->tx_queued() == 0) {
+		client->tx_queue.clear();
+		client->tx_queue_head = 0;
+		client->tx_paused = false;
+	}
+}
+
+void HwioServer::shm_tx_arm_timer() {
+	struct itimerspec t;
+	memset(&t, 0, sizeof(t));
+	t.it_value.tv_nsec = SHM_TX_RETRY_NS;
+	timerfd_settime(shm_tx_timer_fd, 0, &t, nullptr);
+}
+
+void HwioServer::handle_shm_tx_timer() {
+	uint64_t expirations;
+	if (read(shm_tx_timer_fd, &expirations, sizeof(expirations)) < 0
+			&& errno != EAGAIN && log_level >= logERROR)
+		LOG_ERR << "Can not read shm tx timer: " << strerror(errno) << endl;
+
+	std::vector<ClientInfo *> resumed;
+	bool queued = false;
+	for (auto client : clients) {
+		if (client == nullptr || client->shm == nullptr || client->closing)
+			continue;
+		std::lock_guard<std::mutex> lock(client->tx_lock);
+		if (client->tx_queued() == 0)
+			continue;
+		flush_shm_tx(client);
+		if (client->tx_queued())
+			queued = true;
+		else
+			resumed.push_back(client);
+	}
+	if (queued)
+		shm_tx_arm_timer();
+
+	// continue with requests which were not read because of the responses
+	for (auto client : resumed)
+		handle_shm_client_requests(client);
+}
+
+void HwioServer::handle_shm_client_requests(ClientInfo * client) {
+	hwio_shm_ring * r = client->shm->req;
+	r->wake_up();
+	// requests which were already read
+	if (!parse_msgs(client))
+		return; // client disconnected
+	for (unsigned i = 0; i < SHM_MAX_READS_PER_POLL; i++) {
+		// continues in handle_exec_done, handle_wait_timer
+		// or handle_shm_tx_timer
+		if (client->blocked || client->wait || client_tx_paused(client))
+			return;
+		if (read_from_shm(client)) {
+			if (!parse_msgs(client))
+				return; // client disconnected
+			continue;
+		}
+		// adaptive spinning for next request of this client
+		if (r->spin_wait())
+			continue;
+		if (r->prepare_sleep())
+			return;
+	}
+	// client is still active, let other clients to be served
+	// and continue in next poll
+	eventfd_write(r->event_fd(), 1);
+}
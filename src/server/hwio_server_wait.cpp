@@ -0,0 +1,195 @@
+#include "hwio_server.h"
+
+#include <algorithm>
+#include <time.h>
+#include <sys/timerfd.h>
+
+using namespace std;
+using namespace hwio;
+
+static uint64_t monotonic_ns() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return uint64_t(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+}
+
+size_t HwioServer::wait_resp(bool done, uint32_t value) {
+	auto resp = reinterpret_cast<HwioFrame<WaitResp>*>(tx_buffer);
+	resp->header.command = HWIO_CMD_WAIT_UNTIL_RESP;
+	resp->header.body_len = sizeof(WaitResp);
+	resp->body.done = done;
+	resp->body.value = value;
+	return sizeof(resp->header) + sizeof(WaitResp);
+}
+
+HwioServer::PProcRes HwioServer::handle_wait_until(ClientInfo * client,
+		Hwio_packet_header header) {
+	if (header.body_len != sizeof(WaitReq))
+		return send_err(MALFORMED_PACKET, "WAIT_UNTIL: wrong size of packet");
+
+	auto req = reinterpret_cast<const WaitReq*>(rx_buffer);
+	ihwio_dev * dev = client_get_dev(client, req->devId);
+	if (!dev)
+		return send_err(ACCESS_DENIED, "WAIT_UNTIL: device is not allocated");
+
+	if (log_level >= logDEBUG) {
+		std::cout << "[DEBUG] WAIT_UNTIL: client:" << client->id << ", dev:"
+				<< (int) req->devId << " 0x" << hex << req->addr << " mask:0x"
+				<< req->mask << " expected:0x" << req->expected << dec
+				<< " timeout:" << req->timeout_us << "us" << endl;
+	}
+
+	// with worker threads exec_dispatch has already waited until the queue
+	// of the device is idle, the read does not interleave with its requests
+	uint32_t value;
+	try {
+		value = dev->read32(req->addr);
+	} catch (std::runtime_error & err) {
+		return send_err(IO_ERROR,
+				std::string("Can not read from device: ") + err.what());
+	}
+	bool done = (value & req->mask) == req->expected;
+	if (done || req->timeout_us == 0)
+		return PProcRes(false, wait_resp(done, value));
+
+	// the register is polled from handle_wait_timer, other clients
+	// are served meanwhile and next requests of this client wait
+	uint64_t now = monotonic_ns();
+	auto w = new HwioServerWait;
+	w->client = client;
+	w->dev = dev;
+	w->tag = header.tag;
+	w->req = *req;
+	w->deadline = now + uint64_t(req->timeout_us) * 1000;
+	w->interval = WAIT_MIN_POLL_NS;
+	w->next_check = now + w->interval;
+	w->held = false;
+	waits.push_back(w);
+	client->wait = w;
+	if (!client->shm)
+		client_set_rx(client, false);
+	wait_arm_timer();
+	return PProcRes(false, 0);
+}
+
+void HwioServer::wait_arm_timer() {
+	struct itimerspec t;
+	memset(&t, 0, sizeof(t));
+	if (waits.size()) {
+		uint64_t next = UINT64_MAX;
+		for (auto w : waits) {
+			// check of held wait is postponed even after its deadline
+			next = std::min(next,
+					w->held ? w->next_check : std::min(w->next_check, w->deadline));
+		}
+		// zero would disarm the timer
+		next = std::max<uint64_t>(next, 1);
+		t.it_value.tv_sec = next / 1000000000ULL;
+		t.it_value.tv_nsec = next % 1000000000ULL;
+	}
+	timerfd_settime(wait_timer_fd, TFD_TIMER_ABSTIME, &t, nullptr);
+}
+
+void HwioServer::handle_wait_timer() {
+	uint64_t expirations;
+	if (read(wait_timer_fd, &expirations, sizeof(expirations)) < 0
+			&& errno != EAGAIN && log_level >= logERROR)
+		LOG_ERR << "Can not read wait timer: " << strerror(errno) << endl;
+
+	// the completed waits are removed first, responding to them may
+	// start new waits or disconnect clients
+	struct wait_res_t {
+		HwioServerWait * wait;
+		bool done;
+		uint32_t value;
+		std::string err;
+	};
+	std::vector<wait_res_t> finished;
+	uint64_t now = monotonic_ns();
+	for (auto it = waits.begin(); it != waits.end();) {
+		HwioServerWait * w = *it;
+		if (w->next_check > now && w->deadline > now) {
+			++it;
+			continue;
+		}
+		if (workers.size()) {
+			// registers are read by this thread, requests of other clients
+			// on the device in worker threads have to be completed first
+			std::lock_guard<std::mutex> lock(exec_lock);
+			std::vector<ihwio_dev *> devs = { w->dev };
+			if (!exec_devs_idle(devs)) {
+				// no new requests are started on the device until the check
+				if (!w->held) {
+					exec_hold(devs);
+					w->held = true;
+				}
+				w->next_check = now + w->interval;
+				++it;
+				continue;
+			}
+		}
+		wait_res_t r = { w, false, 0, "" };
+		try {
+			r.value = w->dev->read32(w->req.addr);
+			r.done = (r.value & w->req.mask) == w->req.expected;
+		} catch (std::runtime_error & err) {
+			r.err = err.what();
+		}
+		if (w->held) {
+			std::lock_guard<std::mutex> lock(exec_lock);
+			exec_release( { w->dev });
+			w->held = false;
+		}
+		if (!r.done && r.err.empty() && w->deadline > now) {
+			// the longer the condition is not met the less often it is checked
+			w->interval = std::min(w->interval * 2, uint64_t(WAIT_MAX_POLL_NS));
+			w->next_check = now + w->interval;
+			++it;
+			continue;
+		}
+		w->client->wait = nullptr;
+		finished.push_back(r);
+		it = waits.erase(it);
+	}
+	wait_arm_timer();
+
+	for (auto & r : finished) {
+		ClientInfo * client = r.wait->client;
+		uint16_t tag = r.wait->tag;
+		delete r.wait;
+
+		PProcRes respMeta(false, 0);
+		if (r.err.size())
+			respMeta = send_err(IO_ERROR,
+					std::string("Can not read from device: ") + r.err);
+		else
+			respMeta.tx_size = wait_resp(r.done, r.value);
+		reinterpret_cast<Hwio_packet_header*>(tx_buffer)->tag = tag;
+		if (!send_to_client(client, respMeta.tx_size) || respMeta.disconnect) {
+			disconnect_client(client);
+			continue;
+		}
+
+		// continue with requests received while waiting
+		if (!client->shm)
+			client_set_rx(client, true);
+		if (!parse_msgs(client))
+			continue;
+		if (client->shm)
+			handle_shm_client_requests(client);
+	}
+}
+
+void HwioServer::wait_remove(ClientInfo * client) {
+	if (client->wait == nullptr)
+		return;
+	waits.erase(std::remove(waits.begin(), waits.end(), client->wait),
+			waits.end());
+	if (client->wait->held) {
+		std::lock_guard<std::mutex> lock(exec_lock);
+		exec_release( { client->wait->dev });
+	}
+	delete client->wait;
+	client->wait = nullptr;
+	wait_arm_timer();
+}
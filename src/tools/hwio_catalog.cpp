@@ -0,0 +1,31 @@
+/*
+ * hwio-catalog, rebuild device catalogs of "catalog" buses in hwio config
+ *
+ * Catalog checks only the root of its source when it is loaded,
+ * this tool has to be used after a change deeper in the device-tree.
+ * */
+#include <iostream>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "hwio_cli.h"
+#include "hwio_bus_catalog.h"
+#include "bus/hwio_bus_json.h"
+
+using namespace hwio;
+
+int main(int argc, char * argv[]) {
+	if (argc != 2) {
+		std::cerr << "usage: " << argv[0] << " <config.json>" << std::endl;
+		return 1;
+	}
+	try {
+		boost::property_tree::ptree config;
+		boost::property_tree::read_json(argv[1], config);
+		size_t cnt = hwio_catalog_rebuild(config);
+		std::cout << "rebuilt " << cnt << " catalog(s)" << std::endl;
+	} catch (const std::exception & e) {
+		std::cerr << "[HWIO, catalog] " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
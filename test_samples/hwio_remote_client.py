@@ -42,15 +42,16 @@ class HwioFrame():
     """
     Header for frames used by hwio server
     """
-    HEADER_FORMAT = "<BH"
-    HEADER_LEN = 3
+    HEADER_FORMAT = "<BHH"
+    HEADER_LEN = 5
 
-    def __init__(self, cmd, data):
+    def __init__(self, cmd, data, tag=0):
         self.cmd = cmd
         self.data = data
+        self.tag = tag
 
     def __bytes__(self):
-        return pack(self.HEADER_FORMAT, self.cmd, len(self.data)) + self.data
+        return pack(self.HEADER_FORMAT, self.cmd, len(self.data), self.tag) + self.data
 
     def __repr__(self):
         return "<HwioFrame cmd:%d, %r>" % (self.cmd, self.data)
@@ -135,7 +136,7 @@ class HWIO_device():
     def recvFrame(self):
         data = self._connection.recv(HwioFrame.HEADER_LEN)
         try:
-            cmd, length = unpack(HwioFrame.HEADER_FORMAT, data)
+            cmd, length, tag = unpack(HwioFrame.HEADER_FORMAT, data)
         except error as e:
             raise HwioErr(e, data)
 
@@ -144,7 +145,7 @@ class HWIO_device():
         else:
             body = b""
 
-        return HwioFrame(cmd, body)
+        return HwioFrame(cmd, body, tag)
 
     def sendFrame(self, cmd, body):
         frame = HwioFrame(cmd, body)
@@ -0,0 +1,190 @@
+#define BOOST_TEST_MODULE "Tests of hwio_bus_catalog"
+#include <boost/test/unit_test.hpp>
+
+#include "hwio_bus_catalog.h"
+#include "hwio_bus_devicetree.h"
+#include "bus/hwio_bus_json.h"
+#include "hwio_cli.h"
+#include <fstream>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace hwio {
+
+typedef std::vector<hwio_comp_spec> dev_spec_t;
+
+void check_same_device(hwio_device_mmap * a, hwio_device_mmap * b) {
+	BOOST_CHECK_EQUAL(a->on_bus_base_addr, b->on_bus_base_addr);
+	BOOST_CHECK_EQUAL(a->on_bus_size, b->on_bus_size);
+	BOOST_CHECK_EQUAL(a->name(), b->name());
+	BOOST_CHECK_EQUAL(a->mem_path(), b->mem_path());
+	BOOST_CHECK_EQUAL(a->access_widths(), b->access_widths());
+	auto & sa = a->get_spec();
+	auto & sb = b->get_spec();
+	BOOST_REQUIRE_EQUAL(sa.size(), sb.size());
+	for (size_t i = 0; i < sa.size(); i++)
+		BOOST_CHECK_EQUAL(sa[i].to_str(), sb[i].to_str());
+}
+
+void copy_file(const char * src, const char * dst) {
+	std::ifstream in(src, std::ios::binary);
+	std::ofstream out(dst, std::ios::binary);
+	out << in.rdbuf();
+}
+
+BOOST_AUTO_TEST_CASE(test_catalog_devicetree) {
+	const char * src = "test_samples/device-tree0_32b";
+	const char * cat = "test_samples/device-tree0_32b.cat";
+	hwio_bus_devicetree dt(src);
+	hwio_bus_catalog::write(cat, src, dt._all_devices);
+
+	hwio_bus_catalog bus(cat, src);
+	BOOST_REQUIRE_EQUAL(bus._all_devices.size(), dt._all_devices.size());
+	for (size_t i = 0; i < bus._all_devices.size(); i++)
+		check_same_device(bus._all_devices[i], dt._all_devices[i]);
+
+	hwio_comp_spec serial0("xlnx,xps-uartlite-1.1.97");
+	BOOST_CHECK_EQUAL(bus.find_devices((dev_spec_t ) { serial0 }).size(), 2);
+	hwio_comp_spec serial_name;
+	serial_name.name_set("serial@84000000");
+	BOOST_CHECK_EQUAL(bus.find_devices((dev_spec_t ) { serial_name }).size(), 1);
+	remove(cat);
+}
+
+BOOST_AUTO_TEST_CASE(test_catalog_json_outdated) {
+	const char * src = "test_samples/catalog_src.json";
+	const char * cat = "test_samples/catalog_src.cat";
+	copy_file("test_samples/device_descriptions/multiple.json", src);
+
+	boost::property_tree::ptree source;
+	source.put("type", "json");
+	source.put("file", src);
+	hwio_catalog_build(cat, source);
+	auto options = hwio_catalog_source_options(source);
+	{
+		hwio_bus_json js(src);
+		hwio_bus_catalog bus(cat, src, options);
+		BOOST_REQUIRE_EQUAL(bus._all_devices.size(), js._all_devices.size());
+		for (size_t i = 0; i < bus._all_devices.size(); i++)
+			check_same_device(bus._all_devices[i],
+					dynamic_cast<hwio_device_mmap*>(js._all_devices[i]));
+	}
+
+	// content of source changed
+	{
+		std::ofstream out(src, std::ios::app);
+		out << " ";
+	}
+	BOOST_CHECK_THROW(hwio_bus_catalog b(cat, src, options), hwio_catalog_err);
+	// check of source disabled
+	hwio_bus_catalog b(cat, "");
+	BOOST_CHECK_EQUAL(b._all_devices.size(), 8);
+
+	remove(src);
+	BOOST_CHECK_THROW(hwio_bus_catalog b(cat, src), hwio_catalog_err);
+	remove(cat);
+}
+
+BOOST_AUTO_TEST_CASE(test_catalog_access_widths) {
+	const char * src = "test_samples/device_descriptions/simple.json";
+	const char * cat = "test_samples/catalog_widths.cat";
+	boost::property_tree::ptree source;
+	source.put("type", "json");
+	source.put("file", src);
+	boost::property_tree::ptree widths, w;
+	for (auto bits : { "8", "16", "32", "64" }) {
+		w.put_value(bits);
+		widths.push_back(std::make_pair("", w));
+	}
+	source.add_child("access_widths", widths);
+	hwio_catalog_build(cat, source);
+
+	hwio_bus_catalog bus(cat, src, hwio_catalog_source_options(source));
+	BOOST_REQUIRE_EQUAL(bus._all_devices.size(), 2);
+	for (auto d : bus._all_devices)
+		BOOST_CHECK_EQUAL(d->access_widths(), HWIO_ACCESS_ALL);
+	remove(cat);
+}
+
+BOOST_AUTO_TEST_CASE(test_catalog_dir_outdated) {
+	const char * src = "test_samples/catalog_src_dir";
+	const char * cat = "test_samples/catalog_src_dir.cat";
+	mkdir(src, 0755);
+	mkdir("test_samples/catalog_src_dir/node", 0755);
+	{
+		std::ofstream out("test_samples/catalog_src_dir/node/reg");
+		out << "1234";
+	}
+	hwio_bus_catalog::write(cat, src, { }, "mem:/dev/mem");
+	{
+		hwio_bus_catalog bus(cat, src, "mem:/dev/mem");
+	}
+	// options of the source bus changed
+	BOOST_CHECK_THROW(hwio_bus_catalog b(cat, src, "mem:/dev/other"),
+			hwio_catalog_err);
+
+	// only the root of the tree is checked, file deep in the tree
+	// changed and mtime of root directory is the same
+	{
+		std::ofstream out("test_samples/catalog_src_dir/node/reg",
+				std::ios::app);
+		out << "5678";
+	}
+	{
+		hwio_bus_catalog bus(cat, src, "mem:/dev/mem");
+	}
+	// entry added in to root directory
+	mkdir("test_samples/catalog_src_dir/node2", 0755);
+	BOOST_CHECK_THROW(hwio_bus_catalog b(cat, src, "mem:/dev/mem"),
+			hwio_catalog_err);
+
+	rmdir("test_samples/catalog_src_dir/node2");
+	remove("test_samples/catalog_src_dir/node/reg");
+	rmdir("test_samples/catalog_src_dir/node");
+	rmdir(src);
+	remove(cat);
+}
+
+BOOST_AUTO_TEST_CASE(test_catalog_rebuild) {
+	const char * src = "test_samples/device-tree0_32b";
+	const char * cat = "test_samples/rebuild.cat";
+	boost::property_tree::ptree source, bus, buses, config;
+	source.put("type", "devicetree");
+	source.put("devicetree", src);
+	source.put("mem", "test_samples/mem0.dat");
+	bus.put("type", "catalog");
+	bus.put("file", cat);
+	bus.add_child("source", source);
+	buses.push_back(std::make_pair("", bus));
+	config.add_child("buses", buses);
+
+	BOOST_CHECK_THROW(
+			hwio_bus_catalog b(cat, src, hwio_catalog_source_options(source)),
+			hwio_catalog_err);
+	BOOST_CHECK_EQUAL(hwio_catalog_rebuild(config), 1);
+	hwio_bus_catalog b(cat, src, hwio_catalog_source_options(source));
+	BOOST_CHECK(b._all_devices.size() > 0);
+	remove(cat);
+}
+
+BOOST_AUTO_TEST_CASE(test_catalog_corrupted) {
+	const char * src = "test_samples/device-tree1_32b/device-tree";
+	const char * cat = "test_samples/corrupted.cat";
+	BOOST_CHECK_THROW(hwio_bus_catalog b(cat, src), hwio_catalog_err);
+
+	hwio_bus_devicetree dt(src);
+	hwio_bus_catalog::write(cat, src, dt._all_devices);
+	std::ifstream in(cat, std::ios::binary);
+	std::vector<char> data((std::istreambuf_iterator<char>(in)),
+			std::istreambuf_iterator<char>());
+	in.close();
+	{
+		std::ofstream out(cat, std::ios::binary);
+		out.write(data.data(), data.size() - 1);
+	}
+	BOOST_CHECK_THROW(hwio_bus_catalog b(cat, src), hwio_catalog_err);
+	remove(cat);
+}
+
+}
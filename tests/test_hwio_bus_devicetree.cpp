@@ -39,4 +39,24 @@ BOOST_AUTO_TEST_CASE(test_devicetree_device_load2) {
 	BOOST_CHECK_EQUAL(bus.find_devices((dev_spec_t ) { dp }).size(), 2);
 }
 
+BOOST_AUTO_TEST_CASE(test_devicetree_repeated_load) {
+	// result of parallel scan has to be always the same
+	hwio_bus_devicetree ref("test_samples/device-tree1_32b/device-tree/");
+	for (int i = 0; i < 10; i++) {
+		hwio_bus_devicetree bus("test_samples/device-tree1_32b/device-tree/");
+		BOOST_REQUIRE_EQUAL(bus._all_devices.size(), ref._all_devices.size());
+		for (size_t d = 0; d < bus._all_devices.size(); d++) {
+			BOOST_CHECK_EQUAL(bus._all_devices[d]->on_bus_base_addr,
+					ref._all_devices[d]->on_bus_base_addr);
+			BOOST_CHECK_EQUAL(bus._all_devices[d]->name(),
+					ref._all_devices[d]->name());
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_devicetree_missing) {
+	BOOST_CHECK_THROW(hwio_bus_devicetree("test_samples/non-existing-dir"),
+			std::runtime_error);
+}
+
 }
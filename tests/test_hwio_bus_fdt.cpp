@@ -0,0 +1,92 @@
+#define BOOST_TEST_MODULE "Tests of hwio_bus_fdt"
+#include <boost/test/unit_test.hpp>
+
+#include "hwio_bus_fdt.h"
+#include "hwio_bus_devicetree.h"
+#include <fstream>
+#include <iostream>
+
+namespace hwio {
+
+typedef std::vector<hwio_comp_spec> dev_spec_t;
+
+/*
+ * Check that both buses discovered the same devices in the same order
+ * */
+void check_same_devices(hwio_bus_fdt & fdt, hwio_bus_devicetree & dt) {
+	BOOST_REQUIRE_EQUAL(fdt._all_devices.size(), dt._all_devices.size());
+	for (size_t i = 0; i < fdt._all_devices.size(); i++) {
+		auto a = fdt._all_devices[i];
+		auto b = dt._all_devices[i];
+		BOOST_CHECK_EQUAL(a->on_bus_base_addr, b->on_bus_base_addr);
+		BOOST_CHECK_EQUAL(a->on_bus_size, b->on_bus_size);
+		BOOST_CHECK_EQUAL(a->name(), b->name());
+		auto & sa = a->get_spec();
+		auto & sb = b->get_spec();
+		BOOST_REQUIRE_EQUAL(sa.size(), sb.size());
+		for (size_t j = 0; j < sa.size(); j++)
+			BOOST_CHECK_EQUAL(sa[j].to_str(), sb[j].to_str());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_fdt_device_load) {
+	hwio_bus_fdt bus("test_samples/device-tree0_32b.dtb");
+
+	BOOST_CHECK_EQUAL(bus._all_devices.size(), 8);
+
+	hwio_comp_spec serial0("xlnx,xps-uartlite-1.1.97");
+	auto s0 = bus.find_devices((dev_spec_t ) { serial0 });
+	BOOST_CHECK_EQUAL(s0.size(), 2);
+	auto s0_base = dynamic_cast<hwio_device_mmap*>(s0.at(0))->on_bus_base_addr;
+	auto s1_base = dynamic_cast<hwio_device_mmap*>(s0.at(1))->on_bus_base_addr;
+	BOOST_CHECK_EQUAL(s0_base, 0x84000000);
+	BOOST_CHECK_EQUAL(s1_base, 0x88000000);
+
+	hwio_comp_spec simplebus("simple-bus");
+	BOOST_CHECK_EQUAL(bus.find_devices((dev_spec_t ) { simplebus }).size(), 1);
+
+	hwio_comp_spec serial_name;
+	serial_name.name_set("serial@84000000");
+	BOOST_CHECK_EQUAL(bus.find_devices((dev_spec_t ) { serial_name }).size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_fdt_same_as_devicetree) {
+	hwio_bus_fdt fdt0("test_samples/device-tree0_32b.dtb");
+	hwio_bus_devicetree dt0("test_samples/device-tree0_32b");
+	check_same_devices(fdt0, dt0);
+
+	hwio_bus_fdt fdt1("test_samples/device-tree1_32b.dtb");
+	hwio_bus_devicetree dt1("test_samples/device-tree1_32b/device-tree/");
+	check_same_devices(fdt1, dt1);
+
+	hwio_comp_spec dp("uprobe,dispather-1.0.a");
+	BOOST_CHECK_EQUAL(fdt1.find_devices((dev_spec_t ) { dp }).size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_fdt_corrupted) {
+	BOOST_CHECK_THROW(hwio_bus_fdt("test_samples/non-existing.dtb"),
+			std::runtime_error);
+
+	// truncated blob
+	std::ifstream in("test_samples/device-tree0_32b.dtb", std::ios::binary);
+	std::vector<char> blob((std::istreambuf_iterator<char>(in)),
+			std::istreambuf_iterator<char>());
+	BOOST_REQUIRE(blob.size() > 128);
+	const char * tmp = "test_samples/corrupted.dtb";
+	{
+		std::ofstream out(tmp, std::ios::binary);
+		out.write(blob.data(), blob.size() / 2);
+	}
+	BOOST_CHECK_THROW(hwio_bus_fdt b(tmp), std::runtime_error);
+
+	// wrong magic
+	blob[0] = 0;
+	{
+		std::ofstream out(tmp, std::ios::binary);
+		out.write(blob.data(), blob.size());
+	}
+	BOOST_CHECK_THROW(hwio_bus_fdt b(tmp), std::runtime_error);
+	std::remove(tmp);
+}
+
+}
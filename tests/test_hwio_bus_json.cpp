@@ -9,6 +9,38 @@ namespace hwio {
 BOOST_AUTO_TEST_CASE(test_json_device_load) {
 	hwio_bus_json bus("test_samples/device_descriptions/multiple.json");
 	BOOST_CHECK_EQUAL(bus._all_devices.size(), 8);
+	// 16b and 64b accesses are enabled only explicitly
+	for (auto d : bus._all_devices)
+		BOOST_CHECK_EQUAL(d->access_widths(), HWIO_ACCESS_8 | HWIO_ACCESS_32);
+}
+
+BOOST_AUTO_TEST_CASE(test_json_access_widths) {
+	boost::property_tree::ptree doc;
+	boost::property_tree::read_json(
+			"test_samples/device_descriptions/simple.json", doc);
+	{
+		hwio_bus_json bus(doc, HWIO_ACCESS_32 | HWIO_ACCESS_64);
+		for (auto d : bus._all_devices)
+			BOOST_CHECK_EQUAL(d->access_widths(),
+					HWIO_ACCESS_8 | HWIO_ACCESS_32 | HWIO_ACCESS_64);
+	}
+
+	// widths in the description override the widths of the constructor
+	boost::property_tree::ptree widths, w;
+	w.put_value("16");
+	widths.push_back(std::make_pair("", w));
+	doc.add_child("access_widths", widths);
+	{
+		hwio_bus_json bus(doc, HWIO_ACCESS_32 | HWIO_ACCESS_64);
+		for (auto d : bus._all_devices)
+			BOOST_CHECK_EQUAL(d->access_widths(),
+					HWIO_ACCESS_8 | HWIO_ACCESS_16);
+	}
+
+	w.put_value("128");
+	widths.push_back(std::make_pair("", w));
+	doc.put_child("access_widths", widths);
+	BOOST_CHECK_THROW(hwio_bus_json bus(doc), wrong_format);
 }
 
 }
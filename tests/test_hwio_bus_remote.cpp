@@ -4,12 +4,19 @@
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
 
 #include "hwio_bus_remote.h"
 #include "hwio_server.h"
 #include "hwio_bus_devicetree.h"
 #include "hwio_remote_utils.h"
 #include "hwio_device_remote.h"
+#include "hwio_batch.h"
+#include "hwio_shm_ring.h"
 #include "bus/hwio_bus_json.h"
 namespace utf = boost::unit_test;
 
@@ -136,9 +143,9 @@ void _test_device_rw(ihwio_dev * dev) {
 		BOOST_CHECK_EQUAL(dev->read8(i * sizeof(uint8_t)), 0);
 	}
 
-	//for (int i = 0; i < 32*2; i++) {
-	//	BOOST_CHECK_EQUAL(s0->read16(i * sizeof(uint16_t)) == 0, "read16 0");
-	//}
+	for (int i = 0; i < 32 * 2; i++) {
+		BOOST_CHECK_EQUAL(dev->read16(i * sizeof(uint16_t)), 0);
+	}
 
 	for (int i = 0; i < 32; i++) {
 		BOOST_CHECK_EQUAL(dev->read32(i * sizeof(uint32_t)), 0);
@@ -162,6 +169,11 @@ void _test_device_rw(ihwio_dev * dev) {
 		BOOST_CHECK_EQUAL(dev->read8(i * sizeof(uint8_t)), buff_ref[i]);
 	}
 
+	for (int i = 0; i < 32 * 2; i++) {
+		uint16_t tmp = reinterpret_cast<uint16_t*>(buff_ref)[i];
+		BOOST_CHECK_EQUAL(dev->read16(i * sizeof(uint16_t)), tmp);
+	}
+
 	for (int i = 0; i < 32; i++) {
 		uint32_t tmp = reinterpret_cast<uint32_t*>(buff_ref)[i];
 		BOOST_CHECK_EQUAL(dev->read32(i * sizeof(uint32_t)), tmp);
@@ -175,6 +187,9 @@ void _test_device_rw(ihwio_dev * dev) {
 	dev->read(0, buff, 32 * sizeof(uint32_t));
 	BOOST_CHECK_EQUAL(memcmp(buff, buff_ref, 32 * sizeof(uint32_t)), 0);
 
+	// unaligned access is split on server
+	dev->read(3, buff, 21);
+	BOOST_CHECK_EQUAL(memcmp(buff, buff_ref + 3, 21), 0);
 }
 
 BOOST_AUTO_TEST_SUITE(hwio_bus_remoteTC)
@@ -274,6 +289,574 @@ BOOST_AUTO_TEST_CASE(test_remote_call, * utf::timeout(15)) {
 }
 
 
+BOOST_AUTO_TEST_CASE(test_remote_rw_large, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server);
+	server_start_delay();
+
+	auto bus = make_unique<hwio_bus_remote>(server_addr);
+	hwio_comp_spec dev0("dev0,v-1.0.a");
+	auto devices = bus->find_devices((dev_spec_t ) { dev0 });
+	BOOST_CHECK_EQUAL(devices.size(), 1);
+	auto d = devices.at(0);
+	d->attach();
+
+	// larger than BUFFER_SIZE, split in to multiple frames
+	std::vector<uint8_t> ref(0x1000 - 3);
+	for (unsigned i = 0; i < ref.size(); i++)
+		ref[i] = i * 7 + 3;
+	d->write(3, &ref[0], ref.size());
+
+	std::vector<uint8_t> res(ref.size());
+	d->read(3, &res[0], res.size());
+	BOOST_CHECK(res == ref);
+
+	// error on the first chunk, the rest of chunks is canceled
+	// and the buffer is not used after read() has thrown
+	// (server closes the connection, bye() on destruction would SIGPIPE)
+	auto orig_sigpipe = signal(SIGPIPE, SIG_IGN);
+	{
+		hwio_bus_remote bus_err(server_addr);
+		auto d_err = dynamic_cast<hwio_device_remote *>(
+				bus_err.find_devices((dev_spec_t ) { dev0 }).at(0));
+		hwio_device_remote unallocated(*d_err);
+		unallocated.id = MAX_DEVICES - 1;
+		{
+			std::vector<uint8_t> tmp(ref.size());
+			BOOST_CHECK_THROW(unallocated.read(3, &tmp[0], tmp.size()),
+					hwio_error_rw);
+		}
+		BOOST_CHECK_THROW(unallocated.async_flush(), std::runtime_error);
+	}
+	signal(SIGPIPE, orig_sigpipe);
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_rmw, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server);
+	server_start_delay();
+
+	{
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		hwio_bus_remote bus(server_addr);
+		auto devices = bus.find_devices((dev_spec_t ) { dev0 });
+		BOOST_CHECK_EQUAL(devices.size(), 1);
+		auto d = devices.at(0);
+		d->attach();
+
+		d->write32(0, 0xff00ff00);
+		BOOST_CHECK_EQUAL(d->rmw32(0, 0x0000ffff, 0x12345678), 0xff00ff00);
+		BOOST_CHECK_EQUAL(d->read32(0), 0xff005678);
+		BOOST_CHECK_EQUAL(d->toggle_bits32(0, 0xf), 0xff005678);
+		BOOST_CHECK_EQUAL(d->read32(0), 0xff005677);
+		d->write64(8, 0);
+		d->set_bits64(8, 1ULL << 63);
+		BOOST_CHECK_EQUAL(d->read64(8), 1ULL << 63);
+
+		// clients modifying different bits of the same register
+		// do not overwrite each other
+		d->write32(4, 0);
+		std::vector<thread> clients;
+		for (unsigned i = 0; i < 4; i++) {
+			clients.push_back(thread([i, &dev0]() {
+				hwio_bus_remote bus(server_addr);
+				auto d = bus.find_devices((dev_spec_t ) { dev0 }).at(0);
+				for (unsigned i2 = 0; i2 < 200; i2++) {
+					d->set_bits32(4, 1 << i);
+					d->clear_bits32(4, 1 << (i + 8));
+					d->set_bits32(4, 1 << (i + 8));
+				}
+			}));
+		}
+		for (auto & c : clients)
+			c.join();
+		BOOST_CHECK_EQUAL(d->read32(4), 0x0f0f);
+	}
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_wait_until, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server);
+	server_start_delay();
+
+	{
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		hwio_bus_remote bus(server_addr);
+		auto d = bus.find_devices((dev_spec_t ) { dev0 }).at(0);
+		d->attach();
+
+		d->write32(0, 0x10);
+		BOOST_CHECK(d->wait_until(0, 0x10, 0x10, 0));
+		BOOST_CHECK(!d->wait_until(0, 0x1, 0x1, 0));
+		auto start = std::chrono::steady_clock::now();
+		BOOST_CHECK(!d->wait_until(0, 0x1, 0x1, 20000));
+		BOOST_CHECK(std::chrono::steady_clock::now() - start
+				>= std::chrono::milliseconds(20));
+
+		// the server polls the register while other clients are served
+		std::atomic<bool> other_done(false);
+		thread other([&dev0, &other_done]() {
+			hwio_bus_remote bus(server_addr);
+			auto d = bus.find_devices((dev_spec_t ) { dev0 }).at(0);
+			for (unsigned i = 0; i < 100; i++) {
+				d->write32(8, i);
+				BOOST_CHECK_EQUAL(d->read32(8), i);
+			}
+			other_done = true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			d->set_bits32(0, 0x1);
+		});
+		BOOST_CHECK(d->wait_until(0, 0x1, 0x1, 5000000));
+		BOOST_CHECK(other_done);
+		other.join();
+		// requests after the wait are processed after it
+		BOOST_CHECK_EQUAL(d->read32(0), 0x11);
+	}
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_program, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server);
+	server_start_delay();
+
+	{
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		hwio_bus_remote bus(server_addr);
+		auto d = bus.find_devices((dev_spec_t ) { dev0 }).at(0);
+		d->attach();
+
+		d->write32(0, 0);
+		d->write32(4, 0xab);
+		d->write32(8, 0);
+		// reset sequence executed by server in single request
+		hwio_program p;
+		p.write(0, 0x3);
+		p.poll(0, 0x1, 0x1, 1000);
+		p.read(4, 0);
+		p.write_slot(8, 0, 0xf0, 0x5);
+		p.set(1, 10);
+		size_t l = p.label();
+		p.rmw(12, 0xffffffff, 0, 2);
+		p.loop(1, l);
+		p.read(8, 3);
+		auto res = d->run_program(p);
+		BOOST_CHECK_EQUAL(res.status, HWIO_PROG_DONE);
+		BOOST_CHECK_EQUAL(res.pc, p.insns.size());
+		BOOST_CHECK_EQUAL(res.slots.size(), 4);
+		BOOST_CHECK_EQUAL(res.slots[0], 0xab);
+		BOOST_CHECK_EQUAL(res.slots[1], 0);
+		BOOST_CHECK_EQUAL(res.slots[3], 0xa5);
+		BOOST_CHECK_EQUAL(d->read32(8), 0xa5);
+		BOOST_CHECK_EQUAL(d->read32(12), 0);
+
+		hwio_program timeout;
+		timeout.poll(0, 0x4, 0x4, 1000);
+		timeout.write(0, 0);
+		res = d->run_program(timeout);
+		BOOST_CHECK_EQUAL(res.status, HWIO_PROG_TIMEOUT);
+		BOOST_CHECK_EQUAL(res.pc, 0);
+		BOOST_CHECK_EQUAL(d->read32(0), 0x3);
+
+		// largest program fits in to a single request
+		hwio_program large;
+		for (size_t i = 0; i < hwio_program::MAX_INSNS; i++)
+			large.read(4, i % hwio_program::MAX_SLOTS);
+		res = d->run_program(large);
+		BOOST_CHECK_EQUAL(res.status, HWIO_PROG_DONE);
+		BOOST_CHECK_EQUAL(res.slots.size(), hwio_program::MAX_SLOTS);
+		BOOST_CHECK_EQUAL(res.slots[1], 0xab);
+	}
+	// program which could block the server for too long is rejected
+	// (server closes the connection)
+	auto orig_sigpipe = signal(SIGPIPE, SIG_IGN);
+	{
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		hwio_bus_remote bus(server_addr);
+		auto d = bus.find_devices((dev_spec_t ) { dev0 }).at(0);
+		hwio_program long_poll;
+		for (int i = 0; i < 2; i++)
+			long_poll.poll(0, 0x4, 0x4,
+					HwioServer::DEFAULT_PROGRAM_MAX_POLL_TIME / 2 + 1);
+		BOOST_CHECK_THROW(d->run_program(long_poll), hwio_error_rw);
+	}
+	signal(SIGPIPE, orig_sigpipe);
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_batch, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server);
+	server_start_delay();
+
+	{
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		hwio_bus_remote bus(server_addr);
+		auto d = bus.find_devices((dev_spec_t ) { dev0 }).at(0);
+		d->attach();
+
+		// configuration of registers with reads of some of them
+		hwio_batch b(d);
+		uint32_t res[120];
+		for (uint32_t i = 0; i < 120; i++)
+			b.write32(i * sizeof(uint32_t), i * 3);
+		for (uint32_t i = 0; i < 120; i += 2)
+			b.read32(i * sizeof(uint32_t), &res[i]);
+		b.fill(0x400, 0x5a5a5a5a, sizeof(uint32_t), 64);
+		uint8_t filled[64];
+		b.read(0x400, filled, sizeof(filled));
+		b.flush();
+		for (uint32_t i = 0; i < 120; i += 2)
+			BOOST_CHECK_EQUAL(res[i], i * 3);
+		for (auto v : filled)
+			BOOST_CHECK_EQUAL(v, 0x5a);
+		BOOST_CHECK_EQUAL(d->read32(119 * sizeof(uint32_t)), 119 * 3);
+
+		// accesses larger than a single frame
+		std::vector<uint8_t> ref(3000), large(ref.size());
+		for (size_t i = 0; i < ref.size(); i++)
+			ref[i] = i * 13;
+		b.write(0x200, &ref[0], ref.size());
+		b.read(0x200, &large[0], large.size());
+		b.read32(0, &res[0]);
+		b.flush();
+		BOOST_CHECK(ref == large);
+		BOOST_CHECK_EQUAL(res[0], 0);
+
+		// error on server is reported by flush
+		b.fill(0, 0, 3, 6);
+		BOOST_CHECK_THROW(b.flush(), std::runtime_error);
+	}
+	// error in the first frame, the rest of frames is canceled
+	// (server closes the connection)
+	auto orig_sigpipe = signal(SIGPIPE, SIG_IGN);
+	{
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		hwio_bus_remote bus(server_addr);
+		auto d = dynamic_cast<hwio_device_remote *>(
+				bus.find_devices((dev_spec_t ) { dev0 }).at(0));
+		hwio_device_remote unallocated(*d);
+		unallocated.id = MAX_DEVICES - 1;
+		hwio_batch b(&unallocated);
+		std::vector<uint8_t> large(3 * BUFFER_SIZE);
+		b.read(0, &large[0], large.size());
+		BOOST_CHECK_THROW(b.flush(), hwio_error_rw);
+		BOOST_CHECK_THROW(unallocated.async_flush(), std::runtime_error);
+	}
+	signal(SIGPIPE, orig_sigpipe);
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_rx_wrap, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server);
+	server_start_delay();
+
+	auto bus = make_unique<hwio_bus_remote>(server_addr);
+	bus->max_in_flight(1024);
+	hwio_comp_spec dev0("dev0,v-1.0.a");
+	auto devices = bus->find_devices((dev_spec_t ) { dev0 });
+	BOOST_CHECK_EQUAL(devices.size(), 1);
+	auto d = dynamic_cast<hwio_device_remote *>(devices.at(0));
+	d->attach();
+
+	// pipelined requests of odd size wrap around the end of rx buffer
+	// of server multiple times
+	const unsigned N = 512;
+	std::vector<std::vector<uint8_t>> ref(N);
+	std::vector<std::vector<uint8_t>> res(N);
+	for (unsigned i = 0; i < N; i++) {
+		ref[i].resize(1000 + i % 13);
+		for (unsigned i2 = 0; i2 < ref[i].size(); i2++)
+			ref[i][i2] = i + i2;
+		res[i].resize(ref[i].size());
+		d->write_async(0, &ref[i][0], ref[i].size());
+		d->read_async(0, &res[i][0], res[i].size());
+	}
+	d->async_flush();
+	for (unsigned i = 0; i < N; i++)
+		BOOST_CHECK(res[i] == ref[i]);
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_rw_multiple, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server);
+	server_start_delay();
+
+	auto bus = make_unique<hwio_bus_remote>(server_addr);
+	hwio_comp_spec dev0("dev0,v-1.0.a");
+	auto devices = bus->find_devices((dev_spec_t ) { dev0 });
+	BOOST_CHECK_EQUAL(devices.size(), 1);
+	auto d = devices.at(0);
+	d->attach();
+	d->memset(0, 0, 0x1000);
+
+	// 400 scattered registers, does not fit in to single frame
+	const size_t N = 400;
+	uint32_t ref[N];
+	uint32_t res[N];
+	std::vector<hwio_iovec> wr, rd;
+	for (unsigned i = 0; i < N; i++) {
+		hwio_phys_addr_t offset = i * 2 * sizeof(uint32_t);
+		ref[i] = 0xab000000 | i;
+		res[i] = 0;
+		wr.push_back( { offset, &ref[i], sizeof(uint32_t) });
+		rd.push_back( { offset, &res[i], sizeof(uint32_t) });
+	}
+	d->writev(wr);
+	d->readv(rd);
+	for (unsigned i = 0; i < N; i++) {
+		BOOST_CHECK_EQUAL(res[i], ref[i]);
+		BOOST_CHECK_EQUAL(d->read32((i * 2 + 1) * sizeof(uint32_t)), 0);
+	}
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_keyhole, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server);
+	server_start_delay();
+
+	auto bus = make_unique<hwio_bus_remote>(server_addr);
+	hwio_comp_spec dev0("dev0,v-1.0.a");
+	auto devices = bus->find_devices((dev_spec_t ) { dev0 });
+	BOOST_CHECK_EQUAL(devices.size(), 1);
+	auto d = devices.at(0);
+	d->attach();
+	d->memset(0, 0, 0x100);
+
+	// larger than single frame
+	std::vector<uint32_t> data(2000);
+	for (unsigned i = 0; i < data.size(); i++)
+		data[i] = i + 1;
+	d->write_keyhole(0x10, &data[0], data.size() * sizeof(uint32_t),
+			sizeof(uint32_t));
+	BOOST_CHECK_EQUAL(d->read32(0x10), data.back());
+	BOOST_CHECK_EQUAL(d->read32(0x14), 0);
+
+	std::vector<uint32_t> res(data.size());
+	d->read_keyhole(0x10, &res[0], res.size() * sizeof(uint32_t),
+			sizeof(uint32_t));
+	for (auto r : res)
+		BOOST_CHECK_EQUAL(r, data.back());
+
+	// failed chunk cancels the rest (server closes the connection)
+	auto orig_sigpipe = signal(SIGPIPE, SIG_IGN);
+	{
+		hwio_bus_remote bus_err(server_addr);
+		auto d_err = dynamic_cast<hwio_device_remote *>(
+				bus_err.find_devices((dev_spec_t ) { dev0 }).at(0));
+		hwio_device_remote unallocated(*d_err);
+		unallocated.id = MAX_DEVICES - 1;
+		std::vector<uint32_t> tmp(data.size());
+		BOOST_CHECK_THROW(
+				unallocated.read_keyhole(0x10, &tmp[0],
+						tmp.size() * sizeof(uint32_t), sizeof(uint32_t)),
+				hwio_error_rw);
+		BOOST_CHECK_THROW(unallocated.async_flush(), std::runtime_error);
+	}
+	signal(SIGPIPE, orig_sigpipe);
+
+	d->fill(0x8, 0x1122334455667788, sizeof(uint64_t), 0x80);
+	BOOST_CHECK_EQUAL(d->read64(0x8), 0x1122334455667788);
+	BOOST_CHECK_EQUAL(d->read64(0x80), 0x1122334455667788);
+	BOOST_CHECK_EQUAL(d->read64(0x88), 0);
+	BOOST_CHECK_EQUAL(d->read64(0x0), 0);
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_async, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server_with_plugins0);
+	server_start_delay();
+
+	hwio_bus_remote bus(server_addr);
+	bus.max_in_flight(4);
+	hwio_comp_spec dev0("dev0,v-1.0.a");
+	auto devices = bus.find_devices((dev_spec_t ) { dev0 });
+	BOOST_CHECK_EQUAL(devices.size(), 1);
+	auto d = dynamic_cast<hwio_device_remote *>(devices.at(0));
+	d->attach();
+
+	uint32_t ref[64];
+	for (unsigned i = 0; i < 64; i++) {
+		ref[i] = i * 3 + 1;
+		d->write_async(i * sizeof(uint32_t), &ref[i], sizeof(uint32_t));
+	}
+
+	uint32_t res[64];
+	std::vector<hwio_async_token> tokens;
+	for (unsigned i = 0; i < 64; i++)
+		tokens.push_back(d->read_async(i * sizeof(uint32_t), &res[i], sizeof(uint32_t)));
+	// synchronous requests can be mixed with asynchronous ones
+	BOOST_CHECK_EQUAL(d->read32(0), ref[0]);
+	tokens.back().wait();
+	BOOST_CHECK(tokens.back().done());
+	d->async_flush();
+	for (unsigned i = 0; i < 64; i++)
+		BOOST_CHECK_EQUAL(res[i], ref[i]);
+
+	plugin_add_int_args args[8];
+	uint32_t rets[8];
+	for (unsigned i = 0; i < 8; i++) {
+		args[i] = {i, 10};
+		d->remote_call_async("add_int", &args[i], &rets[i]);
+	}
+	d->async_flush();
+	for (unsigned i = 0; i < 8; i++)
+		BOOST_CHECK_EQUAL(rets[i], i + 10);
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_async_cancel, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server);
+	server_start_delay();
+
+	hwio_bus_remote bus(server_addr);
+	hwio_comp_spec dev0("dev0,v-1.0.a");
+	auto devices = bus.find_devices((dev_spec_t ) { dev0 });
+	BOOST_CHECK_EQUAL(devices.size(), 1);
+	auto d = dynamic_cast<hwio_device_remote *>(devices.at(0));
+	d->attach();
+	d->write32(0x10, 0x12345678);
+
+	std::vector<uint32_t> kept(8, 0xaaaaaaaa);
+	std::vector<hwio_async_token> tokens;
+	{
+		auto canceled = make_unique<uint32_t[]>(8);
+		for (unsigned i = 0; i < 8; i++) {
+			tokens.push_back(d->read_async(0x10, &canceled[i], sizeof(uint32_t)));
+			d->read_async(0x10, &kept[i], sizeof(uint32_t));
+		}
+		for (auto & t : tokens)
+			t.cancel();
+		// buffer of canceled requests is released before responses arrive
+	}
+	// responses of canceled requests are dropped, the rest is completed
+	BOOST_CHECK_EQUAL(d->read32(0x10), 0x12345678);
+	d->async_flush();
+	for (auto & t : tokens)
+		BOOST_CHECK(t.done());
+	for (auto k : kept)
+		BOOST_CHECK_EQUAL(k, 0x12345678);
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
+/*
+ * Send whole buffer or receive exactly size bytes on blocking socket
+ * */
+static bool raw_send(int fd, const void * data, size_t size) {
+	return send(fd, data, size, MSG_NOSIGNAL) == ssize_t(size);
+}
+static bool raw_recv(int fd, void * data, size_t size) {
+	auto d = reinterpret_cast<uint8_t *>(data);
+	while (size) {
+		ssize_t r = recv(fd, d, size, 0);
+		if (r <= 0)
+			return false;
+		d += r;
+		size -= r;
+	}
+	return true;
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_pipelined_tags, * utf::timeout(15)) {
+	run_server_flag = true;
+	thread server_thread(run_server);
+	server_start_delay();
+
+	const unsigned N = 32;
+	{
+		hwio_bus_remote bus(server_addr);
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		auto d = bus.find_devices((dev_spec_t ) { dev0 }).at(0);
+		for (unsigned i = 0; i < N; i++)
+			d->write32(i * sizeof(uint32_t), 0x1000 + i);
+		// writes do not have response, read waits until they are processed
+		BOOST_CHECK_EQUAL(d->read32(0), 0x1000);
+
+		// raw client, all requests are sent by a single send
+		int fd = tcp_open(server_addr);
+
+		HwioFrame<DevQuery> q = { };
+		q.header.command = HWIO_CMD_QUERY;
+		q.header.body_len = sizeof(Dev_query_item);
+		strcpy(q.body.items[0].vendor_name, dev0.vendor.c_str());
+		strcpy(q.body.items[0].type_name, dev0.type.c_str());
+		q.body.items[0].version = dev0.version;
+		BOOST_REQUIRE(raw_send(fd, &q, sizeof(q.header) + q.header.body_len));
+		Hwio_packet_header h;
+		BOOST_REQUIRE(raw_recv(fd, &h, sizeof(h)));
+		BOOST_REQUIRE_EQUAL(h.command, HWIO_CMD_QUERY_RESP);
+		BOOST_REQUIRE_EQUAL(h.body_len, sizeof(dev_id_t));
+		dev_id_t id;
+		BOOST_REQUIRE(raw_recv(fd, &id, sizeof(id)));
+
+		std::vector<HwioFrame<RdReq>> reqs(N);
+		for (unsigned i = 0; i < N; i++) {
+			reqs[i].header.command = HWIO_CMD_READ;
+			reqs[i].header.body_len = sizeof(RdReq);
+			reqs[i].header.tag = i + 1;
+			reqs[i].body.devId = id;
+			reqs[i].body.addr = i * sizeof(uint32_t);
+			reqs[i].body.size = sizeof(uint32_t);
+		}
+		BOOST_REQUIRE(raw_send(fd, reqs.data(), N * sizeof(reqs[0])));
+
+		// responses are in order of requests and carry their tags
+		for (unsigned i = 0; i < N; i++) {
+			struct PACKED {
+				Hwio_packet_header header;
+				uint32_t value;
+			} resp;
+			BOOST_REQUIRE(raw_recv(fd, &resp, sizeof(resp)));
+			BOOST_CHECK_EQUAL(resp.header.command, HWIO_CMD_READ_RESP);
+			BOOST_CHECK_EQUAL(resp.header.body_len, sizeof(uint32_t));
+			BOOST_CHECK_EQUAL(resp.header.tag, i + 1);
+			BOOST_CHECK_EQUAL(resp.value, 0x1000 + i);
+		}
+		close(fd);
+	}
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+}
+
 BOOST_AUTO_TEST_CASE(test_remote_server_stability, * utf::timeout(15)) {
 	run_server_flag = true;
 	thread server_thread(run_server_with_plugins0);
@@ -333,6 +916,536 @@ void serve_clients(server_thread_args_t * args) {
 	}
 }
 
+BOOST_AUTO_TEST_CASE(test_remote_unix_socket, * utf::timeout(15)) {
+	spot_dev_mem_file();
+	run_server_flag = true;
+
+	const char * unix_addr = "unix:/tmp/hwio_test_server.sock";
+	hwio_bus_json bus_on_server_json(
+			"test_samples/device_descriptions/simple.json");
+	struct addrinfo * addr = parse_addr(unix_addr);
+	HwioServer server(addr, { &bus_on_server_json });
+	server.prepare_server_socket();
+	server_thread_args_t args =  {&server, &run_server_flag};
+	thread server_thread(serve_clients, &args);
+	server_start_delay();
+
+	{
+		hwio_bus_remote bus(unix_addr);
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		auto devices = bus.find_devices((dev_spec_t ) { dev0 });
+		BOOST_CHECK_EQUAL(devices.size(), 1);
+		auto d = devices.at(0);
+		d->attach();
+		_test_device_rw(d);
+	}
+	{
+		// socket of running server is not removed by other server
+		HwioServer other(addr, { &bus_on_server_json });
+		BOOST_CHECK_THROW(other.prepare_server_socket(), std::runtime_error);
+		hwio_client_to_server_con con(unix_addr);
+		con.connect_to_server();
+		BOOST_CHECK_EQUAL(con.ping(), 0);
+	}
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+
+	{
+		// file which is not a socket is never removed
+		const char * file_addr = "unix:/tmp/hwio_test_server.file";
+		ofstream("/tmp/hwio_test_server.file") << "data";
+		struct addrinfo * file_addrinfo = parse_addr(file_addr);
+		{
+			HwioServer other(file_addrinfo, { &bus_on_server_json });
+			BOOST_CHECK_THROW(other.prepare_server_socket(),
+					std::runtime_error);
+		}
+		BOOST_CHECK_EQUAL(access("/tmp/hwio_test_server.file", F_OK), 0);
+		unlink("/tmp/hwio_test_server.file");
+		free_addr(file_addrinfo);
+	}
+	{
+		// socket left by crashed server is replaced
+		int s = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink("/tmp/hwio_test_server_stale.sock");
+		struct addrinfo * stale_addr = parse_addr(
+				"unix:/tmp/hwio_test_server_stale.sock");
+		BOOST_CHECK_EQUAL(bind(s, stale_addr->ai_addr, stale_addr->ai_addrlen),
+				0);
+		close(s);
+		{
+			HwioServer other(stale_addr, { &bus_on_server_json });
+			BOOST_CHECK_NO_THROW(other.prepare_server_socket());
+		}
+		free_addr(stale_addr);
+	}
+	free_addr(addr);
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_shm, * utf::timeout(15)) {
+	spot_dev_mem_file();
+	run_server_flag = true;
+
+	const char * unix_addr = "unix:/tmp/hwio_test_server_shm.sock";
+	const char * shm_addr = "shm:/tmp/hwio_test_server_shm.sock";
+	hwio_bus_json bus_on_server_json(
+			"test_samples/device_descriptions/simple.json");
+	struct addrinfo * addr = parse_addr(unix_addr);
+	HwioServer server(addr, { &bus_on_server_json });
+	server.prepare_server_socket();
+	server_thread_args_t args =  {&server, &run_server_flag};
+	thread server_thread(serve_clients, &args);
+	server_start_delay();
+
+	{
+		// shared memory client next to the socket client
+		hwio_bus_remote bus_sock(unix_addr);
+		hwio_bus_remote bus(shm_addr);
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		auto devices = bus.find_devices((dev_spec_t ) { dev0 });
+		BOOST_CHECK_EQUAL(devices.size(), 1);
+		auto d = dynamic_cast<hwio_device_remote *>(devices.at(0));
+		d->attach();
+		_test_device_rw(d);
+
+		// larger than single frame and pipelined requests
+		std::vector<uint8_t> ref(2 * BUFFER_SIZE), res(ref.size());
+		for (size_t i = 0; i < ref.size(); i++)
+			ref[i] = i * 7;
+		d->write(0, &ref[0], ref.size());
+		d->read(0, &res[0], res.size());
+		BOOST_CHECK(ref == res);
+
+		uint32_t vals[64];
+		for (unsigned i = 0; i < 64; i++)
+			d->read_async(i * sizeof(uint32_t), &vals[i], sizeof(uint32_t));
+		d->async_flush();
+		BOOST_CHECK(memcmp(vals, &ref[0], sizeof(vals)) == 0);
+
+		// wait polled by server is completed by the socket client
+		d->write32(0, 0);
+		thread setter([&bus_sock, &dev0]() {
+			auto d = bus_sock.find_devices((dev_spec_t ) { dev0 }).at(0);
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			d->write32(0, 0x2);
+		});
+		BOOST_CHECK(d->wait_until(0, 0x2, 0x2, 5000000));
+		setter.join();
+		BOOST_CHECK(!d->wait_until(0, 0x1, 0x1, 1000));
+		BOOST_CHECK_EQUAL(d->read32(0), 0x2);
+
+		BOOST_CHECK_EQUAL(server.get_client_cnt(), 2);
+	}
+	usleep(100000);
+	BOOST_CHECK_EQUAL(server.get_client_cnt(), 0);
+
+	{
+		// responses which do not fit in to the response ring wait in server,
+		// other clients are served until the client reads them
+		hwio_bus_remote bus_sock(unix_addr);
+		hwio_bus_remote bus(shm_addr);
+		bus.max_in_flight(256);
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		auto d = dynamic_cast<hwio_device_remote *>(
+				bus.find_devices((dev_spec_t ) { dev0 }).at(0));
+		auto d_sock = bus_sock.find_devices((dev_spec_t ) { dev0 }).at(0);
+		std::vector<uint8_t> ref(2000);
+		for (size_t i = 0; i < ref.size(); i++)
+			ref[i] = i * 3;
+		d->write(0, &ref[0], ref.size());
+		std::vector<std::vector<uint8_t>> res(256,
+				std::vector<uint8_t>(ref.size()));
+		for (auto & r : res)
+			d->read_async(0, &r[0], r.size());
+		usleep(10000);
+
+		auto start = chrono::steady_clock::now();
+		uint32_t ref0;
+		memcpy(&ref0, &ref[0], sizeof(ref0));
+		BOOST_CHECK_EQUAL(d_sock->read32(0), ref0);
+		auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+				chrono::steady_clock::now() - start).count();
+		BOOST_CHECK_LT(elapsed, 100);
+
+		d->async_flush();
+		for (auto & r : res)
+			BOOST_CHECK(r == ref);
+		BOOST_CHECK_EQUAL(server.get_client_cnt(), 2);
+	}
+	usleep(100000);
+	BOOST_CHECK_EQUAL(server.get_client_cnt(), 0);
+
+	{
+		// shm with other size than the rings is not mapped
+		size_t ring_size = 4096;
+		for (size_t size : { size_t(0), hwio_shm_ring::mem_size(ring_size),
+				4 * hwio_shm_ring::mem_size(ring_size) }) {
+			FILE * f = tmpfile();
+			BOOST_REQUIRE(f != nullptr);
+			BOOST_CHECK_EQUAL(ftruncate(fileno(f), size), 0);
+			BOOST_CHECK_THROW(
+					hwio_shm_channel(dup(fileno(f)), eventfd(0, EFD_CLOEXEC),
+							eventfd(0, EFD_CLOEXEC), ring_size),
+					std::runtime_error);
+			fclose(f);
+		}
+		hwio_shm_channel ch(ring_size);
+		BOOST_CHECK(fcntl(ch.get_mem_fd(), F_GETFD) & FD_CLOEXEC);
+	}
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+	free_addr(addr);
+}
+
+void _sleep_ms(ihwio_dev * dev, uint32_t * ms, uint32_t * ret) {
+	usleep(*ms * 1000);
+	*ret = *ms;
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_workers, * utf::timeout(15)) {
+	spot_dev_mem_file();
+	run_server_flag = true;
+
+	hwio_bus_devicetree bus_on_server("test_samples/device-tree0_32b",
+			"test_samples/mem0.dat");
+	hwio_bus_json bus_on_server_json(
+			"test_samples/device_descriptions/simple.json");
+	struct addrinfo * addr = parse_ip_and_port(server_addr);
+	HwioServer server(addr, { &bus_on_server, &bus_on_server_json });
+	server.install_plugin_fn<uint32_t, uint32_t>("sleep_ms", _sleep_ms);
+	server.prepare_server_socket();
+	server.start_workers(4);
+	server_thread_args_t args =  {&server, &run_server_flag};
+	thread server_thread(serve_clients, &args);
+	server_start_delay();
+
+	{
+		// long call on serial device does not block the access to dev0
+		bool slow_call_done = false;
+		thread slow_client([&slow_call_done]() {
+			hwio_bus_remote bus(server_addr);
+			hwio_comp_spec serial_name;
+			serial_name.name_set("serial@84000000");
+			auto devices = bus.find_devices((dev_spec_t ) { serial_name });
+			BOOST_CHECK_EQUAL(devices.size(), 1);
+			auto d = dynamic_cast<hwio_device_remote *>(devices.at(0));
+			d->attach();
+			uint32_t ms = 500;
+			BOOST_CHECK_EQUAL((d->remote_call<uint32_t, uint32_t>("sleep_ms", &ms)), ms);
+			slow_call_done = true;
+		});
+		usleep(100000);
+
+		hwio_bus_remote bus(server_addr);
+		auto devices = bus.find_devices((dev_spec_t ) { hwio_comp_spec("dev0,v-1.0.a") });
+		BOOST_CHECK_EQUAL(devices.size(), 1);
+		auto d = dynamic_cast<hwio_device_remote *>(devices.at(0));
+		d->attach();
+		_test_device_rw(d);
+		BOOST_CHECK(!slow_call_done);
+
+		// requests on the same device are executed in order
+		uint32_t res[64];
+		for (uint32_t i = 0; i < 64; i++) {
+			d->write_async(0, &i, sizeof(i));
+			d->read_async(0, &res[i], sizeof(res[i]));
+		}
+		d->async_flush();
+		for (uint32_t i = 0; i < 64; i++)
+			BOOST_CHECK_EQUAL(res[i], i);
+
+		slow_client.join();
+		BOOST_CHECK(slow_call_done);
+	}
+	{
+		// wait_until is executed by the thread with poll, but not before
+		// the requests of other clients on the device are completed
+		std::atomic<bool> slow_call_done(false);
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		thread slow_client([&slow_call_done, &dev0]() {
+			hwio_bus_remote bus(server_addr);
+			auto d = dynamic_cast<hwio_device_remote *>(
+					bus.find_devices((dev_spec_t ) { dev0 }).at(0));
+			uint32_t ms = 300;
+			d->remote_call<uint32_t, uint32_t>("sleep_ms", &ms);
+			slow_call_done = true;
+		});
+		usleep(100000);
+
+		hwio_bus_remote bus(server_addr);
+		auto d = dynamic_cast<hwio_device_remote *>(
+				bus.find_devices((dev_spec_t ) { dev0 }).at(0));
+		auto start = chrono::steady_clock::now();
+		d->wait_until(0, 0, 0, 0);
+		auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+				chrono::steady_clock::now() - start).count();
+		BOOST_CHECK_GE(elapsed, 150);
+		slow_client.join();
+		BOOST_CHECK(slow_call_done);
+	}
+	{
+		// the request which waits on busy device does not block
+		// the thread with poll, clients of other devices are served
+		std::atomic<bool> slow_call_done(false);
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		thread slow_client([&slow_call_done, &dev0]() {
+			hwio_bus_remote bus(server_addr);
+			auto d = dynamic_cast<hwio_device_remote *>(
+					bus.find_devices((dev_spec_t ) { dev0 }).at(0));
+			uint32_t ms = 300;
+			d->remote_call<uint32_t, uint32_t>("sleep_ms", &ms);
+			slow_call_done = true;
+		});
+		usleep(100000);
+		thread waiting_client([&dev0]() {
+			hwio_bus_remote bus(server_addr);
+			auto d = bus.find_devices((dev_spec_t ) { dev0 }).at(0);
+			d->wait_until(0, 0, 0, 0);
+		});
+		usleep(20000);
+
+		hwio_comp_spec serial_name;
+		serial_name.name_set("serial@88000000");
+		auto start = chrono::steady_clock::now();
+		hwio_bus_remote bus(server_addr);
+		auto d = dynamic_cast<hwio_device_remote *>(
+				bus.find_devices((dev_spec_t ) { serial_name }).at(0));
+		uint32_t ms = 0;
+		d->remote_call<uint32_t, uint32_t>("sleep_ms", &ms);
+		auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+				chrono::steady_clock::now() - start).count();
+		BOOST_CHECK_LT(elapsed, 100);
+		BOOST_CHECK(!slow_call_done);
+		waiting_client.join();
+		BOOST_CHECK(slow_call_done);
+		slow_client.join();
+	}
+	usleep(100000);
+	BOOST_CHECK_EQUAL(server.get_client_cnt(), 0);
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+	freeaddrinfo(addr);
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_edge_triggered, * utf::timeout(15)) {
+	spot_dev_mem_file();
+	run_server_flag = true;
+
+	hwio_bus_json bus_on_server_json(
+			"test_samples/device_descriptions/simple.json");
+	struct addrinfo * addr = parse_ip_and_port(server_addr);
+	HwioServer server(addr, { &bus_on_server_json });
+	server.edge_triggered = true;
+	server.prepare_server_socket();
+	// server sleeps until some event, wakeup() is used to stop it
+	thread server_thread([&server]() {
+		while (run_server_flag)
+			server.pool_client_msgs(-1);
+	});
+	server_start_delay();
+
+	std::vector<hwio_bus_remote*> buses;
+	std::vector<ihwio_dev*> devs;
+	for (int i = 0; i < 100; i++) {
+		auto bus = new hwio_bus_remote(server_addr);
+		buses.push_back(bus);
+		auto devices = bus->find_devices((dev_spec_t ) { hwio_comp_spec("dev0,v-1.0.a") });
+		BOOST_CHECK_EQUAL(devices.size(), 1);
+		devs.push_back(devices.at(0));
+		devs.back()->attach();
+	}
+	BOOST_CHECK_EQUAL(server.get_client_cnt(), buses.size());
+	for (uint32_t i = 0; i < devs.size(); i++)
+		devs[i]->write32(i * sizeof(uint32_t), i);
+	for (uint32_t i = 0; i < devs.size(); i++)
+		BOOST_CHECK_EQUAL(devs[(i + 1) % devs.size()]->read32(i * sizeof(uint32_t)), i);
+	_test_device_rw(devs[0]);
+
+	for (auto bus : buses)
+		delete bus;
+	usleep(100000);
+	BOOST_CHECK_EQUAL(server.get_client_cnt(), 0);
+
+	run_server_flag = false;
+	server.wakeup();
+	server_thread.join();
+	server_stop_delay();
+	freeaddrinfo(addr);
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_busy_poll, * utf::timeout(15)) {
+	spot_dev_mem_file();
+	run_server_flag = true;
+
+	hwio_bus_json bus_on_server_json(
+			"test_samples/device_descriptions/simple.json");
+	struct addrinfo * addr = parse_ip_and_port(server_addr);
+	HwioServer server(addr, { &bus_on_server_json });
+	server.prepare_server_socket();
+
+	// pin to some cpu which we are allowed to use
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	BOOST_CHECK_EQUAL(sched_getaffinity(0, sizeof(cpus), &cpus), 0);
+	HwioServer::busy_poll_cfg_t cfg;
+	for (int i = 0; i < CPU_SETSIZE; i++) {
+		if (CPU_ISSET(i, &cpus)) {
+			cfg.cpu = i;
+			break;
+		}
+	}
+	cfg.socket_busy_poll_us = 50;
+	thread server_thread([&server, &cfg]() {
+		server.enable_busy_poll(cfg);
+		while (run_server_flag)
+			server.pool_client_msgs(-1);
+	});
+	server_start_delay();
+
+	{
+		hwio_bus_remote bus(server_addr);
+		auto devices = bus.find_devices((dev_spec_t ) { hwio_comp_spec("dev0,v-1.0.a") });
+		BOOST_CHECK_EQUAL(devices.size(), 1);
+		auto d = devices.at(0);
+		d->attach();
+		_test_device_rw(d);
+	}
+
+	auto stats = server.get_busy_poll_stats();
+	BOOST_CHECK(stats.polls > stats.empty_polls);
+	BOOST_CHECK(stats.empty_polls > 0);
+	BOOST_CHECK(stats.spin_ns > 0);
+	BOOST_CHECK(stats.busy_ns > 0);
+
+	run_server_flag = false;
+	server.wakeup();
+	server_thread.join();
+	server_stop_delay();
+	freeaddrinfo(addr);
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_low_latency, * utf::timeout(15)) {
+	spot_dev_mem_file();
+	run_server_flag = true;
+
+	hwio_bus_json bus_on_server_json(
+			"test_samples/device_descriptions/simple.json");
+	struct addrinfo * addr = parse_ip_and_port(server_addr);
+	HwioServer server(addr, { &bus_on_server_json });
+	server.latency = HWIO_LATENCY_LOW;
+	server.prepare_server_socket();
+	server_thread_args_t args =  {&server, &run_server_flag};
+	thread server_thread(serve_clients, &args);
+	server_start_delay();
+
+	{
+		hwio_bus_remote bus(server_addr, HWIO_LATENCY_LOW);
+		auto devices = bus.find_devices((dev_spec_t ) { hwio_comp_spec("dev0,v-1.0.a") });
+		BOOST_CHECK_EQUAL(devices.size(), 1);
+		auto d = dynamic_cast<hwio_device_remote *>(devices.at(0));
+		d->attach();
+
+		// write without response followed by read does not wait
+		// on delayed ACK
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < 200; i++) {
+			d->write32(0, i);
+			BOOST_CHECK_EQUAL(d->read32(0), i);
+		}
+		BOOST_CHECK(std::chrono::steady_clock::now() - start
+				< std::chrono::seconds(2));
+
+		// explicit batch is sent at once
+		uint32_t res[64];
+		bus.batch_begin();
+		for (uint32_t i = 0; i < 64; i++) {
+			d->write_async(i * sizeof(uint32_t), &i, sizeof(i));
+			d->read_async(i * sizeof(uint32_t), &res[i], sizeof(res[i]));
+		}
+		bus.batch_end();
+		d->async_flush();
+		for (uint32_t i = 0; i < 64; i++)
+			BOOST_CHECK_EQUAL(res[i], i);
+
+		// waiting on response ends the batch
+		bus.batch_begin();
+		d->write32(4, 0x1234);
+		BOOST_CHECK_EQUAL(d->read32(4), 0x1234);
+	}
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+	freeaddrinfo(addr);
+}
+
+BOOST_AUTO_TEST_CASE(test_remote_slow_reader, * utf::timeout(15)) {
+	spot_dev_mem_file();
+	run_server_flag = true;
+
+	hwio_bus_json bus_on_server_json(
+			"test_samples/device_descriptions/simple.json");
+	struct addrinfo * addr = parse_ip_and_port(server_addr);
+	HwioServer server(addr, { &bus_on_server_json });
+	server.tx_high_water = 16 * 1024;
+	server.prepare_server_socket();
+	server_thread_args_t args =  {&server, &run_server_flag};
+	thread server_thread(serve_clients, &args);
+	server_start_delay();
+
+	{
+		hwio_comp_spec dev0("dev0,v-1.0.a");
+		hwio_bus_remote slow_bus(server_addr);
+		slow_bus.max_in_flight(4096);
+		auto slow_devs = slow_bus.find_devices((dev_spec_t ) { dev0 });
+		BOOST_CHECK_EQUAL(slow_devs.size(), 1);
+		auto slow = dynamic_cast<hwio_device_remote *>(slow_devs.at(0));
+		slow->attach();
+
+		std::vector<uint8_t> ref(1024);
+		for (unsigned i = 0; i < ref.size(); i++)
+			ref[i] = i * 3 + 1;
+		slow->write(0, &ref[0], ref.size());
+
+		// responses do not fit in to socket buffers, the client does not
+		// read them yet
+		std::vector<std::vector<uint8_t>> res(4096,
+				std::vector<uint8_t>(ref.size()));
+		for (auto & r : res)
+			slow->read_async(0, &r[0], r.size());
+
+		// other clients are not affected
+		hwio_bus_remote bus(server_addr);
+		auto devices = bus.find_devices((dev_spec_t ) { dev0 });
+		BOOST_CHECK_EQUAL(devices.size(), 1);
+		auto d = devices.at(0);
+		d->attach();
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < 100; i++)
+			BOOST_CHECK_EQUAL(d->read32(0), 0x0a070401);
+		BOOST_CHECK(std::chrono::steady_clock::now() - start
+				< std::chrono::seconds(1));
+
+		// all responses of the slow client are delivered
+		slow->async_flush();
+		for (auto & r : res)
+			BOOST_CHECK(r == ref);
+	}
+	usleep(100000);
+	BOOST_CHECK_EQUAL(server.get_client_cnt(), 0);
+
+	run_server_flag = false;
+	server_thread.join();
+	server_stop_delay();
+	freeaddrinfo(addr);
+}
+
 BOOST_AUTO_TEST_CASE(clients_are_disconnecting_correctly, * utf::timeout(5)) {
 	spot_dev_mem_file();
 	run_server_flag = true;
@@ -5,6 +5,7 @@
 
 #include "../tests/test_utils.h"
 #include "hwio_comp_spec.h"
+#include "hwio_comp_spec_literal.h"
 
 
 namespace hwio {
@@ -83,4 +84,73 @@ BOOST_AUTO_TEST_CASE(test_use_vendor_type_version) {
 	test_version(spec.version, 1, 0, 'a');
 }
 
+BOOST_AUTO_TEST_CASE(test_use_vendor_and_type_without_hyphen) {
+	hwio_comp_spec spec("xlnx,uartlite");
+
+	BOOST_CHECK_EQUAL(spec.vendor, "xlnx");
+	BOOST_CHECK_EQUAL(spec.type, "uartlite");
+	test_version(spec.version, HWIO_VERSION_NA, HWIO_VERSION_NA,
+			HWIO_VERSION_NA);
+}
+
+// parsing in compile time
+constexpr auto axi_dma = hwio_comp_spec_parse("xlnx,axi-dma-1.00.a", 19);
+static_assert(axi_dma.valid, "");
+static_assert(axi_dma.vendor_len == 4 && axi_dma.type_off == 5
+		&& axi_dma.type_len == 7, "");
+static_assert(axi_dma.version_major == 1 && axi_dma.version_minor == 0
+		&& axi_dma.version_subminor == 'a', "");
+static_assert(hwio_comp_spec_parse("xlnx,axi-dma-x.0", 16).type_len == 11, "");
+static_assert(hwio_comp_spec_parse("dma-1.2.13", 10).version_subminor == 13, "");
+static_assert(!hwio_comp_spec_parse(",axi-dma-1.0", 12).valid, "");
+static_assert(!hwio_comp_spec_parse("xlnx,-1.0", 9).valid, "");
+static_assert(!hwio_comp_spec_parse("xlnx, dma", 9).valid, "");
+static_assert(!hwio_comp_spec_parse("", 0).valid, "");
+
+BOOST_AUTO_TEST_CASE(test_literal_same_as_runtime) {
+	const char * strs[] = { "testing-type", "test-vendor,testing-type",
+			"testing-type-1.0.a", "test-vendor,testing-type-1.0.a",
+			"xlnx,uartlite", "xlnx,xps-uartlite-1.1.97", "a-b,c", "t-1.2",
+			"v,t-1.2.x2", "simple-bus" };
+	for (auto str : strs) {
+		hwio_comp_spec rt(str);
+		hwio_comp_spec lit(
+				hwio_spec_literal(hwio_comp_spec_parse(str, strlen(str))));
+		BOOST_CHECK_EQUAL(rt.vendor, lit.vendor);
+		BOOST_CHECK_EQUAL(rt.type, lit.type);
+		test_version(rt.version, lit.version.major, lit.version.minor,
+				lit.version.subminor);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_literal) {
+	auto & s0 = "xlnx,axi-dma-1.00.a"_hwio_spec;
+	auto & s1 = "xlnx,axi-dma-1.00.a"_hwio_spec;
+	auto & s2 = "xlnx,axi-dma"_hwio_spec;
+	auto & s3 = "axi-dma-1.00"_hwio_spec;
+
+	// atoms are shared between literals
+	BOOST_CHECK(&s0 == &s1);
+	BOOST_CHECK(s0.vendor == s2.vendor);
+	BOOST_CHECK(s0.type == s2.type);
+	BOOST_CHECK(s0.type == s3.type);
+	BOOST_CHECK(s3.vendor.empty());
+	BOOST_CHECK(s0.type == hwio_atom::intern(std::string("axi-dma")));
+	BOOST_CHECK_EQUAL(s0.type.str(), "axi-dma");
+	test_version(s0.version, 1, 0, 'a');
+
+	hwio_atom a;
+	BOOST_CHECK(!hwio_atom::find("never-interned-string", a));
+	BOOST_CHECK(hwio_atom::find("xlnx", a));
+	BOOST_CHECK(a == s0.vendor);
+
+	// versions of literal are the pattern
+	BOOST_CHECK(s2.matches(s0.vendor, s0.type, s0.version));
+	BOOST_CHECK(s3.matches(s0.vendor, s0.type, hwio_version(1, 0, 1)));
+	BOOST_CHECK(!s0.matches(s0.vendor, s0.type, hwio_version(1, 0, 1)));
+
+	hwio_comp_spec cs(s0);
+	BOOST_CHECK_EQUAL(cs, hwio_comp_spec("xlnx,axi-dma-1.00.a"));
+}
+
 }
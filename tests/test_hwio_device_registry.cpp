@@ -0,0 +1,131 @@
+#define BOOST_TEST_MODULE "Tests of hwio_device_registry"
+#include <boost/test/unit_test.hpp>
+
+#include "hwio_device_registry.h"
+#include "hwio_bus_primitive.h"
+#include "hwio_bus_devicetree.h"
+#include "hwio_device_mmap.h"
+#include <memory>
+
+namespace hwio {
+
+typedef std::vector<hwio_comp_spec> dev_spec_t;
+
+BOOST_AUTO_TEST_CASE(test_registry_same_as_filter) {
+	// devices and queries with all combinations of name, vendor, type
+	// and version wildcards
+	const char * names[] = { "", "dev0", "dev1" };
+	const char * vendors[] = { "", "v0", "v1" };
+	const char * types[] = { "", "t0", "t1" };
+	hwio_version versions[] = { { }, { 1 }, { 1, 0 }, { 1, 2, 3 } };
+	dev_spec_t specs;
+	for (auto n : names)
+		for (auto v : vendors)
+			for (auto t : types)
+				for (auto & ver : versions) {
+					hwio_comp_spec s(v, t, ver);
+					s.name_set(n);
+					specs.push_back(s);
+				}
+
+	std::vector<std::unique_ptr<hwio_device_mmap>> devs_owner;
+	std::vector<ihwio_dev *> devs;
+	for (size_t i = 0; i < specs.size(); i++) {
+		dev_spec_t ds = { specs[i], specs[(i * 7) % specs.size()] };
+		devs_owner.emplace_back(new hwio_device_mmap(ds, i * 0x100, 0x100));
+		devs.push_back(devs_owner.back().get());
+	}
+	// devices without spec are found by name only
+	for (auto n : names) {
+		devs_owner.emplace_back(new hwio_device_mmap(dev_spec_t(), 0, 0x100));
+		devs_owner.back()->name(n);
+		devs.push_back(devs_owner.back().get());
+	}
+
+	hwio_device_registry reg;
+	reg.build(devs);
+	// result buffer reused by all lookups
+	std::vector<ihwio_dev *> out;
+	for (size_t i = 0; i < specs.size(); i++) {
+		dev_spec_t q = { specs[i] };
+		auto expected = ihwio_bus::filter_device_by_spec(devs, q);
+		auto res = reg.find(q);
+		BOOST_CHECK(res == expected);
+
+		q.push_back(specs[(i * 13) % specs.size()]);
+		expected = ihwio_bus::filter_device_by_spec(devs, q);
+		res = reg.find(q);
+		BOOST_CHECK(res == expected);
+		reg.find(q, out);
+		BOOST_CHECK(out == expected);
+
+		// literals have no name, atoms are compared
+		if (specs[i].name == "") {
+			hwio_comp_spec_view v = { "", 0, 0, 0, 0, specs[i].version.major,
+					specs[i].version.minor, specs[i].version.subminor, true };
+			hwio_spec_literal lit(v);
+			lit.vendor = hwio_atom::intern(specs[i].vendor);
+			lit.type = hwio_atom::intern(specs[i].type);
+			BOOST_CHECK(
+					reg.find(std::vector<hwio_spec_literal> { lit })
+							== ihwio_bus::filter_device_by_spec(devs,
+									dev_spec_t { specs[i] }));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_registry_unknown_vendor_type) {
+	hwio_device_mmap d0(hwio_comp_spec("v0", "t0", { 1 }), 0, 4);
+	hwio_device_mmap d1(hwio_comp_spec("", "t1", { 1 }), 0, 4);
+	hwio_device_mmap d2(hwio_comp_spec("v0", "", { 1 }), 0, 4);
+	std::vector<ihwio_dev *> devs = { &d0, &d1, &d2 };
+	hwio_device_registry reg;
+	reg.build(devs);
+	dev_spec_t queries = { hwio_comp_spec("not-interned-vendor", "", { 1 }),
+			hwio_comp_spec("", "not-interned-type", { 1 }),
+			hwio_comp_spec("v0", "", { 1 }), hwio_comp_spec("", "", { 1 }) };
+	for (auto & q : queries) {
+		dev_spec_t _q = { q };
+		BOOST_CHECK(reg.find(_q) == ihwio_bus::filter_device_by_spec(devs, _q));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_registry_rebuild) {
+	hwio_device_mmap d0(hwio_comp_spec("v", "t0", { 1 }), 0, 4);
+	hwio_device_mmap d1(hwio_comp_spec("v", "t1", { 1 }), 0, 4);
+	hwio_bus_primitive bus;
+	dev_spec_t q = { hwio_comp_spec("v", "t1", { }) };
+	BOOST_CHECK_EQUAL(bus.find_devices(q).size(), 0);
+	bus._all_devices.push_back(&d0);
+	BOOST_CHECK_EQUAL(bus.find_devices(q).size(), 0);
+	// index is rebuilt on next lookup after _all_devices is modified
+	bus._all_devices.push_back(&d1);
+	auto res = bus.find_devices(q);
+	BOOST_REQUIRE_EQUAL(res.size(), 1);
+	BOOST_CHECK_EQUAL(res[0], &d1);
+	// replaced device (size of _all_devices is not changed)
+	bus._all_devices[1] = &d0;
+	BOOST_CHECK_EQUAL(bus.find_devices(q).size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_registry_devicetree) {
+	hwio_bus_devicetree bus("test_samples/device-tree0_32b");
+	std::vector<ihwio_dev *> devs(bus._all_devices.begin(),
+			bus._all_devices.end());
+	dev_spec_t queries = { hwio_comp_spec("xlnx,xps-uartlite-1.1.97"),
+			hwio_comp_spec("simple-bus"), hwio_comp_spec("xlnx,xps-uartlite"),
+			hwio_comp_spec() };
+	queries.back().name_set("serial@84000000");
+	for (auto & q : queries) {
+		dev_spec_t _q = { q };
+		BOOST_CHECK(
+				bus.find_devices(_q) == ihwio_bus::filter_device_by_spec(devs, _q));
+	}
+	ihwio_bus & b = bus;
+	BOOST_CHECK_EQUAL(b.find_devices( { "xlnx,xps-uartlite-1.1.97"_hwio_spec }).size(), 2);
+	BOOST_CHECK_EQUAL(b.find_devices( { "simple-bus"_hwio_spec }).size(), 1);
+	BOOST_CHECK_EQUAL(b.find_devices( { "xlnx,xps-uartlite"_hwio_spec,
+			"simple-bus"_hwio_spec }).size(), 3);
+}
+
+}
@@ -0,0 +1,340 @@
+#define BOOST_TEST_MODULE "Tests of ihwio_dev bulk transfers"
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "ihwio_dev.h"
+#include "hwio_batch.h"
+
+namespace hwio {
+
+/*
+ * Device backed by memory which records widths of all accesses
+ * */
+class test_mem_dev: public ihwio_dev {
+public:
+	std::vector<hwio_comp_spec> spec;
+	uint8_t mem[256];
+	unsigned widths;
+	bool aligned;
+	std::vector<size_t> accesses;
+
+	test_mem_dev(unsigned widths, bool aligned) :
+			widths(widths), aligned(aligned) {
+		::memset(mem, 0, sizeof(mem));
+	}
+	virtual const std::vector<hwio_comp_spec> & get_spec() const override {
+		return spec;
+	}
+	virtual void attach() override {
+	}
+	virtual unsigned access_widths() const override {
+		return widths;
+	}
+	virtual bool access_aligned() const override {
+		return aligned;
+	}
+
+	template<typename T>
+	T _read(hwio_phys_addr_t offset) {
+		if (aligned)
+			BOOST_CHECK_EQUAL(offset % sizeof(T), 0);
+		accesses.push_back(sizeof(T));
+		T v;
+		::memcpy(&v, mem + offset, sizeof(T));
+		return v;
+	}
+	template<typename T>
+	void _write(hwio_phys_addr_t offset, T v) {
+		if (aligned)
+			BOOST_CHECK_EQUAL(offset % sizeof(T), 0);
+		accesses.push_back(sizeof(T));
+		::memcpy(mem + offset, &v, sizeof(T));
+	}
+
+	virtual uint8_t read8(hwio_phys_addr_t offset) override {
+		return _read<uint8_t>(offset);
+	}
+	virtual uint16_t read16(hwio_phys_addr_t offset) override {
+		return _read<uint16_t>(offset);
+	}
+	virtual uint32_t read32(hwio_phys_addr_t offset) override {
+		return _read<uint32_t>(offset);
+	}
+	virtual uint64_t read64(hwio_phys_addr_t offset) override {
+		return _read<uint64_t>(offset);
+	}
+	virtual void write8(hwio_phys_addr_t offset, uint8_t val) override {
+		_write(offset, val);
+	}
+	virtual void write16(hwio_phys_addr_t offset, uint16_t val) override {
+		_write(offset, val);
+	}
+	virtual void write32(hwio_phys_addr_t offset, uint32_t val) override {
+		_write(offset, val);
+	}
+	virtual void write64(hwio_phys_addr_t offset, uint64_t val) override {
+		_write(offset, val);
+	}
+	virtual std::string to_str() override {
+		return "test_mem_dev";
+	}
+};
+
+/*
+ * Device with only mandatory accessors, read16/write16 are inherited
+ * */
+class test_mem_dev_no16: public test_mem_dev {
+public:
+	using test_mem_dev::test_mem_dev;
+	virtual uint16_t read16(hwio_phys_addr_t offset) override {
+		return ihwio_dev::read16(offset);
+	}
+	virtual void write16(hwio_phys_addr_t offset, uint16_t val) override {
+		ihwio_dev::write16(offset, val);
+	}
+};
+
+BOOST_AUTO_TEST_CASE(test_default_rw16) {
+	test_mem_dev_no16 dev(HWIO_ACCESS_8 | HWIO_ACCESS_32, true);
+	dev.write16(3, 0x1234);
+	BOOST_CHECK_EQUAL(dev.mem[3], 0x34);
+	BOOST_CHECK_EQUAL(dev.mem[4], 0x12);
+	BOOST_CHECK_EQUAL(dev.read16(3), 0x1234);
+
+	// 16b accesses are not enabled, both are split to 8b accesses
+	std::vector<size_t> ref = { 1, 1, 1, 1 };
+	BOOST_CHECK_EQUAL_COLLECTIONS(dev.accesses.begin(), dev.accesses.end(),
+			ref.begin(), ref.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_read_unaligned) {
+	test_mem_dev dev(HWIO_ACCESS_ALL, true);
+	for (unsigned i = 0; i < sizeof(dev.mem); i++)
+		dev.mem[i] = i;
+
+	uint8_t buff[64];
+	dev.read(3, buff, 37);
+	for (unsigned i = 0; i < 37; i++)
+		BOOST_CHECK_EQUAL(buff[i], i + 3);
+
+	// head 3..8, middle 8..32, tail 32..40
+	std::vector<size_t> ref = { 1, 4, 8, 8, 8, 8 };
+	BOOST_CHECK_EQUAL_COLLECTIONS(dev.accesses.begin(), dev.accesses.end(),
+			ref.begin(), ref.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_write_restricted_widths) {
+	test_mem_dev dev(HWIO_ACCESS_8 | HWIO_ACCESS_32, true);
+	uint8_t buff[15];
+	for (unsigned i = 0; i < sizeof(buff); i++)
+		buff[i] = i + 1;
+
+	dev.write(1, buff, sizeof(buff));
+	for (unsigned i = 0; i < sizeof(buff); i++)
+		BOOST_CHECK_EQUAL(dev.mem[i + 1], buff[i]);
+	BOOST_CHECK_EQUAL(dev.mem[0], 0);
+	BOOST_CHECK_EQUAL(dev.mem[16], 0);
+
+	std::vector<size_t> ref = { 1, 1, 1, 4, 4, 4 };
+	BOOST_CHECK_EQUAL_COLLECTIONS(dev.accesses.begin(), dev.accesses.end(),
+			ref.begin(), ref.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_memset) {
+	test_mem_dev dev(HWIO_ACCESS_ALL, false);
+	dev.memset(2, 0xab, 19);
+	for (unsigned i = 0; i < sizeof(dev.mem); i++) {
+		uint8_t ref = (i >= 2 && i < 21) ? 0xab : 0;
+		BOOST_CHECK_EQUAL(dev.mem[i], ref);
+	}
+	std::vector<size_t> ref = { 8, 8, 2, 1 };
+	BOOST_CHECK_EQUAL_COLLECTIONS(dev.accesses.begin(), dev.accesses.end(),
+			ref.begin(), ref.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_bulk_fill) {
+	test_mem_dev dev(HWIO_ACCESS_ALL, true);
+	dev.fill(2, 0x04030201, sizeof(uint32_t), 15);
+	for (unsigned i = 0; i < sizeof(dev.mem); i++) {
+		uint8_t ref = (i >= 2 && i < 17) ? (i - 2) % 4 + 1 : 0;
+		BOOST_CHECK_EQUAL(dev.mem[i], ref);
+	}
+	std::vector<size_t> ref = { 2, 4, 8, 1 };
+	BOOST_CHECK_EQUAL_COLLECTIONS(dev.accesses.begin(), dev.accesses.end(),
+			ref.begin(), ref.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_keyhole) {
+	test_mem_dev dev(HWIO_ACCESS_8 | HWIO_ACCESS_32, true);
+	uint32_t data[5] = { 1, 2, 3, 4, 5 };
+	dev.write_keyhole(4, data, sizeof(data), sizeof(uint32_t));
+	std::vector<size_t> ref = { 4, 4, 4, 4, 4 };
+	BOOST_CHECK_EQUAL_COLLECTIONS(dev.accesses.begin(), dev.accesses.end(),
+			ref.begin(), ref.end());
+	BOOST_CHECK_EQUAL(dev.read32(4), 5);
+	BOOST_CHECK_EQUAL(dev.read32(8), 0);
+
+	uint32_t res[3];
+	dev.read_keyhole(4, res, sizeof(res), sizeof(uint32_t));
+	for (auto r : res)
+		BOOST_CHECK_EQUAL(r, 5);
+
+	BOOST_CHECK_THROW(dev.write_keyhole(4, data, sizeof(data), sizeof(uint64_t)),
+			hwio_error_rw);
+	BOOST_CHECK_THROW(dev.write_keyhole(4, data, 3, sizeof(uint32_t)),
+			hwio_error_rw);
+	BOOST_CHECK_THROW(dev.write_keyhole(2, data, 4, sizeof(uint32_t)),
+			hwio_error_rw);
+}
+
+BOOST_AUTO_TEST_CASE(test_rmw) {
+	test_mem_dev dev(HWIO_ACCESS_ALL, true);
+	dev.write32(4, 0xff00ff00);
+	BOOST_CHECK_EQUAL(dev.rmw32(4, 0x0000ffff, 0x12345678), 0xff00ff00);
+	BOOST_CHECK_EQUAL(dev.read32(4), 0xff005678);
+	BOOST_CHECK_EQUAL(dev.set_bits32(4, 0x1), 0xff005678);
+	BOOST_CHECK_EQUAL(dev.read32(4), 0xff005679);
+	BOOST_CHECK_EQUAL(dev.clear_bits32(4, 0xff000000), 0xff005679);
+	BOOST_CHECK_EQUAL(dev.read32(4), 0x00005679);
+	BOOST_CHECK_EQUAL(dev.toggle_bits32(4, 0x0000000f), 0x00005679);
+	BOOST_CHECK_EQUAL(dev.read32(4), 0x00005676);
+
+	dev.write64(8, 0);
+	dev.set_bits64(8, 1ULL << 63);
+	dev.toggle_bits64(8, 3);
+	dev.clear_bits64(8, 1);
+	BOOST_CHECK_EQUAL(dev.rmw64(8, 0, 0), (1ULL << 63) | 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_program) {
+	test_mem_dev dev(HWIO_ACCESS_ALL, true);
+	memset(dev.mem, 0, sizeof(dev.mem));
+	dev.write32(4, 0x12);
+
+	hwio_program p;
+	p.write(0, 0x1);
+	p.poll(0, 0x1, 0x1, 1000);
+	p.read(4, 0);
+	p.write_slot(8, 0, 0xff, 0x100);
+	// skipped write
+	size_t j = p.jump_if(0, 0xff, 0x12, 0);
+	p.write(12, 0xbad);
+	p.set_target(j, p.label());
+	// 3 iterations of loop
+	p.set(1, 3);
+	size_t l = p.read(16, 2);
+	p.write_slot(16, 2, 0xffffffff, 0x1 << 4);
+	p.loop(1, l);
+	p.rmw(16, 0xf, 0x1, 3);
+	p.jump_if_not(3, 0xf0, 0x10, 0);
+	p.write(20, 0x7);
+
+	auto res = p.exec(&dev);
+	BOOST_CHECK_EQUAL(res.status, HWIO_PROG_DONE);
+	BOOST_CHECK_EQUAL(res.pc, p.insns.size());
+	BOOST_CHECK_EQUAL(res.slots.size(), 4);
+	BOOST_CHECK_EQUAL(res.slots[0], 0x12);
+	BOOST_CHECK_EQUAL(res.slots[1], 0);
+	BOOST_CHECK_EQUAL(dev.read32(8), 0x112);
+	BOOST_CHECK_EQUAL(dev.read32(12), 0);
+	BOOST_CHECK_EQUAL(res.slots[3], 0x10);
+	BOOST_CHECK_EQUAL(dev.read32(16), 0x11);
+	BOOST_CHECK_EQUAL(dev.read32(20), 0x7);
+	res = dev.run_program(p);
+	BOOST_CHECK_EQUAL(res.status, HWIO_PROG_DONE);
+
+	hwio_program timeout;
+	timeout.set(0, 1);
+	timeout.poll(24, 0x1, 0x1, 1000);
+	timeout.set(0, 2);
+	res = dev.run_program(timeout);
+	BOOST_CHECK_EQUAL(res.status, HWIO_PROG_TIMEOUT);
+	BOOST_CHECK_EQUAL(res.pc, 1);
+	BOOST_CHECK_EQUAL(res.slots[0], 1);
+
+	// total time of polls is limited
+	hwio_program long_poll;
+	long_poll.poll(24, 0x1, 0x1, 10000000);
+	BOOST_CHECK_EQUAL(
+			hwio_program::poll_time(long_poll.insns.data(),
+					long_poll.insns.size()), 10000000);
+	uint32_t slots[1];
+	size_t pc;
+	auto start = std::chrono::steady_clock::now();
+	BOOST_CHECK_EQUAL(
+			hwio_program::exec(&dev, long_poll.insns.data(),
+					long_poll.insns.size(), slots, pc, 1000),
+			HWIO_PROG_TIMEOUT);
+	BOOST_CHECK(std::chrono::steady_clock::now() - start
+			< std::chrono::seconds(1));
+
+	hwio_program endless;
+	endless.set(0, 0);
+	endless.loop(0, endless.label());
+	res = dev.run_program(endless);
+	BOOST_CHECK_EQUAL(res.status, HWIO_PROG_STEP_LIMIT);
+	BOOST_CHECK_EQUAL(res.pc, 1);
+
+	hwio_program bad;
+	BOOST_CHECK_THROW(bad.read(0, hwio_program::MAX_SLOTS),
+			std::invalid_argument);
+	j = bad.jump_if(0, 0, 0, 0);
+	bad.set_target(j, 2);
+	BOOST_CHECK_THROW(dev.run_program(bad), std::invalid_argument);
+	bad.insns[0].op = 0xff;
+	bad.insns[0].arg = 0;
+	BOOST_CHECK_THROW(dev.run_program(bad), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_batch) {
+	test_mem_dev dev(HWIO_ACCESS_ALL, true);
+	hwio_batch b(&dev);
+	uint32_t r0 = 0;
+	uint64_t r1 = 0;
+	uint8_t r2[8];
+	b.write32(0, 0x11223344);
+	b.read32(0, &r0);
+	b.write64(8, 0x1ULL << 40);
+	b.read64(8, &r1);
+	b.fill(16, 0xab, 1, sizeof(r2));
+	b.read(16, r2, sizeof(r2));
+	b.write(24, r2, 0);
+	BOOST_CHECK_EQUAL(b.size(), 6);
+	// nothing is executed before flush
+	BOOST_CHECK_EQUAL(dev.accesses.size(), 0);
+	BOOST_CHECK_EQUAL(r0, 0);
+
+	b.flush();
+	BOOST_CHECK_EQUAL(b.size(), 0);
+	BOOST_CHECK_EQUAL(r0, 0x11223344);
+	BOOST_CHECK_EQUAL(r1, 0x1ULL << 40);
+	for (auto v : r2)
+		BOOST_CHECK_EQUAL(v, 0xab);
+
+	// batch is cleared also on error
+	b.fill(16, 0xab, 3, 6);
+	BOOST_CHECK_THROW(b.flush(), hwio_error_rw);
+	BOOST_CHECK_EQUAL(b.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_wait_until) {
+	test_mem_dev dev(HWIO_ACCESS_ALL, true);
+	dev.write32(4, 0x0);
+	BOOST_CHECK(dev.wait_until(4, 0x1, 0x0, 0));
+	BOOST_CHECK(!dev.wait_until(4, 0x1, 0x1, 0));
+	auto start = std::chrono::steady_clock::now();
+	BOOST_CHECK(!dev.wait_until(4, 0x1, 0x1, 5000));
+	BOOST_CHECK(std::chrono::steady_clock::now() - start
+			>= std::chrono::milliseconds(5));
+
+	std::thread t([&dev]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		dev.write32(4, 0x3);
+	});
+	BOOST_CHECK(dev.wait_until(4, 0x1, 0x1, 5000000));
+	t.join();
+}
+
+}